@@ -0,0 +1,284 @@
+#include "BinaryScene.h"
+#include "Common.h"
+#include "GameObject.h"
+#include "MappedFile.h"
+#include "SceneParser.h"
+
+#include <rapidjson/prettywriter.h>
+#include <rapidjson/stringbuffer.h>
+
+#include <charconv>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <unordered_map>
+
+namespace
+{
+	constexpr uint32_t BINARY_SCENE_MAGIC = 0x454E4353; // "SCNE"
+	constexpr uint32_t BINARY_SCENE_VERSION = 1;
+	constexpr uint64_t BINARY_SCENE_ALIGNMENT = 16;
+	constexpr const char* BINARY_SCENE_EXTENSION = ".scene";
+
+	// Bits of the per object flags array
+	constexpr uint8_t SCENE_FLAG_PACKED_VERTICES = 1 << 0;
+	constexpr uint8_t SCENE_FLAG_MESHLETS = 1 << 1;
+
+	struct SBinarySceneHeader
+	{
+		uint32_t Magic;
+		uint32_t Version;
+		uint32_t ObjectCount;
+		uint32_t StringTableSize;
+		// Offsets from the start of the file
+		uint64_t PositionOffset;
+		uint64_t RotationOffset;
+		uint64_t ScaleOffset;
+		uint64_t FileNameOffset;
+		uint64_t ObjectNameOffset;
+		uint64_t CreaseAngleOffset;
+		uint64_t FlagsOffset;
+		uint64_t StringTableOffset;
+	};
+
+	// A string in the table, not null terminated
+	struct SStringReference
+	{
+		uint32_t Offset;
+		uint32_t Length;
+	};
+
+	uint64_t alignOffset(const uint64_t offset)
+	{
+		return (offset + BINARY_SCENE_ALIGNMENT - 1) & ~(BINARY_SCENE_ALIGNMENT - 1);
+	}
+
+	// Appends the array at the next aligned offset and returns where it starts
+	template <typename T>
+	uint64_t appendArray(std::vector<char>& vecFile, const std::vector<T>& vecValue)
+	{
+		const auto offset = alignOffset(vecFile.size());
+		vecFile.resize(offset + vecValue.size() * sizeof(T));
+		if (!vecValue.empty())
+			std::memcpy(vecFile.data() + offset, vecValue.data(), vecValue.size() * sizeof(T));
+		return offset;
+	}
+
+	void writeFloat(rapidjson::PrettyWriter<rapidjson::StringBuffer>& writer, const float value)
+	{
+		// Shortest text that reads back as the same float, 0.35f stays 0.35
+		char buffer[32];
+		const auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+		writer.RawValue(buffer, static_cast<size_t>(result.ptr - buffer), rapidjson::kNumberType);
+	}
+
+	void writeVector(rapidjson::PrettyWriter<rapidjson::StringBuffer>& writer, const char* key, const glm::vec3& value)
+	{
+		writer.Key(key);
+		writer.StartArray();
+		writeFloat(writer, value.x);
+		writeFloat(writer, value.y);
+		writeFloat(writer, value.z);
+		writer.EndArray();
+	}
+}
+
+void CBinaryScene::Load(const char* filename, GameObjectVecPtrs& goPtrs)
+{
+	const CMappedFile mappedFile(filename);
+	if (!mappedFile.IsOpen() || mappedFile.GetSize() < sizeof(SBinarySceneHeader))
+		throw std::runtime_error(std::string("Failed to open the scene ") + filename);
+
+	SBinarySceneHeader header;
+	std::memcpy(&header, mappedFile.GetData(), sizeof(header));
+	if (header.Magic != BINARY_SCENE_MAGIC || header.Version != BINARY_SCENE_VERSION)
+		throw std::runtime_error(std::string(filename) + " is not a binary scene of version " + std::to_string(BINARY_SCENE_VERSION));
+
+	const auto fileSize = mappedFile.GetSize();
+	const auto count = uint64_t(header.ObjectCount);
+	if (header.PositionOffset + count * sizeof(glm::vec3) > fileSize ||
+		header.RotationOffset + count * sizeof(glm::vec3) > fileSize ||
+		header.ScaleOffset + count * sizeof(glm::vec3) > fileSize ||
+		header.FileNameOffset + count * sizeof(SStringReference) > fileSize ||
+		header.ObjectNameOffset + count * sizeof(SStringReference) > fileSize ||
+		header.CreaseAngleOffset + count * sizeof(float) > fileSize ||
+		header.FlagsOffset + count * sizeof(uint8_t) > fileSize ||
+		header.StringTableOffset + header.StringTableSize > fileSize)
+	{
+		throw std::runtime_error(std::string(filename) + " is truncated");
+	}
+
+	const auto pData = mappedFile.GetData();
+	const auto pPosition = reinterpret_cast<const glm::vec3*>(pData + header.PositionOffset);
+	const auto pRotation = reinterpret_cast<const glm::vec3*>(pData + header.RotationOffset);
+	const auto pScale = reinterpret_cast<const glm::vec3*>(pData + header.ScaleOffset);
+	const auto pFileName = reinterpret_cast<const SStringReference*>(pData + header.FileNameOffset);
+	const auto pObjectName = reinterpret_cast<const SStringReference*>(pData + header.ObjectNameOffset);
+	const auto pCreaseAngle = reinterpret_cast<const float*>(pData + header.CreaseAngleOffset);
+	const auto pFlags = reinterpret_cast<const uint8_t*>(pData + header.FlagsOffset);
+	const auto pStringTable = pData + header.StringTableOffset;
+
+	const auto getString = [&](const SStringReference& reference)
+	{
+		if (uint64_t(reference.Offset) + reference.Length > header.StringTableSize)
+			throw std::runtime_error(std::string(filename) + " references a string outside its string table");
+		return std::string(pStringTable + reference.Offset, reference.Length);
+	};
+
+	goPtrs.reserve(goPtrs.size() + header.ObjectCount);
+	for (uint32_t object = 0; object != header.ObjectCount; ++object)
+	{
+		SObjectInformation objectInformation(getString(pFileName[object]), getString(pObjectName[object]));
+		objectInformation.VertexFormat = (pFlags[object] & SCENE_FLAG_PACKED_VERTICES) ? EVertexFormat::Packed : EVertexFormat::Float;
+		objectInformation.BuildMeshlets = (pFlags[object] & SCENE_FLAG_MESHLETS) != 0;
+		objectInformation.CreaseAngle = pCreaseAngle[object];
+		const STransform transform(pPosition[object], pRotation[object], pScale[object]);
+		goPtrs.push_back(GameObjectUPtr(new CStaticGameObject(std::move(objectInformation), transform)));
+	}
+}
+
+void CBinaryScene::Store(const char* filename, const GameObjectVecPtrs& goPtrs)
+{
+	const auto objectCount = goPtrs.size();
+	std::vector<glm::vec3> vecPosition(objectCount), vecRotation(objectCount), vecScale(objectCount);
+	std::vector<SStringReference> vecFileName(objectCount), vecObjectName(objectCount);
+	std::vector<float> vecCreaseAngle(objectCount);
+	std::vector<uint8_t> vecFlags(objectCount);
+
+	// Every object of a kind usually shares its filename, each distinct string is stored once
+	std::vector<char> vecStringTable;
+	std::unordered_map<std::string, SStringReference> mapString;
+	const auto addString = [&](const std::string& string)
+	{
+		const auto [iterator, isNew] = mapString.try_emplace(string);
+		if (isNew)
+		{
+			iterator->second = { static_cast<uint32_t>(vecStringTable.size()), static_cast<uint32_t>(string.size()) };
+			vecStringTable.insert(vecStringTable.end(), string.begin(), string.end());
+		}
+		return iterator->second;
+	};
+
+	for (size_t object = 0; object != objectCount; ++object)
+	{
+		const auto& gameObject = *goPtrs[object];
+		vecPosition[object] = gameObject.mTransform.Position;
+		vecRotation[object] = gameObject.mTransform.Rotation;
+		vecScale[object] = gameObject.mTransform.Scale;
+		vecFileName[object] = addString(gameObject.mObjectInformation.FileName);
+		vecObjectName[object] = addString(gameObject.mObjectInformation.ObjectName);
+		vecCreaseAngle[object] = gameObject.mObjectInformation.CreaseAngle;
+		if (gameObject.mObjectInformation.VertexFormat == EVertexFormat::Packed)
+			vecFlags[object] |= SCENE_FLAG_PACKED_VERTICES;
+		if (gameObject.mObjectInformation.BuildMeshlets)
+			vecFlags[object] |= SCENE_FLAG_MESHLETS;
+	}
+
+	SBinarySceneHeader header = {};
+	header.Magic = BINARY_SCENE_MAGIC;
+	header.Version = BINARY_SCENE_VERSION;
+	header.ObjectCount = static_cast<uint32_t>(objectCount);
+	header.StringTableSize = static_cast<uint32_t>(vecStringTable.size());
+
+	std::vector<char> vecFile(sizeof(header));
+	header.PositionOffset = appendArray(vecFile, vecPosition);
+	header.RotationOffset = appendArray(vecFile, vecRotation);
+	header.ScaleOffset = appendArray(vecFile, vecScale);
+	header.FileNameOffset = appendArray(vecFile, vecFileName);
+	header.ObjectNameOffset = appendArray(vecFile, vecObjectName);
+	header.CreaseAngleOffset = appendArray(vecFile, vecCreaseAngle);
+	header.FlagsOffset = appendArray(vecFile, vecFlags);
+	header.StringTableOffset = appendArray(vecFile, vecStringTable);
+	std::memcpy(vecFile.data(), &header, sizeof(header));
+
+	std::ofstream writeStream(filename, std::ios::binary | std::ios::trunc);
+	if (!writeStream.is_open())
+		throw std::runtime_error(std::string("Failed to write the scene ") + filename);
+	writeStream.write(vecFile.data(), static_cast<std::streamsize>(vecFile.size()));
+}
+
+void CBinaryScene::Convert(const char* inputFilename, const char* outputFilename)
+{
+	GameObjectVecPtrs goPtrs;
+	if (IsBinaryScene(inputFilename))
+	{
+		Load(inputFilename, goPtrs);
+		storeJson(outputFilename, goPtrs);
+	}
+	else
+	{
+		CSceneParser::Parse(inputFilename, goPtrs);
+		Store(outputFilename, goPtrs);
+	}
+	std::cout << "Converted " << goPtrs.size() << " objects from " << inputFilename << " to " << outputFilename << std::endl;
+}
+
+bool CBinaryScene::IsBinaryScene(const std::string& filename)
+{
+	return std::filesystem::path(filename).extension() == BINARY_SCENE_EXTENSION;
+}
+
+std::string CBinaryScene::GetUpToDateBinaryFilename(const std::string& jsonFilename)
+{
+	const auto binaryFilename = std::filesystem::path(jsonFilename).replace_extension(BINARY_SCENE_EXTENSION);
+	std::error_code errorCode;
+	const auto binaryWriteTime = std::filesystem::last_write_time(binaryFilename, errorCode);
+	if (errorCode)
+		return {};
+	const auto jsonWriteTime = std::filesystem::last_write_time(jsonFilename, errorCode);
+	if (!errorCode && jsonWriteTime > binaryWriteTime)
+		return {};
+	return binaryFilename.string();
+}
+
+void CBinaryScene::storeJson(const char* filename, const GameObjectVecPtrs& goPtrs)
+{
+	rapidjson::StringBuffer buffer;
+	rapidjson::PrettyWriter<rapidjson::StringBuffer> writer(buffer);
+	// Vectors on one line, like the hand written Scene.json
+	writer.SetFormatOptions(rapidjson::kFormatSingleLineArray);
+	writer.StartObject();
+	writer.Key("Scene");
+	writer.StartArray();
+	for (const auto& gameObject : goPtrs)
+	{
+		const auto& objectInformation = gameObject->mObjectInformation;
+		writer.StartObject();
+		writer.Key("Name");
+		writer.String(objectInformation.ObjectName.c_str(), static_cast<rapidjson::SizeType>(objectInformation.ObjectName.size()));
+		writer.Key("Filename");
+		writer.String(objectInformation.FileName.c_str(), static_cast<rapidjson::SizeType>(objectInformation.FileName.size()));
+		writer.Key("Transform");
+		writer.StartObject();
+		writeVector(writer, "Position", gameObject->mTransform.Position);
+		writeVector(writer, "Rotation", gameObject->mTransform.Rotation);
+		writeVector(writer, "Scale", gameObject->mTransform.Scale);
+		writer.EndObject();
+
+		// Optional keys are only written when they differ from what the parser defaults to
+		if (objectInformation.VertexFormat == EVertexFormat::Packed)
+		{
+			writer.Key("VertexFormat");
+			writer.String("Packed");
+		}
+		if (objectInformation.BuildMeshlets)
+		{
+			writer.Key("Meshlets");
+			writer.Bool(true);
+		}
+		if (objectInformation.CreaseAngle != SObjectInformation().CreaseAngle)
+		{
+			writer.Key("CreaseAngle");
+			writeFloat(writer, objectInformation.CreaseAngle);
+		}
+		writer.EndObject();
+	}
+	writer.EndArray();
+	writer.EndObject();
+
+	std::ofstream writeStream(filename, std::ios::binary | std::ios::trunc);
+	if (!writeStream.is_open())
+		throw std::runtime_error(std::string("Failed to write the scene ") + filename);
+	writeStream.write(buffer.GetString(), static_cast<std::streamsize>(buffer.GetSize()));
+	writeStream << '\n';
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include "TypeAliases.h"
+
+#include <string>
+
+// Binary counterpart of Scene.json, stored with the .scene extension.
+// Layout: SBinarySceneHeader, then one array per attribute with an entry per object (positions,
+// rotations and scales as packed vec3s, string references, crease angles, flags) and finally a
+// string table holding every distinct filename and name once. Each array starts on a
+// BINARY_SCENE_ALIGNMENT boundary, so the whole scene is read out of a single memory mapping
+class CBinaryScene
+{
+public:
+	// Throws std::runtime_error if the file can't be opened or is malformed
+	static void Load(const char* filename, GameObjectVecPtrs& goPtrs);
+	static void Store(const char* filename, const GameObjectVecPtrs& goPtrs);
+
+	// JSON to binary, or binary back to JSON when the input has the .scene extension
+	static void Convert(const char* inputFilename, const char* outputFilename);
+
+	[[nodiscard]] static bool IsBinaryScene(const std::string& filename);
+	// The .scene file next to a JSON scene, if it exists and was written after the JSON. Empty otherwise
+	[[nodiscard]] static std::string GetUpToDateBinaryFilename(const std::string& jsonFilename);
+
+private:
+	static void storeJson(const char* filename, const GameObjectVecPtrs& goPtrs);
+};
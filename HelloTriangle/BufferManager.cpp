@@ -1,125 +1,49 @@
 #include "BufferManager.h"
-#include "CommandBufferManager.h"
-#include "GameObject.h"
-#include "SetupHelpers.h"
+#include "GeometryArena.h"
 
-void CBufferManager::CreateVertexBuffer(const VkDevice& device, const VkPhysicalDevice& physicalDevice, VkQueue& queue, const VkCommandPool& commandPool, GameObjectUPtr& gameObject)
+VkDeviceSize CBufferManager::GetModelUploadSize(const SModelInformation& modelInfo)
 {
-	const auto bufferSize = gameObject->GetVertexBufferSize();
-
-	VkBuffer stagingBuffer;
-	VkDeviceMemory stagingBufferMemory;
-	createBuffer(device, physicalDevice, bufferSize,
-				 VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-				 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-				 stagingBuffer,
-				 stagingBufferMemory);
-
-	void* data;
-	vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
-	std::memcpy(data, gameObject->GetVertexData(), bufferSize);
-	vkUnmapMemory(device, stagingBufferMemory);
-
-	createBuffer(device, physicalDevice, bufferSize,
-				 VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-				 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-				 gameObject->GetVertexBuffer(),
-				 gameObject->GetVertexBufferMemory());
-
-	copyBuffer(device, commandPool, queue, stagingBuffer, gameObject->GetVertexBuffer(), bufferSize);
-
-	// Cleanup staging buffer and memory
-	vkDestroyBuffer(device, stagingBuffer, nullptr);
-	vkFreeMemory(device, stagingBufferMemory, nullptr);
+	return modelInfo.GetVertexBufferSize() + modelInfo.GetIndexBufferSize();
 }
 
-void CBufferManager::CreateIndexBuffer(const VkDevice& device, const VkPhysicalDevice& physicalDevice, VkQueue& queue, const VkCommandPool& commandPool, GameObjectUPtr& gameObject)
+void CBufferManager::RecordModelUpload(CUploadBatch& uploadBatch, const SStagingRegion& region, SModelInformation& modelInfo)
 {
-	const auto bufferSize = gameObject->GetIndexBufferSize();
-
-	VkBuffer stagingBuffer;
-	VkDeviceMemory stagingBufferMemory;
-	createBuffer(device, physicalDevice, bufferSize,
-				 VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-				 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-				 stagingBuffer,
-				 stagingBufferMemory);
-
-	void* data;
-	vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
-	std::memcpy(data, gameObject->GetIndexData(), bufferSize);
-	vkUnmapMemory(device, stagingBufferMemory);
-
-	createBuffer(device, physicalDevice, bufferSize,
-				 VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-				 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-				 gameObject->GetIndexBuffer(),
-				 gameObject->GetIndexBufferMemory());
-
-	copyBuffer(device, commandPool, queue, stagingBuffer, gameObject->GetIndexBuffer(), bufferSize);
-
-	// Cleanup staging buffer and memory
-	vkDestroyBuffer(device, stagingBuffer, nullptr);
-	vkFreeMemory(device, stagingBufferMemory, nullptr);
+	const auto vertexBufferSize = modelInfo.GetVertexBufferSize();
+	const auto indexBufferSize = modelInfo.GetIndexBufferSize();
+
+	// One staging region holds both arrays, the indices follow the vertices
+	std::memcpy(region.pData, modelInfo.GetVertexBufferData(), vertexBufferSize);
+	std::memcpy(region.pData + vertexBufferSize, modelInfo.GetIndexBufferData(), indexBufferSize);
+
+	const auto& arena = *modelInfo.pGeometryArena;
+	uploadBatch.CopyBuffer(region.Buffer, region.Offset, arena.GetVertexBuffer(), arena.GetVertexByteOffset(modelInfo.GeometryRange),
+						   vertexBufferSize);
+	uploadBatch.CopyBuffer(region.Buffer, region.Offset + vertexBufferSize, arena.GetIndexBuffer(),
+						   arena.GetIndexByteOffset(modelInfo.GeometryRange), indexBufferSize);
 }
 
-void CBufferManager::CreateUniformBuffer(const VkDevice& device, const VkPhysicalDevice& physicalDevice, VkQueue& queue, const VkCommandPool& commandPool, GameObjectUPtr& gameObject)
+void CBufferManager::RecordModelHandoff(CUploadBatch& uploadBatch, CUploadBatch& graphicsBatch, const uint32_t uploadFamily,
+										const uint32_t graphicsFamily, const SModelInformation& modelInfo)
 {
-	//const auto uboSize = sizeof(SUniformBufferObject);
-
-	//vecUniformBuffer.resize(vecSwapChainImages.size());
-	//vecUniformBufferMemory.resize(vecSwapChainImages.size());
+	const auto& arena = *modelInfo.pGeometryArena;
+	const auto vertexOffset = arena.GetVertexByteOffset(modelInfo.GeometryRange);
+	const auto indexOffset = arena.GetIndexByteOffset(modelInfo.GeometryRange);
+	const auto vertexBufferSize = modelInfo.GetVertexBufferSize();
+	const auto indexBufferSize = modelInfo.GetIndexBufferSize();
 
-	//for (size_t i = 0; i < vecUniformBuffer.size(); ++i)
-	//{
-	//	createBuffer(uboSize,
-	//				 VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-	//				 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-	//				 vecUniformBuffer[i], vecUniformBufferMemory[i]);
-	//}
-}
-
-void CBufferManager::createBuffer(const VkDevice& device, const VkPhysicalDevice& physicalDevice,const VkDeviceSize size, const VkBufferUsageFlags usageFlags,
-	const VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory)
-{
-	VkBufferCreateInfo bufferCreateInfo = {};
-	bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-	bufferCreateInfo.size = size;
-	bufferCreateInfo.usage = usageFlags;
-	bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-
-	if (vkCreateBuffer(device, &bufferCreateInfo, nullptr, &buffer) != VK_SUCCESS)
+	if (uploadFamily == graphicsFamily)
 	{
-		throw std::runtime_error("Failed to create the buffer.");
+		uploadBatch.BarrierBuffer(arena.GetVertexBuffer(), vertexOffset, vertexBufferSize,
+								  VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
+		uploadBatch.BarrierBuffer(arena.GetIndexBuffer(), indexOffset, indexBufferSize,
+								  VK_ACCESS_INDEX_READ_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
+		return;
 	}
 
-	// Get Memory Requirements
-	VkMemoryRequirements memoryRequirements;
-	vkGetBufferMemoryRequirements(device, buffer, &memoryRequirements);
-
-	VkMemoryAllocateInfo memoryAllocateInfo = {};
-	memoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	memoryAllocateInfo.allocationSize = memoryRequirements.size;
-	memoryAllocateInfo.memoryTypeIndex = CSetupHelpers::FindMemoryType(
-		physicalDevice, memoryRequirements.memoryTypeBits, properties);
-
-	if (vkAllocateMemory(device, &memoryAllocateInfo, nullptr, &bufferMemory) != VK_SUCCESS)
-	{
-		throw std::runtime_error("Failed to allocate memory for the buffer.");
-	}
-
-	vkBindBufferMemory(device, buffer, bufferMemory, 0);
-}
-
-void CBufferManager::copyBuffer(const VkDevice& device, const VkCommandPool& commandPool, VkQueue& queue, const VkBuffer srcBuffer, const VkBuffer dstBuffer, const VkDeviceSize size)
-{
-	auto commandBuffer = CCommandBufferManager::BeginCommandBuffer(device, commandPool);
-	// Copy vertex buffer using command buffer
-	VkBufferCopy bufferCopy;
-	bufferCopy.size = size;
-	bufferCopy.dstOffset = 0;
-	bufferCopy.srcOffset = 0;
-	vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &bufferCopy);
-	// End command buffer
-	CCommandBufferManager::EndCommandBuffer(device, commandPool, queue, commandBuffer);
+	uploadBatch.ReleaseBuffer(arena.GetVertexBuffer(), vertexOffset, vertexBufferSize, uploadFamily, graphicsFamily);
+	uploadBatch.ReleaseBuffer(arena.GetIndexBuffer(), indexOffset, indexBufferSize, uploadFamily, graphicsFamily);
+	graphicsBatch.AcquireBuffer(arena.GetVertexBuffer(), vertexOffset, vertexBufferSize, uploadFamily, graphicsFamily,
+								VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
+	graphicsBatch.AcquireBuffer(arena.GetIndexBuffer(), indexOffset, indexBufferSize, uploadFamily, graphicsFamily,
+								VK_ACCESS_INDEX_READ_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
 }
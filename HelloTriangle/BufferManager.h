@@ -1,17 +1,22 @@
 #pragma once
-#include "TypeAliases.h"
+#include "CommonStructs.h"
+#include "DeviceMemoryAllocator.h"
+#include "StagingRing.h"
+#include "UploadBatch.h"
 
 #include <vulkan/vulkan_core.h>
+
 class CBufferManager
 {
 public:
-	static void CreateVertexBuffer(const VkDevice& device, const VkPhysicalDevice& physicalDevice, VkQueue& queue, const VkCommandPool& commandPool, GameObjectUPtr& gameObject);
-	static void CreateIndexBuffer(const VkDevice& device, const VkPhysicalDevice& physicalDevice, VkQueue& queue, const VkCommandPool& commandPool, GameObjectUPtr& gameObject);
-	static void CreateUniformBuffer(const VkDevice& device, const VkPhysicalDevice& physicalDevice, VkQueue& queue, const VkCommandPool& commandPool, GameObjectUPtr& gameObject);
-
-private:
-	static void createBuffer(const VkDevice& device, const VkPhysicalDevice& physicalDevice, const VkDeviceSize size, const VkBufferUsageFlags usageFlags,
-							 const VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory);
-	static void copyBuffer(const VkDevice& device, const VkCommandPool& commandPool, VkQueue& queue, const VkBuffer srcBuffer, const VkBuffer dstBuffer, const VkDeviceSize size);
+	// Staging space RecordModelUpload needs for the mesh
+	[[nodiscard]] static VkDeviceSize GetModelUploadSize(const SModelInformation& modelInfo);
+	// Copies the mesh into the staging region and records the copies into its geometry arena range.
+	// The arena must not grow again before the batch is submitted
+	static void RecordModelUpload(CUploadBatch& uploadBatch, const SStagingRegion& region, SModelInformation& modelInfo);
+	// Records what makes the copied geometry readable by draws on the graphics family. Within one family that is a
+	// barrier in the upload batch. Across families it is a release in the upload batch and the matching acquire in
+	// the graphics batch, which must wait for the upload batch's semaphore at VK_PIPELINE_STAGE_VERTEX_INPUT_BIT
+	static void RecordModelHandoff(CUploadBatch& uploadBatch, CUploadBatch& graphicsBatch, uint32_t uploadFamily,
+								   uint32_t graphicsFamily, const SModelInformation& modelInfo);
 };
-
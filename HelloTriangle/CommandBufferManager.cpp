@@ -1,5 +1,7 @@
 #include "CommandBufferManager.h"
 
+#include <stdexcept>
+
 VkCommandBuffer CCommandBufferManager::BeginCommandBuffer(const VkDevice& device, const VkCommandPool& commandPool)
 {
 	VkCommandBufferAllocateInfo allocateInfo = {};
@@ -20,17 +22,34 @@ VkCommandBuffer CCommandBufferManager::BeginCommandBuffer(const VkDevice& device
 	return commandBuffer;
 }
 
-void CCommandBufferManager::EndCommandBuffer(const VkDevice& device, const VkCommandPool& commandPool, const VkQueue& queue,
-	VkCommandBuffer& commandBuffer)
+VkFence CCommandBufferManager::SubmitCommandBuffer(const VkDevice& device, const VkQueue& queue, VkCommandBuffer& commandBuffer,
+												   const uint32_t waitSemaphoreCount, const VkSemaphore* pWaitSemaphores,
+												   const VkPipelineStageFlags* pWaitStages, const VkSemaphore signalSemaphore)
 {
 	vkEndCommandBuffer(commandBuffer);
 
+	VkFenceCreateInfo fenceCreateInfo = {};
+	fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+	VkFence fence;
+	if (vkCreateFence(device, &fenceCreateInfo, nullptr, &fence) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create the fence.");
+	}
+
 	VkSubmitInfo submitInfo = {};
 	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 	submitInfo.commandBufferCount = 1;
 	submitInfo.pCommandBuffers = &commandBuffer;
-
-	vkQueueSubmit(queue, 1, &submitInfo, nullptr);
-	vkQueueWaitIdle(queue);
-	vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
+	submitInfo.waitSemaphoreCount = waitSemaphoreCount;
+	submitInfo.pWaitSemaphores = pWaitSemaphores;
+	submitInfo.pWaitDstStageMask = pWaitStages;
+	submitInfo.signalSemaphoreCount = signalSemaphore != nullptr ? 1 : 0;
+	submitInfo.pSignalSemaphores = &signalSemaphore;
+
+	if (vkQueueSubmit(queue, 1, &submitInfo, fence) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to submit the command buffer.");
+	}
+	return fence;
 }
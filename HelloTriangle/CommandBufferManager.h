@@ -7,6 +7,10 @@ class CCommandBufferManager
 {
 public:
 	[[nodiscard]] static VkCommandBuffer BeginCommandBuffer(const VkDevice& device, const VkCommandPool& commandPool);
-	static void EndCommandBuffer(const VkDevice& device, const VkCommandPool& commandPool, const VkQueue& queue, VkCommandBuffer& commandBuffer);
+	// Ends and submits the command buffer without waiting, the returned fence signals when it has executed.
+	// The semaphores are optional
+	[[nodiscard]] static VkFence SubmitCommandBuffer(const VkDevice& device, const VkQueue& queue, VkCommandBuffer& commandBuffer,
+													 uint32_t waitSemaphoreCount = 0, const VkSemaphore* pWaitSemaphores = nullptr,
+													 const VkPipelineStageFlags* pWaitStages = nullptr, VkSemaphore signalSemaphore = nullptr);
 };
 
@@ -33,9 +33,17 @@ const std::vector<const char*> DEVICE_EXTENSIONS = {
 	VK_KHR_SWAPCHAIN_EXTENSION_NAME
 };
 
-struct SUniformBufferObject
+// Written once per frame and shared by every draw
+struct SCameraUniform
 {
-	alignas(16) glm::mat4 Model;
 	alignas(16) glm::mat4 View;
 	alignas(16) glm::mat4 Projection;
+	// World space, for culling objects on the GPU
+	alignas(16) glm::vec4 FrustumPlanes[6];
+};
+
+// One per game object in a storage buffer array, read through the instance's object index
+struct SObjectTransform
+{
+	alignas(16) glm::mat4 Model;
 };
\ No newline at end of file
@@ -4,8 +4,12 @@
 #include <glm/glm.hpp>
 #include <iostream>
 #include <array>
+#include <memory>
 #include <vector>
 
+class CGeometryArena;
+class CMappedFile;
+
 struct STransform
 {
 	STransform() = default;
@@ -53,24 +57,226 @@ struct SVertex
 		return inputAttributeDescriptions;
 	}
 
+	bool operator==(const SVertex& other) const
+	{
+		return Position == other.Position &&
+			Normal == other.Normal &&
+			TextureCoords == other.TextureCoords;
+	}
+
 	glm::vec3 Position;
 	glm::vec3 Normal;
 	glm::vec2 TextureCoords;
 };
 
+enum class EVertexFormat : uint8_t
+{
+	Float,
+	Packed
+};
+
+// 16 byte alternative to SVertex, dequantized in vShader.vert with SMeshPushConstants
+struct SPackedVertex
+{
+	static VkVertexInputBindingDescription GetInputBindingDescription()
+	{
+		VkVertexInputBindingDescription inputBindingDescription;
+		inputBindingDescription.binding = 0;
+		inputBindingDescription.stride = sizeof(SPackedVertex);
+		inputBindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+		return inputBindingDescription;
+	}
+
+	static std::array<VkVertexInputAttributeDescription, 3> GetInputAttributeDescriptions()
+	{
+		std::array<VkVertexInputAttributeDescription, 3> inputAttributeDescriptions = {};
+
+		// Position
+		inputAttributeDescriptions[0].binding = 0;
+		inputAttributeDescriptions[0].location = 0;
+		inputAttributeDescriptions[0].format = VK_FORMAT_R16G16B16A16_UNORM;
+		inputAttributeDescriptions[0].offset = offsetof(SPackedVertex, Position);
+		// Normal
+		inputAttributeDescriptions[1].binding = 0;
+		inputAttributeDescriptions[1].location = 1;
+		inputAttributeDescriptions[1].format = VK_FORMAT_R16G16_SNORM;
+		inputAttributeDescriptions[1].offset = offsetof(SPackedVertex, Normal);
+		// Texture Coordinates
+		inputAttributeDescriptions[2].binding = 0;
+		inputAttributeDescriptions[2].location = 2;
+		inputAttributeDescriptions[2].format = VK_FORMAT_R16G16_SFLOAT;
+		inputAttributeDescriptions[2].offset = offsetof(SPackedVertex, TextureCoords);
+
+		return inputAttributeDescriptions;
+	}
+
+	// Normalized to the mesh bounds. The fourth component is padding, three component
+	// 16 bit formats are rarely supported as vertex inputs
+	std::array<uint16_t, 4> Position;
+	// Octahedral encoding
+	std::array<int16_t, 2> Normal;
+	// Half floats
+	std::array<uint16_t, 2> TextureCoords;
+};
+
+// Pushed for every mesh drawn with SPackedVertex, Position = PositionOffset + quantized * PositionScale
+struct SMeshPushConstants
+{
+	glm::vec4 PositionOffset;
+	glm::vec4 PositionScale;
+};
+
+struct SMemoryBlock;
+
+// A range of device memory handed out by CDeviceMemoryAllocator
+struct SMemoryAllocation
+{
+	VkDeviceMemory Memory = nullptr;
+	VkDeviceSize Offset = 0;
+	VkDeviceSize Size = 0;
+	// Start of the range in the persistent mapping of host visible memory, null otherwise
+	void* pMappedData = nullptr;
+	// Null when the allocation has a VkDeviceMemory of its own
+	SMemoryBlock* pBlock = nullptr;
+	uint32_t Handle = 0;
+};
+
 struct SBuffer
 {
 	VkBuffer Buffer = nullptr;
-	VkDeviceMemory BufferMemory = nullptr;
+	SMemoryAllocation Allocation;
+};
+
+// Where a mesh lives inside its CGeometryArena
+struct SGeometryRange
+{
+	// In vertices, the vertexOffset of every draw of the mesh
+	uint32_t VertexOffset = 0;
+	uint32_t VertexCount = 0;
+	// In indices, added to the firstIndex of every draw of the mesh
+	uint32_t FirstIndex = 0;
+	uint32_t IndexCount = 0;
+	uint32_t VertexHandle = 0;
+	uint32_t IndexHandle = 0;
+};
+
+// A contiguous range of the mesh's index buffer. Every level indexes the same vertices
+struct SLodLevel
+{
+	uint32_t FirstIndex = 0;
+	uint32_t IndexCount = 0;
+	// Largest surface deviation from the full detail mesh, in mesh units
+	float Error = 0.0f;
+};
+
+// A range of the index buffer drawn with a single vkCmdDrawIndexed
+struct SDrawRange
+{
+	bool operator==(const SDrawRange& other) const
+	{
+		return FirstIndex == other.FirstIndex && IndexCount == other.IndexCount;
+	}
+
+	uint32_t FirstIndex = 0;
+	uint32_t IndexCount = 0;
+};
+
+// Small clusters of level 0's triangles, stored as a structure of arrays with one entry per meshlet
+struct SMeshlets
+{
+	[[nodiscard]] size_t GetCount() const { return VecFirstIndex.size(); }
+
+	// Every meshlet is a contiguous range of the index buffer
+	std::vector<uint32_t> VecFirstIndex;
+	std::vector<uint32_t> VecIndexCount;
+	// Mesh space centre in xyz, radius in w
+	std::vector<glm::vec4> VecBoundingSphere;
+	// Average triangle normal in xyz, cone cutoff in w. A cutoff of 1 never culls
+	std::vector<glm::vec4> VecNormalCone;
 };
 
 struct SModelInformation
 {
+	[[nodiscard]] const SVertex* GetVertexData() const
+	{
+		return MappedCache ? pMappedVertex : VecVertex.data();
+	}
+	[[nodiscard]] const uint32_t* GetIndexData() const
+	{
+		return MappedCache ? pMappedIndex : VecIndex.data();
+	}
+	// What gets copied into the vertex buffer, in the layout VertexFormat describes
+	[[nodiscard]] const void* GetVertexBufferData() const
+	{
+		if (VertexFormat == EVertexFormat::Packed)
+			return VecPackedVertex.data();
+		return GetVertexData();
+	}
+	[[nodiscard]] size_t GetVertexStride() const
+	{
+		return VertexFormat == EVertexFormat::Packed ? sizeof(SPackedVertex) : sizeof(SVertex);
+	}
+	[[nodiscard]] size_t GetVertexBufferSize() const { return GetVertexStride() * VertexCount; }
+	// What gets copied into the index buffer, in the width IndexType describes
+	[[nodiscard]] const void* GetIndexBufferData() const
+	{
+		if (IndexType == VK_INDEX_TYPE_UINT16)
+			return VecIndex16.data();
+		return GetIndexData();
+	}
+	[[nodiscard]] size_t GetIndexStride() const
+	{
+		return IndexType == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t);
+	}
+	[[nodiscard]] size_t GetIndexBufferSize() const { return GetIndexStride() * IndexCount; }
+
+	// Drops the CPU copy of the geometry once it has been uploaded, the counts are kept for drawing
+	void ReleaseGeometryData()
+	{
+		VecVertex = {};
+		VecIndex = {};
+		VecPackedVertex = {};
+		VecIndex16 = {};
+		MappedCache.reset();
+		pMappedVertex = nullptr;
+		pMappedIndex = nullptr;
+	}
+
 	std::vector<SVertex> VecVertex;
 	std::vector<uint32_t> VecIndex;
-	SBuffer VertexBuffer;
-	SBuffer IndexBuffer;
-	SBuffer UniformBuffer;
+	// Set when the model came from the binary mesh cache, VecVertex and VecIndex
+	// are left empty and the arrays are read straight from the mapped file
+	std::shared_ptr<CMappedFile> MappedCache;
+	const SVertex* pMappedVertex = nullptr;
+	const uint32_t* pMappedIndex = nullptr;
+	// Filled by CVertexQuantizer when the mesh is drawn with EVertexFormat::Packed
+	std::vector<SPackedVertex> VecPackedVertex;
+	SMeshPushConstants PackedDequantization = {};
+	EVertexFormat VertexFormat = EVertexFormat::Float;
+	// Filled instead of using VecIndex when every index fits in 16 bits
+	std::vector<uint16_t> VecIndex16;
+	VkIndexType IndexType = VK_INDEX_TYPE_UINT32;
+	uint32_t VertexCount = 0;
+	// Covers every level of detail
+	uint32_t IndexCount = 0;
+	// Level 0 is the full detail mesh, each following level has roughly half the triangles
+	std::vector<SLodLevel> VecLod;
+	// Bounding sphere in mesh space, used to pick the level of detail
+	glm::vec3 BoundsCenter = glm::vec3(0.0f);
+	float BoundsRadius = 0.0f;
+	// Bounding box in mesh space, used for frustum culling on the CPU
+	glm::vec3 BoundsMin = glm::vec3(0.0f);
+	glm::vec3 BoundsMax = glm::vec3(0.0f);
+	// Only built when the scene asks for it, empty otherwise
+	SMeshlets Meshlets;
+	// Owned by CMeshRegistry, shared with the meshes of the same vertex format and index type
+	CGeometryArena* pGeometryArena = nullptr;
+	SGeometryRange GeometryRange;
+	// Set once the buffers have finished uploading and the mesh can be drawn
+	bool IsResident = false;
+	// Set when loading or uploading it threw. The registry has dropped it, acquiring the file again retries it
+	bool IsFailed = false;
 };
 
 struct SObjectInformation
@@ -83,4 +289,9 @@ struct SObjectInformation
 	}
 	std::string FileName;
 	std::string ObjectName;
+	// Objects only share a mesh when they use the same file with the same settings
+	EVertexFormat VertexFormat = EVertexFormat::Float;
+	bool BuildMeshlets = false;
+	// In degrees, only used when the OBJ has no normals of its own. 180 smooths across every edge
+	float CreaseAngle = 180.0f;
 };
\ No newline at end of file
@@ -0,0 +1,280 @@
+#include "DeviceMemoryAllocator.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace
+{
+	constexpr VkDeviceSize DEFAULT_BLOCK_SIZE = VkDeviceSize(64) << 20;
+	// Heaps up to this size get blocks of an eighth of the heap instead
+	constexpr VkDeviceSize SMALL_HEAP_SIZE = VkDeviceSize(1) << 30;
+}
+
+CVulkanDeviceMemory::CVulkanDeviceMemory(const VkDevice& device, const VkPhysicalDevice& physicalDevice) : device(device)
+{
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+	bufferImageGranularity = std::max<VkDeviceSize>(properties.limits.bufferImageGranularity, 1);
+	maxMemoryAllocationCount = properties.limits.maxMemoryAllocationCount;
+}
+
+VkDeviceMemory CVulkanDeviceMemory::AllocateMemory(const VkDeviceSize size, const uint32_t memoryTypeIndex)
+{
+	VkMemoryAllocateInfo memoryAllocateInfo = {};
+	memoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	memoryAllocateInfo.allocationSize = size;
+	memoryAllocateInfo.memoryTypeIndex = memoryTypeIndex;
+
+	VkDeviceMemory memory = nullptr;
+	if (vkAllocateMemory(device, &memoryAllocateInfo, nullptr, &memory) != VK_SUCCESS)
+		return nullptr;
+	return memory;
+}
+
+void CVulkanDeviceMemory::FreeMemory(const VkDeviceMemory memory)
+{
+	vkFreeMemory(device, memory, nullptr);
+}
+
+void* CVulkanDeviceMemory::MapMemory(const VkDeviceMemory memory)
+{
+	void* pMappedData = nullptr;
+	if (vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, &pMappedData) != VK_SUCCESS)
+		return nullptr;
+	return pMappedData;
+}
+
+void CDeviceMemoryAllocator::Init(const VkDevice& device, const VkPhysicalDevice& physicalDevice)
+{
+	this->device = device;
+	pVulkanDeviceMemory = std::make_unique<CVulkanDeviceMemory>(device, physicalDevice);
+	Init(*pVulkanDeviceMemory);
+}
+
+void CDeviceMemoryAllocator::Init(IDeviceMemory& deviceMemory)
+{
+	pDeviceMemory = &deviceMemory;
+	memoryProperties = deviceMemory.GetMemoryProperties();
+	bufferImageGranularity = deviceMemory.GetBufferImageGranularity();
+	maxMemoryAllocationCount = deviceMemory.GetMaxMemoryAllocationCount();
+}
+
+void CDeviceMemoryAllocator::Cleanup()
+{
+	for (auto& vecBlock : arrVecBlock)
+	{
+		for (auto& pBlock : vecBlock)
+		{
+			if (!pBlock->pMetadata->IsEmpty())
+			{
+				std::cout << "A device memory block still holds " << pBlock->pMetadata->GetAllocationCount()
+					<< " allocations at cleanup" << std::endl;
+			}
+			freeDeviceMemory(pBlock->Memory);
+		}
+		vecBlock.clear();
+	}
+	pDeviceMemory = nullptr;
+	pVulkanDeviceMemory.reset();
+}
+
+SMemoryAllocation CDeviceMemoryAllocator::Allocate(const VkMemoryRequirements& requirements, const VkMemoryPropertyFlags properties,
+												   const EAllocationType type, const EAllocationStrategy strategy)
+{
+	const auto memoryTypeIndex = findMemoryType(requirements.memoryTypeBits, properties);
+	const auto blockSize = getBlockSize(memoryTypeIndex);
+
+	SMemoryAllocation allocation;
+	allocation.Size = requirements.size;
+	if (requirements.size <= blockSize / 2)
+	{
+		const auto poolIndex = memoryTypeIndex * STRATEGY_COUNT + static_cast<uint32_t>(strategy);
+		auto& vecBlock = arrVecBlock[poolIndex];
+
+		SBlockAllocation blockAllocation;
+		SMemoryBlock* pBlock = nullptr;
+		for (auto& pCandidate : vecBlock)
+		{
+			if (pCandidate->pMetadata->Allocate(requirements.size, requirements.alignment, type, blockAllocation))
+			{
+				pBlock = pCandidate.get();
+				break;
+			}
+		}
+
+		if (pBlock == nullptr)
+		{
+			auto pNewBlock = std::make_unique<SMemoryBlock>();
+			pNewBlock->Memory = allocateDeviceMemory(blockSize, memoryTypeIndex, pNewBlock->pMappedData);
+			if (pNewBlock->Memory != nullptr)
+			{
+				if (strategy == EAllocationStrategy::Linear)
+					pNewBlock->pMetadata = std::make_unique<CLinearBlockMetadata>(blockSize, bufferImageGranularity);
+				else
+					pNewBlock->pMetadata = std::make_unique<CTlsfBlockMetadata>(blockSize, bufferImageGranularity);
+				pNewBlock->PoolIndex = poolIndex;
+				pNewBlock->pMetadata->Allocate(requirements.size, requirements.alignment, type, blockAllocation);
+				pBlock = pNewBlock.get();
+				vecBlock.push_back(std::move(pNewBlock));
+			}
+		}
+
+		if (pBlock != nullptr)
+		{
+			allocation.Memory = pBlock->Memory;
+			allocation.Offset = blockAllocation.Offset;
+			allocation.pMappedData = pBlock->pMappedData != nullptr ? pBlock->pMappedData + blockAllocation.Offset : nullptr;
+			allocation.pBlock = pBlock;
+			allocation.Handle = blockAllocation.Handle;
+			return allocation;
+		}
+		// No room for another block, the resource on its own may still fit
+	}
+
+	uint8_t* pMappedData = nullptr;
+	allocation.Memory = allocateDeviceMemory(requirements.size, memoryTypeIndex, pMappedData);
+	if (allocation.Memory == nullptr)
+	{
+		throw std::runtime_error("Failed to allocate device memory.");
+	}
+	allocation.pMappedData = pMappedData;
+	return allocation;
+}
+
+void CDeviceMemoryAllocator::Free(SMemoryAllocation& allocation)
+{
+	if (allocation.Memory == nullptr)
+		return;
+
+	auto* pBlock = allocation.pBlock;
+	if (pBlock == nullptr)
+	{
+		freeDeviceMemory(allocation.Memory);
+		allocation = {};
+		return;
+	}
+
+	pBlock->pMetadata->Free({ allocation.Offset, allocation.Size, allocation.Handle });
+	allocation = {};
+	if (!pBlock->pMetadata->IsEmpty())
+		return;
+
+	// One empty block is kept per pool so that loading and releasing a mesh over and over
+	// doesn't allocate and free a block every time
+	auto& vecBlock = arrVecBlock[pBlock->PoolIndex];
+	const auto emptyBlockCount = std::count_if(vecBlock.begin(), vecBlock.end(), [](const auto& pCandidate)
+	{
+		return pCandidate->pMetadata->IsEmpty();
+	});
+	if (emptyBlockCount > 1)
+	{
+		freeDeviceMemory(pBlock->Memory);
+		vecBlock.erase(std::find_if(vecBlock.begin(), vecBlock.end(), [pBlock](const auto& pCandidate)
+		{
+			return pCandidate.get() == pBlock;
+		}));
+	}
+}
+
+void CDeviceMemoryAllocator::CreateBuffer(const VkDeviceSize size, const VkBufferUsageFlags usageFlags, const VkMemoryPropertyFlags properties,
+										  SBuffer& outBuffer, const EAllocationStrategy strategy)
+{
+	VkBufferCreateInfo bufferCreateInfo = {};
+	bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferCreateInfo.size = size;
+	bufferCreateInfo.usage = usageFlags;
+	bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	if (vkCreateBuffer(device, &bufferCreateInfo, nullptr, &outBuffer.Buffer) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create the buffer.");
+	}
+
+	VkMemoryRequirements memoryRequirements;
+	vkGetBufferMemoryRequirements(device, outBuffer.Buffer, &memoryRequirements);
+	outBuffer.Allocation = Allocate(memoryRequirements, properties, EAllocationType::Linear, strategy);
+
+	vkBindBufferMemory(device, outBuffer.Buffer, outBuffer.Allocation.Memory, outBuffer.Allocation.Offset);
+}
+
+void CDeviceMemoryAllocator::DestroyBuffer(SBuffer& buffer)
+{
+	vkDestroyBuffer(device, buffer.Buffer, nullptr);
+	Free(buffer.Allocation);
+	buffer.Buffer = nullptr;
+}
+
+void CDeviceMemoryAllocator::CreateImage(const VkImageCreateInfo& imageCreateInfo, const VkMemoryPropertyFlags properties, VkImage& outImage,
+										 SMemoryAllocation& outAllocation)
+{
+	if (vkCreateImage(device, &imageCreateInfo, nullptr, &outImage) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create the image.");
+	}
+
+	VkMemoryRequirements memoryRequirements;
+	vkGetImageMemoryRequirements(device, outImage, &memoryRequirements);
+	const auto type = imageCreateInfo.tiling == VK_IMAGE_TILING_OPTIMAL ? EAllocationType::Optimal : EAllocationType::Linear;
+	outAllocation = Allocate(memoryRequirements, properties, type, EAllocationStrategy::General);
+
+	vkBindImageMemory(device, outImage, outAllocation.Memory, outAllocation.Offset);
+}
+
+void CDeviceMemoryAllocator::DestroyImage(VkImage& image, SMemoryAllocation& allocation)
+{
+	vkDestroyImage(device, image, nullptr);
+	Free(allocation);
+	image = nullptr;
+}
+
+uint32_t CDeviceMemoryAllocator::findMemoryType(const uint32_t memoryTypeBits, const VkMemoryPropertyFlags properties) const
+{
+	for (uint32_t i = 0; i != memoryProperties.memoryTypeCount; i++)
+	{
+		if ((memoryTypeBits & (1 << i)) && (memoryProperties.memoryTypes[i].propertyFlags & properties) == properties)
+		{
+			return i;
+		}
+	}
+
+	throw std::runtime_error("Failed to find a suitable memory type.");
+}
+
+VkDeviceSize CDeviceMemoryAllocator::getBlockSize(const uint32_t memoryTypeIndex) const
+{
+	const auto heapSize = memoryProperties.memoryHeaps[memoryProperties.memoryTypes[memoryTypeIndex].heapIndex].size;
+	return heapSize <= SMALL_HEAP_SIZE ? heapSize / 8 : DEFAULT_BLOCK_SIZE;
+}
+
+VkDeviceMemory CDeviceMemoryAllocator::allocateDeviceMemory(const VkDeviceSize size, const uint32_t memoryTypeIndex, uint8_t*& outMappedData)
+{
+	if (maxMemoryAllocationCount != 0 && deviceMemoryCount == maxMemoryAllocationCount)
+	{
+		throw std::runtime_error("Reached maxMemoryAllocationCount.");
+	}
+
+	const auto memory = pDeviceMemory->AllocateMemory(size, memoryTypeIndex);
+	if (memory == nullptr)
+		return nullptr;
+	++deviceMemoryCount;
+
+	outMappedData = nullptr;
+	if (memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+	{
+		outMappedData = static_cast<uint8_t*>(pDeviceMemory->MapMemory(memory));
+		if (outMappedData == nullptr)
+		{
+			freeDeviceMemory(memory);
+			throw std::runtime_error("Failed to map device memory.");
+		}
+	}
+	return memory;
+}
+
+void CDeviceMemoryAllocator::freeDeviceMemory(const VkDeviceMemory memory)
+{
+	pDeviceMemory->FreeMemory(memory);
+	--deviceMemoryCount;
+}
\ No newline at end of file
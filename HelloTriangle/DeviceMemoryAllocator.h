@@ -0,0 +1,122 @@
+#pragma once
+#include "CommonStructs.h"
+#include "MemoryBlockMetadata.h"
+
+#include <vulkan/vulkan_core.h>
+
+#include <array>
+#include <memory>
+#include <vector>
+
+enum class EAllocationStrategy : uint8_t
+{
+	// TLSF, for resources that are freed in any order
+	General,
+	// Bump allocation, for short-lived resources that are freed together like staging buffers
+	Linear
+};
+
+// One vkAllocateMemory call that resources are placed into
+struct SMemoryBlock
+{
+	VkDeviceMemory Memory = nullptr;
+	// Whole block mapping, null unless the memory type is host visible
+	uint8_t* pMappedData = nullptr;
+	std::unique_ptr<IBlockMetadata> pMetadata;
+	uint32_t PoolIndex = 0;
+};
+
+// The device memory calls the allocator makes, behind an interface so that its block
+// management can be tested without a device
+class IDeviceMemory
+{
+public:
+	IDeviceMemory() = default;
+	virtual ~IDeviceMemory() = default;
+	IDeviceMemory(const IDeviceMemory&) = delete;
+	IDeviceMemory(IDeviceMemory&&) = delete;
+	IDeviceMemory& operator=(const IDeviceMemory&) = delete;
+	IDeviceMemory& operator=(IDeviceMemory&&) = delete;
+
+	[[nodiscard]] virtual const VkPhysicalDeviceMemoryProperties& GetMemoryProperties() const = 0;
+	[[nodiscard]] virtual VkDeviceSize GetBufferImageGranularity() const = 0;
+	// Zero when there is no limit
+	[[nodiscard]] virtual uint32_t GetMaxMemoryAllocationCount() const = 0;
+
+	// Returns null when the device is out of memory
+	virtual VkDeviceMemory AllocateMemory(VkDeviceSize size, uint32_t memoryTypeIndex) = 0;
+	// Freeing also unmaps
+	virtual void FreeMemory(VkDeviceMemory memory) = 0;
+	// Maps the whole allocation, returns null on failure
+	virtual void* MapMemory(VkDeviceMemory memory) = 0;
+};
+
+class CVulkanDeviceMemory final : public IDeviceMemory
+{
+public:
+	CVulkanDeviceMemory(const VkDevice& device, const VkPhysicalDevice& physicalDevice);
+
+	[[nodiscard]] const VkPhysicalDeviceMemoryProperties& GetMemoryProperties() const override { return memoryProperties; }
+	[[nodiscard]] VkDeviceSize GetBufferImageGranularity() const override { return bufferImageGranularity; }
+	[[nodiscard]] uint32_t GetMaxMemoryAllocationCount() const override { return maxMemoryAllocationCount; }
+
+	VkDeviceMemory AllocateMemory(VkDeviceSize size, uint32_t memoryTypeIndex) override;
+	void FreeMemory(VkDeviceMemory memory) override;
+	void* MapMemory(VkDeviceMemory memory) override;
+
+private:
+	VkDevice device = nullptr;
+	VkPhysicalDeviceMemoryProperties memoryProperties = {};
+	VkDeviceSize bufferImageGranularity = 1;
+	uint32_t maxMemoryAllocationCount = 0;
+};
+
+// Reserves large blocks of device memory per memory type and strategy and places buffers and images
+// inside them, so a scene costs a handful of vkAllocateMemory calls rather than one per resource.
+// Resources bigger than half a block get a dedicated allocation. Host visible memory stays mapped
+// for as long as it's allocated. Not thread safe
+class CDeviceMemoryAllocator
+{
+public:
+	void Init(const VkDevice& device, const VkPhysicalDevice& physicalDevice);
+	// Places allocations in memory from deviceMemory, only Allocate and Free may be used then
+	void Init(IDeviceMemory& deviceMemory);
+	// Frees every block, the resources placed in them must have been destroyed
+	void Cleanup();
+
+	// Throws std::runtime_error when no memory type matches or the device is out of memory
+	[[nodiscard]] SMemoryAllocation Allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties,
+											 EAllocationType type, EAllocationStrategy strategy);
+	void Free(SMemoryAllocation& allocation);
+
+	void CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags properties, SBuffer& outBuffer,
+					  EAllocationStrategy strategy = EAllocationStrategy::General);
+	void DestroyBuffer(SBuffer& buffer);
+	void CreateImage(const VkImageCreateInfo& imageCreateInfo, VkMemoryPropertyFlags properties, VkImage& outImage,
+					 SMemoryAllocation& outAllocation);
+	void DestroyImage(VkImage& image, SMemoryAllocation& allocation);
+
+	// Live vkAllocateMemory allocations, the device allows maxMemoryAllocationCount of them
+	[[nodiscard]] uint32_t GetDeviceMemoryCount() const { return deviceMemoryCount; }
+
+private:
+	static constexpr uint32_t STRATEGY_COUNT = 2;
+
+	// Throws std::runtime_error when no memory type matches
+	[[nodiscard]] uint32_t findMemoryType(uint32_t memoryTypeBits, VkMemoryPropertyFlags properties) const;
+	[[nodiscard]] VkDeviceSize getBlockSize(uint32_t memoryTypeIndex) const;
+	// Returns null when the device is out of memory
+	VkDeviceMemory allocateDeviceMemory(VkDeviceSize size, uint32_t memoryTypeIndex, uint8_t*& outMappedData);
+	void freeDeviceMemory(VkDeviceMemory memory);
+
+	VkDevice device = nullptr;
+	std::unique_ptr<CVulkanDeviceMemory> pVulkanDeviceMemory;
+	// Not owned
+	IDeviceMemory* pDeviceMemory = nullptr;
+	VkPhysicalDeviceMemoryProperties memoryProperties = {};
+	VkDeviceSize bufferImageGranularity = 1;
+	uint32_t maxMemoryAllocationCount = 0;
+	uint32_t deviceMemoryCount = 0;
+	// A pool of blocks per memory type and strategy
+	std::array<std::vector<std::unique_ptr<SMemoryBlock>>, VK_MAX_MEMORY_TYPES * STRATEGY_COUNT> arrVecBlock;
+};
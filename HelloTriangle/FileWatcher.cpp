@@ -0,0 +1,90 @@
+#include "FileWatcher.h"
+
+#include <iostream>
+
+#ifdef __linux__
+#include <filesystem>
+
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+#ifdef __linux__
+	// Whole events only, a read never splits one
+	constexpr size_t INOTIFY_BUFFER_SIZE = 4096;
+#else
+	constexpr std::chrono::milliseconds POLL_INTERVAL(500);
+#endif
+}
+
+#ifdef __linux__
+CFileWatcher::CFileWatcher(const std::string& filename)
+{
+	const std::filesystem::path path(filename);
+	fileLeafName = path.filename().string();
+	const auto directory = path.has_parent_path() ? path.parent_path().string() : std::string(".");
+
+	inotifyDescriptor = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (inotifyDescriptor == -1 ||
+		inotify_add_watch(inotifyDescriptor, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) == -1)
+	{
+		std::cout << "Failed to watch " << filename << ", changes to it are ignored" << std::endl;
+	}
+}
+
+CFileWatcher::~CFileWatcher()
+{
+	if (inotifyDescriptor != -1)
+		close(inotifyDescriptor);
+}
+
+bool CFileWatcher::HasChanged()
+{
+	if (inotifyDescriptor == -1)
+		return false;
+
+	bool hasChanged = false;
+	alignas(inotify_event) char buffer[INOTIFY_BUFFER_SIZE];
+	ssize_t length;
+	while ((length = read(inotifyDescriptor, buffer, sizeof(buffer))) > 0)
+	{
+		for (ssize_t offset = 0; offset < length;)
+		{
+			const auto* pEvent = reinterpret_cast<const inotify_event*>(buffer + offset);
+			// The name is null padded, and absent for events on the directory itself
+			if (pEvent->len != 0 && fileLeafName == pEvent->name)
+				hasChanged = true;
+			offset += static_cast<ssize_t>(sizeof(inotify_event) + pEvent->len);
+		}
+	}
+	return hasChanged;
+}
+#else
+CFileWatcher::CFileWatcher(const std::string& filename) : path(filename)
+{
+	std::error_code error;
+	lastWriteTime = std::filesystem::last_write_time(path, error);
+	lastPollTime = std::chrono::steady_clock::now();
+}
+
+CFileWatcher::~CFileWatcher() = default;
+
+bool CFileWatcher::HasChanged()
+{
+	const auto now = std::chrono::steady_clock::now();
+	if (now - lastPollTime < POLL_INTERVAL)
+		return false;
+	lastPollTime = now;
+
+	// Fails while an editor has the file replaced, the next poll picks up the new one
+	std::error_code error;
+	const auto writeTime = std::filesystem::last_write_time(path, error);
+	if (error || writeTime == lastWriteTime)
+		return false;
+
+	lastWriteTime = writeTime;
+	return true;
+}
+#endif
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <string>
+
+#ifndef __linux__
+#include <chrono>
+#include <filesystem>
+#endif
+
+// Tells when a file has been written. On Linux inotify watches the containing directory, so
+// editors that save to a temporary file and rename it over the original are caught as well.
+// Elsewhere the last write time is polled a couple of times per second
+class CFileWatcher
+{
+public:
+	explicit CFileWatcher(const std::string& filename);
+	~CFileWatcher();
+	CFileWatcher(const CFileWatcher&) = delete;
+	CFileWatcher& operator=(const CFileWatcher&) = delete;
+	CFileWatcher(CFileWatcher&&) = delete;
+	CFileWatcher& operator=(CFileWatcher&&) = delete;
+
+	// Never blocks. True once for all the writes since the previous call
+	[[nodiscard]] bool HasChanged();
+
+private:
+#ifdef __linux__
+	std::string fileLeafName;
+	int inotifyDescriptor = -1;
+#else
+	std::filesystem::path path;
+	std::filesystem::file_time_type lastWriteTime;
+	std::chrono::steady_clock::time_point lastPollTime;
+#endif
+};
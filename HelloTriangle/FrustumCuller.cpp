@@ -0,0 +1,226 @@
+#include "FrustumCuller.h"
+#include "ObjectCuller.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <immintrin.h>
+#include <iostream>
+#include <random>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// MSVC compiles any intrinsic without /arch, the other compilers need the target on the function using them
+#ifdef _MSC_VER
+#define AVX2_TARGET
+#else
+#define AVX2_TARGET __attribute__((target("avx2,fma")))
+#endif
+
+namespace
+{
+	constexpr size_t BOXES_PER_ITERATION = 8;
+	// Smaller sets aren't worth waking the workers for
+	constexpr size_t MIN_BOXES_PER_THREAD = 1 << 16;
+
+	bool hasAvx2()
+	{
+#ifdef _MSC_VER
+		int cpuInfo[4];
+		__cpuid(cpuInfo, 0);
+		if (cpuInfo[0] < 7)
+			return false;
+		// FMA and OSXSAVE, then the OS has to save the YMM registers
+		__cpuid(cpuInfo, 1);
+		if ((cpuInfo[2] & (1 << 12)) == 0 || (cpuInfo[2] & (1 << 27)) == 0 || (_xgetbv(0) & 6) != 6)
+			return false;
+		__cpuidex(cpuInfo, 7, 0);
+		return (cpuInfo[1] & (1 << 5)) != 0;
+#else
+		return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+	}
+
+	// For each plane, the corner of every box furthest along its normal: the box is outside when even that
+	// corner is behind the plane
+	struct SPlaneCorner
+	{
+		glm::vec4 Plane;
+		const float* pX;
+		const float* pY;
+		const float* pZ;
+	};
+
+	AVX2_TARGET size_t cullAvx2(const std::array<SPlaneCorner, 6>& arrCorner, const size_t begin, const size_t end, uint8_t* pVisible)
+	{
+		auto index = begin;
+		for (; index + BOXES_PER_ITERATION <= end; index += BOXES_PER_ITERATION)
+		{
+			auto inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+			for (const auto& corner : arrCorner)
+			{
+				auto distance = _mm256_set1_ps(corner.Plane.w);
+				distance = _mm256_fmadd_ps(_mm256_set1_ps(corner.Plane.x), _mm256_loadu_ps(corner.pX + index), distance);
+				distance = _mm256_fmadd_ps(_mm256_set1_ps(corner.Plane.y), _mm256_loadu_ps(corner.pY + index), distance);
+				distance = _mm256_fmadd_ps(_mm256_set1_ps(corner.Plane.z), _mm256_loadu_ps(corner.pZ + index), distance);
+				inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, _mm256_setzero_ps(), _CMP_GE_OQ));
+			}
+
+			// One byte per box, 0 or 1
+			const auto visible = _mm256_and_si256(_mm256_castps_si256(inside), _mm256_set1_epi32(1));
+			const auto packed = _mm256_packus_epi32(visible, visible);
+			const auto bytes = _mm256_packus_epi16(packed, packed);
+			const auto low = static_cast<uint32_t>(_mm256_extract_epi32(bytes, 0));
+			const auto high = static_cast<uint32_t>(_mm256_extract_epi32(bytes, 4));
+			std::memcpy(pVisible + index, &low, sizeof(low));
+			std::memcpy(pVisible + index + 4, &high, sizeof(high));
+		}
+		return index;
+	}
+
+	void cullScalar(const std::array<SPlaneCorner, 6>& arrCorner, const size_t begin, const size_t end, uint8_t* pVisible)
+	{
+		for (auto index = begin; index != end; ++index)
+		{
+			uint8_t isInside = 1;
+			for (const auto& corner : arrCorner)
+			{
+				const auto distance = corner.Plane.x * corner.pX[index] + corner.Plane.y * corner.pY[index] +
+					corner.Plane.z * corner.pZ[index] + corner.Plane.w;
+				isInside &= distance >= 0.0f ? 1 : 0;
+			}
+			pVisible[index] = isInside;
+		}
+	}
+}
+
+CFrustumCuller::CFrustumCuller(CThreadPool& threadPool) : pThreadPool(&threadPool)
+{
+	isAvx2Supported = hasAvx2();
+	maxThreadCount = threadPool.GetWorkerCount() + 1;
+}
+
+void CFrustumCuller::Resize(const size_t count)
+{
+	vecMinX.resize(count);
+	vecMinY.resize(count);
+	vecMinZ.resize(count);
+	vecMaxX.resize(count);
+	vecMaxY.resize(count);
+	vecMaxZ.resize(count);
+}
+
+void CFrustumCuller::SetBounds(const size_t index, const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+{
+	vecMinX[index] = boundsMin.x;
+	vecMinY[index] = boundsMin.y;
+	vecMinZ[index] = boundsMin.z;
+	vecMaxX[index] = boundsMax.x;
+	vecMaxY[index] = boundsMax.y;
+	vecMaxZ[index] = boundsMax.z;
+}
+
+void CFrustumCuller::SetBounds(const size_t index, const glm::vec3& meshBoundsMin, const glm::vec3& meshBoundsMax, const glm::mat4& model)
+{
+	// Arvo's method: the centre is transformed, the half extents through the absolute rotation and scale
+	const auto center = glm::vec3(model * glm::vec4((meshBoundsMin + meshBoundsMax) * 0.5f, 1.0f));
+	const auto halfExtent = (meshBoundsMax - meshBoundsMin) * 0.5f;
+	const auto worldHalfExtent = glm::abs(glm::vec3(model[0])) * halfExtent.x +
+		glm::abs(glm::vec3(model[1])) * halfExtent.y +
+		glm::abs(glm::vec3(model[2])) * halfExtent.z;
+	SetBounds(index, center - worldHalfExtent, center + worldHalfExtent);
+}
+
+size_t CFrustumCuller::Cull(const std::array<glm::vec4, 6>& arrPlane, std::vector<uint8_t>& vecVisible)
+{
+	const auto count = GetCount();
+	vecVisible.resize(count);
+
+	// Ranges start on whole iterations so only the last one has a scalar tail
+	const auto rangeCount = std::clamp<size_t>(count / MIN_BOXES_PER_THREAD, 1, maxThreadCount);
+	if (rangeCount == 1)
+	{
+		cullRange(arrPlane, 0, count, vecVisible.data());
+	}
+	else
+	{
+		const auto rangeStart = [count, rangeCount](const size_t range)
+		{
+			return range == rangeCount ? count : count * range / rangeCount / BOXES_PER_ITERATION * BOXES_PER_ITERATION;
+		};
+		pThreadPool->ParallelFor(rangeCount, [this, &arrPlane, &vecVisible, &rangeStart](const size_t range)
+		{
+			cullRange(arrPlane, rangeStart(range), rangeStart(range + 1), vecVisible.data());
+		});
+	}
+
+	return static_cast<size_t>(std::count(vecVisible.begin(), vecVisible.end(), uint8_t(1)));
+}
+
+void CFrustumCuller::cullRange(const std::array<glm::vec4, 6>& arrPlane, const size_t begin, const size_t end, uint8_t* pVisible) const
+{
+	std::array<SPlaneCorner, 6> arrCorner;
+	for (size_t plane = 0; plane != arrPlane.size(); ++plane)
+	{
+		const auto& normal = arrPlane[plane];
+		arrCorner[plane].Plane = normal;
+		arrCorner[plane].pX = normal.x >= 0.0f ? vecMaxX.data() : vecMinX.data();
+		arrCorner[plane].pY = normal.y >= 0.0f ? vecMaxY.data() : vecMinY.data();
+		arrCorner[plane].pZ = normal.z >= 0.0f ? vecMaxZ.data() : vecMinZ.data();
+	}
+
+	auto index = begin;
+	if (isAvx2Supported)
+		index = cullAvx2(arrCorner, begin, end, pVisible);
+	cullScalar(arrCorner, index, end, pVisible);
+}
+
+void CFrustumCuller::Benchmark(CThreadPool& threadPool, const uint32_t boxCount)
+{
+	// Boxes of up to two units scattered through a cube of 200 units around a camera at its centre
+	std::mt19937 generator(7);
+	std::uniform_real_distribution<float> positionDistribution(-100.0f, 100.0f);
+	std::uniform_real_distribution<float> sizeDistribution(0.1f, 2.0f);
+	CFrustumCuller culler(threadPool);
+	culler.Resize(boxCount);
+	for (uint32_t box = 0; box != boxCount; ++box)
+	{
+		const auto position = glm::vec3(positionDistribution(generator), positionDistribution(generator), positionDistribution(generator));
+		const auto halfSize = glm::vec3(sizeDistribution(generator)) * 0.5f;
+		culler.SetBounds(box, position - halfSize, position + halfSize);
+	}
+
+	const auto view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	const auto projection = glm::perspective(glm::radians(45.0f), 4.0f / 3.0f, 0.1f, 100.0f);
+	const auto arrPlane = CObjectCuller::GetFrustumPlanes(projection * view);
+
+	std::vector<uint8_t> vecVisible;
+	const auto time = [&](const char* name, const bool isAvx2, const uint32_t threadCount)
+	{
+		culler.isAvx2Supported = isAvx2;
+		culler.maxThreadCount = threadCount;
+		size_t visibleCount = 0;
+		// The first run wakes the workers and touches the output
+		culler.Cull(arrPlane, vecVisible);
+		constexpr auto RUN_COUNT = 20;
+		const auto startTime = std::chrono::high_resolution_clock::now();
+		for (auto run = 0; run != RUN_COUNT; ++run)
+		{
+			visibleCount = culler.Cull(arrPlane, vecVisible);
+		}
+		const auto cullTime = std::chrono::duration<float, std::chrono::milliseconds::period>(
+			std::chrono::high_resolution_clock::now() - startTime).count() / RUN_COUNT;
+		std::cout << "Frustum culling " << boxCount << " boxes, " << name << ": " << cullTime << " ms, "
+			<< visibleCount << " visible" << std::endl;
+	};
+
+	const auto canUseAvx2 = culler.isAvx2Supported;
+	const auto threadCount = culler.maxThreadCount;
+	time("scalar", false, 1);
+	if (canUseAvx2)
+		time("AVX2", true, 1);
+	time(canUseAvx2 ? "AVX2 multithreaded" : "scalar multithreaded", canUseAvx2, threadCount);
+}
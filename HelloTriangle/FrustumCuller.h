@@ -0,0 +1,46 @@
+#pragma once
+#include "ThreadPool.h"
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <vector>
+
+// World space axis aligned boxes kept in one float array per component, tested against the six frustum
+// planes eight boxes per iteration with AVX2 and FMA when the CPU has them, one at a time otherwise.
+// Large sets are split across a shared thread pool
+class CFrustumCuller
+{
+public:
+	// The thread pool must outlive the culler
+	explicit CFrustumCuller(CThreadPool& threadPool);
+
+	// New boxes are empty and must be set before culling
+	void Resize(size_t count);
+	[[nodiscard]] size_t GetCount() const { return vecMinX.size(); }
+	void SetBounds(size_t index, const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+	// Stores the world space box enclosing the mesh space box transformed by the model matrix
+	void SetBounds(size_t index, const glm::vec3& meshBoundsMin, const glm::vec3& meshBoundsMax, const glm::mat4& model);
+
+	// The planes point inwards, like those of CObjectCuller::GetFrustumPlanes. Sets vecVisible[i] to 1 for every
+	// box intersecting or inside the frustum and 0 for the others, and returns how many are visible
+	size_t Cull(const std::array<glm::vec4, 6>& arrPlane, std::vector<uint8_t>& vecVisible);
+
+	// Times the scalar, the single threaded and the multithreaded culls of boxCount random boxes
+	static void Benchmark(CThreadPool& threadPool, uint32_t boxCount);
+
+private:
+	void cullRange(const std::array<glm::vec4, 6>& arrPlane, size_t begin, size_t end, uint8_t* pVisible) const;
+
+	std::vector<float> vecMinX;
+	std::vector<float> vecMinY;
+	std::vector<float> vecMinZ;
+	std::vector<float> vecMaxX;
+	std::vector<float> vecMaxY;
+	std::vector<float> vecMaxZ;
+	bool isAvx2Supported = false;
+	// The workers and the calling thread
+	uint32_t maxThreadCount = 1;
+	// Not owned
+	CThreadPool* pThreadPool;
+};
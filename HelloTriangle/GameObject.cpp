@@ -1,6 +1,16 @@
 #include "GameObject.h"
+#include "MeshletCuller.h"
 #include "ModelLoader.h"
 
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+namespace
+{
+	// Bounding sphere radius as a fraction of half the viewport height below which the next level is used
+	constexpr std::array<float, 3> LOD_SCREEN_COVERAGE = { 0.25f, 0.125f, 0.0625f };
+}
 
 IGameObject::IGameObject(SObjectInformation objectInfo, STransform transform)
 {
@@ -8,49 +18,74 @@ IGameObject::IGameObject(SObjectInformation objectInfo, STransform transform)
 	mTransform = transform;
 }
 
-VkBuffer& IGameObject::GetVertexBuffer() 
+const CGeometryArena& IGameObject::GetGeometryArena() const
 {
-	return mModelInformation.VertexBuffer.Buffer;
+	return *mModelInformation->pGeometryArena;
 }
 
-VkBuffer& IGameObject::GetIndexBuffer()
+const SGeometryRange& IGameObject::GetGeometryRange() const
 {
-	return mModelInformation.IndexBuffer.Buffer;
+	return mModelInformation->GeometryRange;
 }
 
-VkDeviceMemory& IGameObject::GetVertexBufferMemory()
+bool IGameObject::IsDrawable() const
 {
-	return mModelInformation.VertexBuffer.BufferMemory;
+	return mModelInformation && mModelInformation->IsResident;
 }
 
-VkDeviceMemory& IGameObject::GetIndexBufferMemory()
+void IGameObject::UpdateLod(const glm::mat4& modelView, const float projectionScaleY)
 {
-	return mModelInformation.IndexBuffer.BufferMemory;
-}
+	if (!IsDrawable())
+		return;
 
-const SVertex* IGameObject::GetVertexData() const
-{
-	return mModelInformation.VecVertex.data();
-}
+	const auto& modelInfo = *mModelInformation;
+	const auto viewCenter = glm::vec3(modelView * glm::vec4(modelInfo.BoundsCenter, 1.0f));
+	// The view matrix is rigid, so any scaling comes from the object's transform
+	const auto scale = std::max({ glm::length(glm::vec3(modelView[0])),
+								  glm::length(glm::vec3(modelView[1])),
+								  glm::length(glm::vec3(modelView[2])) });
+	const auto radius = modelInfo.BoundsRadius * scale;
+	// The camera looks down -Z in view space
+	const auto distance = -viewCenter.z;
 
-const uint32_t* IGameObject::GetIndexData() const
-{
-	return mModelInformation.VecIndex.data();
-}
+	uint32_t lodIndex = 0;
+	if (distance > radius)
+	{
+		const auto coverage = radius * std::abs(projectionScaleY) / distance;
+		while (lodIndex + 1 < modelInfo.VecLod.size() && lodIndex < LOD_SCREEN_COVERAGE.size() &&
+			   coverage < LOD_SCREEN_COVERAGE[lodIndex])
+		{
+			++lodIndex;
+		}
+	}
 
-size_t IGameObject::GetVertexBufferSize() const
-{
-	return sizeof(SVertex) * mModelInformation.VecVertex.size();
+	mLodIndex = lodIndex;
 }
 
-size_t IGameObject::GetIndexBufferSize() const
+const SLodLevel& IGameObject::GetLod() const
 {
-	return sizeof(uint32_t) * mModelInformation.VecVertex.size();
+	return mModelInformation->VecLod[mLodIndex];
 }
 
-uint32_t IGameObject::GetIndexArraySize() const
+void IGameObject::UpdateDrawRanges(const glm::mat4& modelView, const glm::mat4& projection, SMeshletCullStatistics& statistics)
 {
-	return static_cast<uint32_t>(mModelInformation.VecIndex.size());
+	if (!IsDrawable())
+		return;
+
+	std::vector<SDrawRange> vecDrawRange;
+	const auto& meshlets = mModelInformation->Meshlets;
+	if (mLodIndex != 0 || meshlets.GetCount() == 0)
+	{
+		const auto& lod = GetLod();
+		vecDrawRange.push_back({ lod.FirstIndex, lod.IndexCount });
+	}
+	else
+	{
+		const auto cameraPosition = glm::vec3(glm::inverse(modelView) * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+		CMeshletCuller::Cull(meshlets, projection * modelView, cameraPosition, vecDrawRange, statistics);
+	}
+
+	mVecDrawRange.swap(vecDrawRange);
 }
 
 CStaticGameObject::CStaticGameObject(SObjectInformation objectInfo, STransform transform)
@@ -1,8 +1,13 @@
 #pragma once
 #include "CommonStructs.h"
+#include "TypeAliases.h"
 
 #include <glm/glm.hpp>
 #include <memory>
+#include <vector>
+
+class CGeometryArena;
+struct SMeshletCullStatistics;
 
 class IGameObject
 {
@@ -18,29 +23,27 @@ public:
 	virtual void Update() = 0;
 	virtual void Draw() = 0;
 
-	[[nodiscard]] VkBuffer& GetVertexBuffer();
-	[[nodiscard]] VkBuffer& GetIndexBuffer();
-	[[nodiscard]] VkDeviceMemory& GetVertexBufferMemory();
-	[[nodiscard]] VkDeviceMemory& GetIndexBufferMemory();
-	[[nodiscard]] const SVertex* GetVertexData() const;
-	[[nodiscard]] const uint32_t* GetIndexData() const;
-	[[nodiscard]] size_t GetVertexBufferSize() const;
-	[[nodiscard]] size_t GetIndexBufferSize() const;
-	[[nodiscard]] uint32_t GetIndexArraySize() const;
-
-	void Cleanup(const VkDevice& device) const
-	{
-		vkDestroyBuffer(device, mModelInformation.VertexBuffer.Buffer, nullptr);
-		vkDestroyBuffer(device, mModelInformation.IndexBuffer.Buffer, nullptr);
-		vkDestroyBuffer(device, mModelInformation.UniformBuffer.Buffer, nullptr);
-		vkFreeMemory(device, mModelInformation.VertexBuffer.BufferMemory, nullptr);
-		vkFreeMemory(device, mModelInformation.IndexBuffer.BufferMemory, nullptr);
-		vkFreeMemory(device, mModelInformation.UniformBuffer.BufferMemory, nullptr);
-	}
-
+	// Holds the mesh along with every other mesh of the same vertex format and index type
+	[[nodiscard]] const CGeometryArena& GetGeometryArena() const;
+	[[nodiscard]] const SGeometryRange& GetGeometryRange() const;
+	// False while the mesh is still loading in the background
+	[[nodiscard]] bool IsDrawable() const;
+	// Picks the level of detail from the projected size of the mesh's bounding sphere
+	void UpdateLod(const glm::mat4& modelView, float projectionScaleY);
+	[[nodiscard]] const SLodLevel& GetLod() const;
+	// Culls the meshlets of level 0, or takes the whole level of detail when the mesh has none
+	void UpdateDrawRanges(const glm::mat4& modelView, const glm::mat4& projection, SMeshletCullStatistics& statistics);
+	[[nodiscard]] const std::vector<SDrawRange>& GetDrawRanges() const { return mVecDrawRange; }
+
+	// The model matrix is composed from it by CTransformSystem
 	STransform mTransform{};
-	SModelInformation mModelInformation;
+	// Shared with every other game object using the same file and mesh settings, owned by CMeshRegistry
+	ModelInformationSPtr mModelInformation;
 	SObjectInformation mObjectInformation;
+	uint32_t mLodIndex = 0;
+	std::vector<SDrawRange> mVecDrawRange;
+	// Cleared while the object is outside the view frustum, it's then left out of the draws
+	bool mIsVisible = true;
 };
 
 class CStaticGameObject final : public IGameObject
@@ -0,0 +1,104 @@
+#include "GeometryArena.h"
+#include "UploadBatch.h"
+
+#include <algorithm>
+
+namespace
+{
+	// Enough for a few detailed models before the first growth
+	constexpr uint64_t INITIAL_VERTEX_CAPACITY = uint64_t(1) << 20;
+	constexpr uint64_t INITIAL_INDEX_CAPACITY = uint64_t(4) << 20;
+}
+
+CGeometryArena::CGeometryArena(const uint32_t vertexStride, const VkIndexType indexType) :
+	vertexStride(vertexStride),
+	indexStride(indexType == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t)),
+	indexType(indexType)
+{
+	// Sized on the first allocation
+	pVertexRanges = std::make_unique<CTlsfBlockMetadata>(0, 1);
+	pIndexRanges = std::make_unique<CTlsfBlockMetadata>(0, 1);
+}
+
+bool CGeometryArena::TryAllocate(const uint32_t vertexCount, const uint32_t indexCount, SGeometryRange& outRange)
+{
+	SBlockAllocation vertexAllocation;
+	if (!pVertexRanges->Allocate(vertexCount, 1, EAllocationType::Linear, vertexAllocation))
+		return false;
+	SBlockAllocation indexAllocation;
+	if (!pIndexRanges->Allocate(indexCount, 1, EAllocationType::Linear, indexAllocation))
+	{
+		pVertexRanges->Free(vertexAllocation);
+		return false;
+	}
+
+	outRange.VertexOffset = static_cast<uint32_t>(vertexAllocation.Offset);
+	outRange.VertexCount = vertexCount;
+	outRange.VertexHandle = vertexAllocation.Handle;
+	outRange.FirstIndex = static_cast<uint32_t>(indexAllocation.Offset);
+	outRange.IndexCount = indexCount;
+	outRange.IndexHandle = indexAllocation.Handle;
+	return true;
+}
+
+void CGeometryArena::Grow(const VkDevice& device, CDeviceMemoryAllocator& allocator, const VkQueue& queue, const VkCommandPool& commandPool,
+						  const uint32_t vertexCount, const uint32_t indexCount)
+{
+	// Only the buffers that can't take their part are replaced
+	SBlockAllocation probe;
+	if (pVertexRanges->Allocate(vertexCount, 1, EAllocationType::Linear, probe))
+		pVertexRanges->Free(probe);
+	else
+		grow(device, allocator, queue, commandPool, vertexBuffer, *pVertexRanges, vertexStride,
+			 VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, INITIAL_VERTEX_CAPACITY, vertexCount);
+
+	if (pIndexRanges->Allocate(indexCount, 1, EAllocationType::Linear, probe))
+		pIndexRanges->Free(probe);
+	else
+		grow(device, allocator, queue, commandPool, indexBuffer, *pIndexRanges, indexStride,
+			 VK_BUFFER_USAGE_INDEX_BUFFER_BIT, INITIAL_INDEX_CAPACITY, indexCount);
+}
+
+void CGeometryArena::Free(SGeometryRange& range)
+{
+	pVertexRanges->Free({ range.VertexOffset, range.VertexCount, range.VertexHandle });
+	pIndexRanges->Free({ range.FirstIndex, range.IndexCount, range.IndexHandle });
+	range = {};
+}
+
+void CGeometryArena::Cleanup(CDeviceMemoryAllocator& allocator)
+{
+	allocator.DestroyBuffer(vertexBuffer);
+	allocator.DestroyBuffer(indexBuffer);
+}
+
+void CGeometryArena::grow(const VkDevice& device, CDeviceMemoryAllocator& allocator, const VkQueue& queue, const VkCommandPool& commandPool,
+						  SBuffer& buffer, CTlsfBlockMetadata& ranges, const uint32_t stride, const VkBufferUsageFlags usageFlags,
+						  const uint64_t initialCount, const uint32_t count)
+{
+	// Doubling keeps the number of copies logarithmic in the final size. The space added
+	// at the end is enough for count on its own, whatever the fragmentation
+	const auto oldCount = ranges.GetBlockSize();
+	const auto newCount = std::max({ initialCount, oldCount * 2, oldCount + count });
+
+	SBuffer newBuffer;
+	allocator.CreateBuffer(newCount * stride,
+						   VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | usageFlags,
+						   VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+						   newBuffer);
+
+	if (buffer.Buffer != nullptr)
+	{
+		// Uploads still in flight write into the old buffer, and frames in flight read from it
+		vkDeviceWaitIdle(device);
+
+		CUploadBatch uploadBatch;
+		uploadBatch.Begin(device, queue, commandPool);
+		uploadBatch.CopyBuffer(buffer.Buffer, 0, newBuffer.Buffer, 0, oldCount * stride);
+		uploadBatch.SubmitAndWait();
+
+		allocator.DestroyBuffer(buffer);
+	}
+	buffer = newBuffer;
+	ranges.Grow(newCount);
+}
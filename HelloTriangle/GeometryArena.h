@@ -0,0 +1,50 @@
+#pragma once
+#include "CommonStructs.h"
+#include "DeviceMemoryAllocator.h"
+#include "MemoryBlockMetadata.h"
+
+#include <vulkan/vulkan_core.h>
+
+#include <memory>
+
+// One device local vertex buffer and one index buffer shared by every mesh with the same vertex
+// format and index type. Meshes get a range of vertices and indices and are drawn through
+// vertexOffset and firstIndex, so consecutive draws from the same arena need no rebinding.
+// Ranges are handed out by the TLSF allocator in elements rather than bytes
+class CGeometryArena
+{
+public:
+	CGeometryArena(uint32_t vertexStride, VkIndexType indexType);
+
+	// Returns false without allocating anything when there is no room for the mesh
+	[[nodiscard]] bool TryAllocate(uint32_t vertexCount, uint32_t indexCount, SGeometryRange& outRange);
+	// Makes room for the mesh by replacing the buffers that are too small with bigger ones. Waits for the
+	// device to go idle and copies the old contents over on the queue, which must own the buffers. Every
+	// draw recorded before binds the old buffers, and every upload must have finished with them
+	void Grow(const VkDevice& device, CDeviceMemoryAllocator& allocator, const VkQueue& queue, const VkCommandPool& commandPool,
+			  uint32_t vertexCount, uint32_t indexCount);
+	// The range can be reused straight away, so the device must be done drawing it
+	void Free(SGeometryRange& range);
+	void Cleanup(CDeviceMemoryAllocator& allocator);
+
+	[[nodiscard]] const VkBuffer& GetVertexBuffer() const { return vertexBuffer.Buffer; }
+	[[nodiscard]] const VkBuffer& GetIndexBuffer() const { return indexBuffer.Buffer; }
+	[[nodiscard]] VkIndexType GetIndexType() const { return indexType; }
+	[[nodiscard]] VkDeviceSize GetVertexByteOffset(const SGeometryRange& range) const { return VkDeviceSize(range.VertexOffset) * vertexStride; }
+	[[nodiscard]] VkDeviceSize GetIndexByteOffset(const SGeometryRange& range) const { return VkDeviceSize(range.FirstIndex) * indexStride; }
+
+private:
+	// Replaces the buffer with a bigger one holding the same contents
+	void grow(const VkDevice& device, CDeviceMemoryAllocator& allocator, const VkQueue& queue, const VkCommandPool& commandPool,
+			  SBuffer& buffer, CTlsfBlockMetadata& ranges, uint32_t stride, VkBufferUsageFlags usageFlags,
+			  uint64_t initialCount, uint32_t count);
+
+	uint32_t vertexStride;
+	uint32_t indexStride;
+	VkIndexType indexType;
+	SBuffer vertexBuffer;
+	SBuffer indexBuffer;
+	// In vertices and in indices
+	std::unique_ptr<CTlsfBlockMetadata> pVertexRanges;
+	std::unique_ptr<CTlsfBlockMetadata> pIndexRanges;
+};
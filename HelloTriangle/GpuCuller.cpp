@@ -0,0 +1,310 @@
+#include "GpuCuller.h"
+#include "Common.h"
+#include "GameObject.h"
+#include "GeometryArena.h"
+#include "ShaderLoader.h"
+
+#include <map>
+
+namespace
+{
+	// local_size_x of Shaders/cullObjects.comp
+	constexpr uint32_t CULL_WORKGROUP_SIZE = 64;
+	constexpr uint32_t CULL_BINDING_COUNT = 5;
+}
+
+void CGpuCuller::Init(const VkDevice& device, const VkPhysicalDevice& physicalDevice)
+{
+	this->device = device;
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+	storageAlignment = properties.limits.minStorageBufferOffsetAlignment;
+
+	// The camera, the object transforms, the cull objects, the draw commands and the visible count
+	std::array<VkDescriptorSetLayoutBinding, CULL_BINDING_COUNT> bindings = {};
+	for (uint32_t binding = 0; binding != CULL_BINDING_COUNT; ++binding)
+	{
+		bindings[binding].binding = binding;
+		bindings[binding].descriptorCount = 1;
+		bindings[binding].descriptorType = binding == 0 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[binding].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	}
+
+	VkDescriptorSetLayoutCreateInfo layoutCreateInfo = {};
+	layoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutCreateInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+	layoutCreateInfo.pBindings = bindings.data();
+	if (vkCreateDescriptorSetLayout(device, &layoutCreateInfo, nullptr, &descriptorSetLayout) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create the culling descriptor set layout.");
+	}
+
+	// The object count
+	VkPushConstantRange pushConstantRange = {};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = sizeof(uint32_t);
+
+	VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {};
+	pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutCreateInfo.setLayoutCount = 1;
+	pipelineLayoutCreateInfo.pSetLayouts = &descriptorSetLayout;
+	pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+	pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+	if (vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayout) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create the culling pipeline layout.");
+	}
+
+	std::vector<char> vecShaderCode;
+	CShaderLoader::ReadShader("Shaders/cullObjects.spv", vecShaderCode);
+	VkShaderModuleCreateInfo shaderModuleCreateInfo = {};
+	shaderModuleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+	shaderModuleCreateInfo.codeSize = vecShaderCode.size();
+	shaderModuleCreateInfo.pCode = reinterpret_cast<const uint32_t*>(vecShaderCode.data());
+	VkShaderModule shaderModule;
+	if (vkCreateShaderModule(device, &shaderModuleCreateInfo, nullptr, &shaderModule) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create the shader module.");
+	}
+
+	VkComputePipelineCreateInfo pipelineCreateInfo = {};
+	pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineCreateInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	pipelineCreateInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	pipelineCreateInfo.stage.module = shaderModule;
+	pipelineCreateInfo.stage.pName = "main";
+	pipelineCreateInfo.layout = pipelineLayout;
+	const auto result = vkCreateComputePipelines(device, nullptr, 1, &pipelineCreateInfo, nullptr, &pipeline);
+	vkDestroyShaderModule(device, shaderModule, nullptr);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create the culling pipeline.");
+	}
+}
+
+void CGpuCuller::Cleanup()
+{
+	vkDestroyPipeline(device, pipeline, nullptr);
+	vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+	vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+	pipeline = nullptr;
+	pipelineLayout = nullptr;
+	descriptorSetLayout = nullptr;
+}
+
+void CGpuCuller::CreateFrameResources(CDeviceMemoryAllocator& allocator, const std::vector<SBuffer>& vecUniformBuffer,
+									  const VkDeviceSize objectTransformOffset, const size_t capacity)
+{
+	this->objectTransformOffset = objectTransformOffset;
+	commandOffset = storageAlignment;
+	cullObjectOffset = (commandOffset + sizeof(VkDrawIndexedIndirectCommand) * capacity + storageAlignment - 1) & ~(storageAlignment - 1);
+	const auto bufferSize = cullObjectOffset + sizeof(SGpuCullObject) * capacity;
+
+	const auto frameCount = static_cast<uint32_t>(vecUniformBuffer.size());
+	std::array<VkDescriptorPoolSize, 2> vecDescriptorPoolSize = {};
+	vecDescriptorPoolSize[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	vecDescriptorPoolSize[0].descriptorCount = frameCount;
+	vecDescriptorPoolSize[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	vecDescriptorPoolSize[1].descriptorCount = frameCount * (CULL_BINDING_COUNT - 1);
+
+	VkDescriptorPoolCreateInfo poolCreateInfo = {};
+	poolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolCreateInfo.maxSets = frameCount;
+	poolCreateInfo.poolSizeCount = static_cast<uint32_t>(vecDescriptorPoolSize.size());
+	poolCreateInfo.pPoolSizes = vecDescriptorPoolSize.data();
+	if (vkCreateDescriptorPool(device, &poolCreateInfo, nullptr, &descriptorPool) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create the culling descriptor pool.");
+	}
+
+	vecFrame.resize(frameCount);
+	for (uint32_t i = 0; i != frameCount; ++i)
+	{
+		auto& frame = vecFrame[i];
+		// Written by the CPU when recording and read back for validation, so it stays host visible
+		allocator.CreateBuffer(bufferSize,
+							   VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+							   VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+							   frame.Buffer);
+		frame.pUniformData = static_cast<const uint8_t*>(vecUniformBuffer[i].Allocation.pMappedData);
+		frame.ObjectCount = 0;
+
+		VkDescriptorSetAllocateInfo allocateInfo = {};
+		allocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocateInfo.descriptorPool = descriptorPool;
+		allocateInfo.descriptorSetCount = 1;
+		allocateInfo.pSetLayouts = &descriptorSetLayout;
+		if (vkAllocateDescriptorSets(device, &allocateInfo, &frame.DescriptorSet) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to allocate the culling descriptor sets.");
+		}
+
+		std::array<VkDescriptorBufferInfo, CULL_BINDING_COUNT> arrBufferInfo = {};
+		arrBufferInfo[0] = { vecUniformBuffer[i].Buffer, 0, sizeof(SCameraUniform) };
+		arrBufferInfo[1] = { vecUniformBuffer[i].Buffer, objectTransformOffset, sizeof(SObjectTransform) * capacity };
+		arrBufferInfo[2] = { frame.Buffer.Buffer, cullObjectOffset, sizeof(SGpuCullObject) * capacity };
+		arrBufferInfo[3] = { frame.Buffer.Buffer, commandOffset, sizeof(VkDrawIndexedIndirectCommand) * capacity };
+		arrBufferInfo[4] = { frame.Buffer.Buffer, 0, sizeof(uint32_t) };
+
+		std::array<VkWriteDescriptorSet, CULL_BINDING_COUNT> vecWriteDescriptorSet = {};
+		for (uint32_t binding = 0; binding != CULL_BINDING_COUNT; ++binding)
+		{
+			vecWriteDescriptorSet[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			vecWriteDescriptorSet[binding].descriptorCount = 1;
+			vecWriteDescriptorSet[binding].descriptorType = binding == 0 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			vecWriteDescriptorSet[binding].dstSet = frame.DescriptorSet;
+			vecWriteDescriptorSet[binding].dstBinding = binding;
+			vecWriteDescriptorSet[binding].dstArrayElement = 0;
+			vecWriteDescriptorSet[binding].pBufferInfo = &arrBufferInfo[binding];
+		}
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(vecWriteDescriptorSet.size()), vecWriteDescriptorSet.data(), 0, nullptr);
+	}
+}
+
+void CGpuCuller::DestroyFrameResources(CDeviceMemoryAllocator& allocator)
+{
+	for (auto& frame : vecFrame)
+	{
+		allocator.DestroyBuffer(frame.Buffer);
+	}
+	vecFrame.clear();
+	vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+	descriptorPool = nullptr;
+}
+
+void CGpuCuller::BuildDraws(const GameObjectVecPtrs& goPtrs, std::vector<SIndirectBatch>& vecBatch, std::vector<SGpuCullObject>& vecCullObject)
+{
+	vecBatch.clear();
+	vecCullObject.clear();
+
+	// The arena decides the pipeline too, packed meshes also need their own push constants
+	using BatchKey = std::pair<const CGeometryArena*, const SModelInformation*>;
+	std::map<BatchKey, size_t> mapBatchIndex;
+	std::vector<std::vector<SGpuCullObject>> vecVecMember;
+	for (size_t j = 0; j != goPtrs.size(); ++j)
+	{
+		const auto& gameObject = goPtrs[j];
+		if (!gameObject->IsDrawable())
+			continue;
+
+		const auto& modelInfo = *gameObject->mModelInformation;
+		const auto key = BatchKey(modelInfo.pGeometryArena, modelInfo.VertexFormat == EVertexFormat::Packed ? &modelInfo : nullptr);
+		const auto iter = mapBatchIndex.emplace(key, vecBatch.size()).first;
+		if (iter->second == vecBatch.size())
+		{
+			SIndirectBatch batch;
+			batch.pFirstGameObject = gameObject.get();
+			vecBatch.push_back(batch);
+			vecVecMember.emplace_back();
+		}
+
+		const auto& geometryRange = modelInfo.GeometryRange;
+		const auto& lod = modelInfo.VecLod[0];
+		SGpuCullObject cullObject;
+		cullObject.BoundingSphere = glm::vec4(modelInfo.BoundsCenter, modelInfo.BoundsRadius);
+		cullObject.ObjectIndex = static_cast<uint32_t>(j);
+		cullObject.FirstIndex = geometryRange.FirstIndex + lod.FirstIndex;
+		cullObject.IndexCount = lod.IndexCount;
+		cullObject.VertexOffset = static_cast<int32_t>(geometryRange.VertexOffset);
+		vecVecMember[iter->second].push_back(cullObject);
+	}
+
+	for (size_t i = 0; i != vecBatch.size(); ++i)
+	{
+		vecBatch[i].FirstCommand = static_cast<uint32_t>(vecCullObject.size());
+		vecBatch[i].CommandCount = static_cast<uint32_t>(vecVecMember[i].size());
+		vecCullObject.insert(vecCullObject.end(), vecVecMember[i].begin(), vecVecMember[i].end());
+	}
+}
+
+void CGpuCuller::WriteCullObjects(const uint32_t imageIndex, const std::vector<SGpuCullObject>& vecCullObject)
+{
+	auto& frame = vecFrame[imageIndex];
+	frame.ObjectCount = static_cast<uint32_t>(vecCullObject.size());
+	auto* pData = static_cast<uint8_t*>(frame.Buffer.Allocation.pMappedData);
+	std::memcpy(pData + cullObjectOffset, vecCullObject.data(), vecCullObject.size() * sizeof(SGpuCullObject));
+}
+
+void CGpuCuller::RecordCull(const VkCommandBuffer commandBuffer, const uint32_t imageIndex) const
+{
+	const auto& frame = vecFrame[imageIndex];
+	// The visible objects are counted with atomic adds, which start from zero on every frame
+	vkCmdFillBuffer(commandBuffer, frame.Buffer.Buffer, 0, sizeof(uint32_t), 0);
+	VkBufferMemoryBarrier clearBarrier = {};
+	clearBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	clearBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	clearBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+	clearBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	clearBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	clearBarrier.buffer = frame.Buffer.Buffer;
+	clearBarrier.offset = 0;
+	clearBarrier.size = sizeof(uint32_t);
+	vkCmdPipelineBarrier(commandBuffer,
+						 VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+						 0, 0,
+						 nullptr, 1,
+						 &clearBarrier, 0,
+						 nullptr);
+
+	if (frame.ObjectCount != 0)
+	{
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &frame.DescriptorSet, 0, nullptr);
+		vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(uint32_t), &frame.ObjectCount);
+		vkCmdDispatch(commandBuffer, (frame.ObjectCount + CULL_WORKGROUP_SIZE - 1) / CULL_WORKGROUP_SIZE, 1, 1);
+	}
+
+	// The draws read the commands, the host reads them back along with the count
+	VkBufferMemoryBarrier commandBarrier = {};
+	commandBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	commandBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	commandBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_HOST_READ_BIT;
+	commandBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	commandBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	commandBarrier.buffer = frame.Buffer.Buffer;
+	commandBarrier.offset = 0;
+	commandBarrier.size = cullObjectOffset;
+	vkCmdPipelineBarrier(commandBuffer,
+						 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_HOST_BIT,
+						 0, 0,
+						 nullptr, 1,
+						 &commandBarrier, 0,
+						 nullptr);
+}
+
+void CGpuCuller::RecordDraw(const VkCommandBuffer commandBuffer, const uint32_t imageIndex, const SIndirectBatch& batch) const
+{
+	vkCmdDrawIndexedIndirect(commandBuffer, vecFrame[imageIndex].Buffer.Buffer,
+							 commandOffset + batch.FirstCommand * sizeof(VkDrawIndexedIndirectCommand), batch.CommandCount,
+							 sizeof(VkDrawIndexedIndirectCommand));
+}
+
+uint32_t CGpuCuller::GetVisibleCount(const uint32_t imageIndex) const
+{
+	uint32_t visibleCount;
+	std::memcpy(&visibleCount, vecFrame[imageIndex].Buffer.Allocation.pMappedData, sizeof(visibleCount));
+	return visibleCount;
+}
+
+uint32_t CGpuCuller::Validate(const uint32_t imageIndex) const
+{
+	const auto& frame = vecFrame[imageIndex];
+	const auto* pData = static_cast<const uint8_t*>(frame.Buffer.Allocation.pMappedData);
+	const auto* pCommand = reinterpret_cast<const VkDrawIndexedIndirectCommand*>(pData + commandOffset);
+	const auto* pCullObject = reinterpret_cast<const SGpuCullObject*>(pData + cullObjectOffset);
+	const auto& camera = *reinterpret_cast<const SCameraUniform*>(frame.pUniformData);
+	const auto* pObjectTransform = reinterpret_cast<const SObjectTransform*>(frame.pUniformData + objectTransformOffset);
+
+	std::array<glm::vec4, 6> arrPlane;
+	std::copy(std::begin(camera.FrustumPlanes), std::end(camera.FrustumPlanes), arrPlane.begin());
+	uint32_t mismatchCount = 0;
+	for (uint32_t i = 0; i != frame.ObjectCount; ++i)
+	{
+		const auto& model = pObjectTransform[pCullObject[i].ObjectIndex].Model;
+		const auto expected = CObjectCuller::GetDrawCommand(arrPlane, model, pCullObject[i], i);
+		if (std::memcmp(&expected, &pCommand[i], sizeof(expected)) != 0)
+			++mismatchCount;
+	}
+	return mismatchCount;
+}
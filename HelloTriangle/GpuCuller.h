@@ -0,0 +1,78 @@
+#pragma once
+#include "CommonStructs.h"
+#include "DeviceMemoryAllocator.h"
+#include "ObjectCuller.h"
+#include "TypeAliases.h"
+
+#include <vulkan/vulkan_core.h>
+
+#include <vector>
+
+// Consecutive draw commands drawn with one vkCmdDrawIndexedIndirect. They share the pipeline and geometry arena of
+// pFirstGameObject and, for packed meshes, its dequantization push constants
+struct SIndirectBatch
+{
+	const IGameObject* pFirstGameObject = nullptr;
+	uint32_t FirstCommand = 0;
+	uint32_t CommandCount = 0;
+};
+
+// GPU driven drawing: a compute pass culls every object against the frustum and writes one indexed indirect draw
+// command for each, so the recorded draws don't depend on what is visible and the CPU never loops over the
+// objects to draw them. Objects are drawn whole at their full detail level. Owns the compute pipeline and, per
+// swap chain image, the cull objects, the draw commands and the count of visible objects. Not thread safe
+class CGpuCuller
+{
+public:
+	// The shader comes from Shaders/cullObjects.spv
+	void Init(const VkDevice& device, const VkPhysicalDevice& physicalDevice);
+	void Cleanup();
+
+	// Each uniform buffer starts with the camera block, the object transforms are at objectTransformOffset.
+	// Makes room for capacity objects
+	void CreateFrameResources(CDeviceMemoryAllocator& allocator, const std::vector<SBuffer>& vecUniformBuffer,
+							  VkDeviceSize objectTransformOffset, size_t capacity);
+	void DestroyFrameResources(CDeviceMemoryAllocator& allocator);
+
+	// One cull object per drawable object, sorted into batches. Command i is drawn as instance i of object
+	// vecCullObject[i].ObjectIndex
+	static void BuildDraws(const GameObjectVecPtrs& goPtrs, std::vector<SIndirectBatch>& vecBatch, std::vector<SGpuCullObject>& vecCullObject);
+
+	// Copies the cull objects into the image's buffer, which only needs doing when they changed since the image
+	// last got them. Only call while the image's command buffer isn't in flight
+	void WriteCullObjects(uint32_t imageIndex, const std::vector<SGpuCullObject>& vecCullObject);
+	// Records the dispatch over the cull objects last written, followed by the barrier the indirect draws need.
+	// Only call outside a render pass
+	void RecordCull(VkCommandBuffer commandBuffer, uint32_t imageIndex) const;
+	void RecordDraw(VkCommandBuffer commandBuffer, uint32_t imageIndex, const SIndirectBatch& batch) const;
+
+	// The image's last cull must have executed
+	[[nodiscard]] uint32_t GetObjectCount(uint32_t imageIndex) const { return vecFrame[imageIndex].ObjectCount; }
+	[[nodiscard]] uint32_t GetVisibleCount(uint32_t imageIndex) const;
+	// Checks the commands of the image's last cull against CObjectCuller fed with the camera and transforms the
+	// shader read. Returns how many differ, which may happen through rounding for objects touching a plane
+	[[nodiscard]] uint32_t Validate(uint32_t imageIndex) const;
+
+private:
+	struct SFrame
+	{
+		// The visible count, then the draw commands, then the cull objects
+		SBuffer Buffer;
+		// Not owned
+		const uint8_t* pUniformData = nullptr;
+		// Freed with the descriptor pool
+		VkDescriptorSet DescriptorSet = nullptr;
+		uint32_t ObjectCount = 0;
+	};
+
+	VkDevice device = nullptr;
+	VkDeviceSize storageAlignment = 1;
+	VkDescriptorSetLayout descriptorSetLayout = nullptr;
+	VkPipelineLayout pipelineLayout = nullptr;
+	VkPipeline pipeline = nullptr;
+	VkDescriptorPool descriptorPool = nullptr;
+	VkDeviceSize objectTransformOffset = 0;
+	VkDeviceSize commandOffset = 0;
+	VkDeviceSize cullObjectOffset = 0;
+	std::vector<SFrame> vecFrame;
+};
@@ -0,0 +1,48 @@
+#include "InstanceGroups.h"
+#include "GameObject.h"
+
+#include <unordered_map>
+
+void CInstanceGroups::Build(const GameObjectVecPtrs& goPtrs, std::vector<SInstanceGroup>& vecGroup, std::vector<uint32_t>& vecObjectIndex)
+{
+	vecGroup.clear();
+	vecObjectIndex.clear();
+
+	// Members of each group in vecGroup's order, flattened once every object has been seen
+	std::vector<std::vector<uint32_t>> vecVecMember;
+	// Indices into vecGroup of the groups of each mesh, one per distinct set of draw ranges
+	std::unordered_map<const SModelInformation*, std::vector<size_t>> mapMeshGroups;
+	for (size_t j = 0; j != goPtrs.size(); ++j)
+	{
+		const auto& gameObject = goPtrs[j];
+		if (!gameObject->IsDrawable() || !gameObject->mIsVisible)
+			continue;
+
+		auto& vecMeshGroup = mapMeshGroups[gameObject->mModelInformation.get()];
+		size_t groupIndex = vecGroup.size();
+		for (const auto index : vecMeshGroup)
+		{
+			if (vecGroup[index].pFirstGameObject->GetDrawRanges() == gameObject->GetDrawRanges())
+			{
+				groupIndex = index;
+				break;
+			}
+		}
+		if (groupIndex == vecGroup.size())
+		{
+			SInstanceGroup group;
+			group.pFirstGameObject = gameObject.get();
+			vecGroup.push_back(group);
+			vecVecMember.emplace_back();
+			vecMeshGroup.push_back(groupIndex);
+		}
+		vecVecMember[groupIndex].push_back(static_cast<uint32_t>(j));
+	}
+
+	for (size_t i = 0; i != vecGroup.size(); ++i)
+	{
+		vecGroup[i].FirstInstance = static_cast<uint32_t>(vecObjectIndex.size());
+		vecGroup[i].InstanceCount = static_cast<uint32_t>(vecVecMember[i].size());
+		vecObjectIndex.insert(vecObjectIndex.end(), vecVecMember[i].begin(), vecVecMember[i].end());
+	}
+}
@@ -0,0 +1,22 @@
+#pragma once
+#include "TypeAliases.h"
+
+#include <cstdint>
+#include <vector>
+
+// Game objects drawn together with one instanced draw per index range. Every instance shares the mesh and
+// the visible index ranges of pFirstGameObject, instance i draws object vecObjectIndex[FirstInstance + i]
+struct SInstanceGroup
+{
+	const IGameObject* pFirstGameObject = nullptr;
+	uint32_t FirstInstance = 0;
+	uint32_t InstanceCount = 0;
+};
+
+class CInstanceGroups
+{
+public:
+	// Groups the drawable and visible objects sharing a mesh whose level of detail and culled meshlets also match, in the
+	// order each group first appears. vecObjectIndex gets the index into goPtrs of every grouped object
+	static void Build(const GameObjectVecPtrs& goPtrs, std::vector<SInstanceGroup>& vecGroup, std::vector<uint32_t>& vecObjectIndex);
+};
@@ -1,18 +1,39 @@
 #include "TypeAliases.h"
+#include "BinaryScene.h"
 #include "DebugHelpers.h"
 #include "SetupHelpers.h"
 #include "BufferManager.h"
+#include "DeviceMemoryAllocator.h"
 #include "ShaderLoader.h"
 #include "ModelLoader.h"
 #include "GameObject.h"
+#include "GeometryArena.h"
+#include "GpuCuller.h"
+#include "InstanceGroups.h"
+#include "MeshRegistry.h"
+#include "MeshletCuller.h"
+#include "ParallelRecorder.h"
+#include "FileWatcher.h"
+#include "FrustumCuller.h"
+#include "SceneDiff.h"
+#include "SceneParser.h"
+#include "StagingRing.h"
+#include "TransformSystem.h"
+#include "UploadBatch.h"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
+#include <algorithm>
 #include <map>
 #include <chrono>
+#include <cstring>
 
 const int MAX_FRAMES_IN_FLIGHT = 2;
+// The chalet texture is 4096x4096 RGBA, 64 MiB on its own. The rest covers the chalet mesh, about 20 MiB with its
+// levels of detail, with room to spare, so that uploading both at once never waits
+const VkDeviceSize STAGING_RING_SIZE = VkDeviceSize(96) << 20;
+const char* SCENE_FILENAME = "Models/Scene.json";
 
 #ifdef _MSC_VER
 #define _CRTDBG_MAP_ALLOC
@@ -24,7 +45,10 @@ const int MAX_FRAMES_IN_FLIGHT = 2;
 class HelloTriangleApp
 {
 public:
-	HelloTriangleApp() = default;
+	// With isWatchingScene set, edits to the scene file are applied while running. With isGpuCulling set,
+	// objects are culled by a compute pass and drawn with indirect draws instead of being culled on the CPU
+	explicit HelloTriangleApp(const bool isWatchingScene = false, const bool isGpuCulling = false) :
+		isWatchingScene(isWatchingScene), isGpuCulling(isGpuCulling) {}
 public:
 	void Run()
 	{
@@ -55,12 +79,89 @@ private:
 
 	void createScene()
 	{
-		CModelLoader::GetSceneHierarchy("Models/Scene.json", vecGameObject);
+		CModelLoader::GetSceneHierarchy(SCENE_FILENAME, vecGameObject);
+		syncTransforms();
+		acquireMissingMeshes();
+		if (isWatchingScene)
+		{
+			pSceneWatcher = std::make_unique<CFileWatcher>(SCENE_FILENAME);
+		}
+	}
+
+	// Applies an edit of the scene file without touching anything it didn't change. Moved objects only get
+	// a new transform, which updateUniformBuffer rewrites on its next frame. New files are loaded in the
+	// background like at startup, and meshes no object uses any more are destroyed. Meshes that failed to load
+	// are tried again on every reload
+	void reloadScene()
+	{
+		GameObjectVecPtrs vecEditedGameObject;
+		try
+		{
+			CModelLoader::GetSceneHierarchy(SCENE_FILENAME, vecEditedGameObject);
+		}
+		catch (const std::exception& e)
+		{
+			// Usually a save caught halfway, the next one triggers another reload
+			std::cout << "Keeping the current scene: " << e.what() << std::endl;
+			return;
+		}
+
+		const auto diff = CSceneDiff::Apply(vecGameObject, std::move(vecEditedGameObject));
+		std::cout << "Scene reloaded: " << diff.MovedCount << " moved, " << diff.AddedCount << " added, "
+			<< diff.RemovedCount << " removed, " << diff.UnchangedCount << " unchanged" << std::endl;
+		// Only the slots whose transform differs from the one they held are composed again
+		syncTransforms();
+		acquireMissingMeshes();
+		if (!diff.HasStructureChanged)
+			return;
+
+		const auto isOverCapacity = vecGameObject.size() > uniformBufferCapacity;
+		if (diff.RemovedCount != 0 || isOverCapacity)
+		{
+			// Frames in flight may still draw the removed meshes or read the uniform buffers
+			vkDeviceWaitIdle(device);
+		}
+		// After acquiring, so a mesh that a removed object used and an added one uses again isn't loaded twice
+		if (diff.RemovedCount != 0)
+		{
+			meshRegistry.ReleaseUnused();
+		}
+		if (isOverCapacity)
+		{
+			destroyUniformBuffers();
+			vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+			createUniformBuffers();
+			createDescriptorPool();
+			createDescriptorSets();
+		}
+		// Every image's transform slots are in the old object order
+		for (auto& vecWrittenVersion : vecWrittenModelVersion)
+		{
+			std::fill(vecWrittenVersion.begin(), vecWrittenVersion.end(), 0);
+		}
+		// The culler's boxes and the GPU culling draws are in the old object order too
+		std::fill(vecBoundsModelVersion.begin(), vecBoundsModelVersion.end(), 0);
+		isGpuDrawStale = true;
+	}
+
+	// For objects that have no mesh yet and those whose mesh failed to load. Parsed on the registry's workers,
+	// the uploads are started from mainLoop
+	void acquireMissingMeshes()
+	{
 		for (auto& gameObject : vecGameObject)
 		{
-			CModelLoader::LoadModel(gameObject->mObjectInformation, gameObject->mModelInformation);
-			CBufferManager::CreateVertexBuffer(device, physicalDevice, graphicsQueue, vecCommandPools[1], gameObject);
-			CBufferManager::CreateIndexBuffer(device, physicalDevice, graphicsQueue, vecCommandPools[1], gameObject);
+			if (!gameObject->mModelInformation || gameObject->mModelInformation->IsFailed)
+				gameObject->mModelInformation = meshRegistry.AcquireAsync(gameObject->mObjectInformation);
+		}
+	}
+
+	// Slot j of the transform system follows vecGameObject[j]
+	void syncTransforms()
+	{
+		transformSystem.Resize(vecGameObject.size());
+		for (size_t j = 0; j != vecGameObject.size(); ++j)
+		{
+			transformSystem.SetTransform(j, vecGameObject[j]->mTransform);
 		}
 	}
 
@@ -75,16 +176,27 @@ private:
 		createSurface();
 		pickPhysicalDevice();
 		createLogicalDevice();
+		memoryAllocator.Init(device, physicalDevice);
+		stagingRing.Init(device, memoryAllocator, STAGING_RING_SIZE);
 		createSwapChain();
 		createSwapChainImageViews();
 		createRenderPass();
 		createDescriptorSetLayout();
 		createGraphicsPipeline();
+		if (isGpuCulling)
+		{
+			gpuCuller.Init(device, physicalDevice);
+		}
 		createCommandPool();
+		parallelRecorder.Init(device, uploadQueues.GraphicsFamily, threadPool);
 		createScene();
 		createDepthResources();
 		createFramebuffers();
-		createTextureImage("Models/Chalet/chalet.jpg");
+		// Everything uploaded during startup goes in one submission that is waited for once
+		CUploadBatch startupBatch;
+		startupBatch.Begin(device, uploadQueues.GraphicsQueue, uploadQueues.GraphicsCommandPool);
+		createTextureImage("Models/Chalet/chalet.jpg", startupBatch);
+		startupBatch.SubmitAndWait();
 		createTextureImageView();
 		createTextureSampler();
 		createUniformBuffers();
@@ -99,6 +211,12 @@ private:
 		while (!glfwWindowShouldClose(pWindow))
 		{
 			glfwPollEvents();
+			if (pSceneWatcher && pSceneWatcher->HasChanged())
+			{
+				reloadScene();
+			}
+			// The draws are recorded every frame, so the new meshes are drawn from the next one on
+			meshRegistry.ProcessPendingLoads(device, memoryAllocator, stagingRing, uploadQueues);
 			drawFrame();
 		}
 		vkDeviceWaitIdle(device);
@@ -111,21 +229,16 @@ private:
 		vkDestroySampler(device, textureSampler, nullptr);
 		vkDestroyImageView(device, textureImageView, nullptr);
 
-		vkDestroyImage(device, textureImage, nullptr);
-		vkFreeMemory(device, textureImageMemory, nullptr);
+		memoryAllocator.DestroyImage(textureImage, textureImageAllocation);
 
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
-
-
-		for (auto& gameObject : vecGameObject)
+		if (isGpuCulling)
 		{
-			gameObject->Cleanup(device);
+			gpuCuller.Cleanup();
 		}
-		//vkDestroyBuffer(device, indexBuffer, nullptr);
-		//vkFreeMemory(device, indexBufferMemory, nullptr);
 
-		//vkDestroyBuffer(device, vertexBuffer, nullptr);
-		//vkFreeMemory(device, vertexBufferMemory, nullptr);
+		vecGameObject.clear();
+		meshRegistry.Cleanup(memoryAllocator);
 
 		auto index = 0;
 		for (auto& imageSemaphore : vecSemaphoreImageAvailable)
@@ -135,11 +248,18 @@ private:
 			vkDestroyFence(device, vecInFlightFences[index], nullptr);
 			index++;
 		}
+		parallelRecorder.Cleanup();
 		for (auto& commandPool : vecCommandPools)
 		{
 			vkDestroyCommandPool(device, commandPool, nullptr);
 		}
 
+#ifdef PRINT_STAGING_STATISTICS
+		stagingRing.PrintStatistics();
+		std::cout << meshRegistry.GetDeferredUploadCount() << " mesh uploads deferred until the staging ring had room" << std::endl;
+#endif
+		stagingRing.Cleanup(memoryAllocator);
+		memoryAllocator.Cleanup();
 		vkDestroyDevice(device, nullptr);
 
 		if (enableValidationLayers)
@@ -281,8 +401,19 @@ private:
 			vecQueueCreateInfos.push_back(queueCreateInfo);
 		}
 
+		if (isGpuCulling && !CSetupHelpers::CheckGpuCullingSupport(physicalDevice))
+		{
+			std::cout << "Device lacks multiDrawIndirect or drawIndirectFirstInstance, culling on the CPU instead" << std::endl;
+			isGpuCulling = false;
+		}
+
 		VkPhysicalDeviceFeatures deviceFeatures = {};
 		deviceFeatures.samplerAnisotropy = VK_TRUE;
+		if (isGpuCulling)
+		{
+			deviceFeatures.multiDrawIndirect = VK_TRUE;
+			deviceFeatures.drawIndirectFirstInstance = VK_TRUE;
+		}
 
 		VkDeviceCreateInfo deviceCreateInfo = {};
 		deviceCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
@@ -339,13 +470,11 @@ private:
 		auto indices =
 			CSetupHelpers::FindQueueFamilies(physicalDevice, surface);
 
-		std::set<uint32_t> setQueueFamilyIndices = {
+		// Only rendering and presentation touch the images, the transfer queue never does
+		uint32_t queueFamilyIndices[] = {
 			indices.GraphicsFamily.value(),
-			indices.PresentFamily.value(),
-			indices.TransferFamily.value()
+			indices.PresentFamily.value()
 		};
-		std::vector<uint32_t> vecQueueFamilyIndices(setQueueFamilyIndices.begin(),
-													setQueueFamilyIndices.end());
 
 
 		VkSwapchainCreateInfoKHR createInfo = {};
@@ -357,21 +486,18 @@ private:
 		createInfo.imageExtent = extent;
 		createInfo.imageArrayLayers = 1;
 		createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
-		//if (indices.GraphicsFamily != indices.PresentFamily)
-		//{
-		//	createInfo.imageSharingMode = VK_SHARING_MODE_CONCURRENT;
-		//	createInfo.queueFamilyIndexCount = 2;
-		//	createInfo.pQueueFamilyIndices = queueFamilyIndices;
-		//}
-		//else
-		//{
-		//	createInfo.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
-		//	createInfo.queueFamilyIndexCount = 0;
-		//	createInfo.pQueueFamilyIndices = nullptr;
-		//}
-		createInfo.imageSharingMode = VK_SHARING_MODE_CONCURRENT;
-		createInfo.queueFamilyIndexCount = static_cast<uint32_t>(setQueueFamilyIndices.size());
-		createInfo.pQueueFamilyIndices = vecQueueFamilyIndices.data();
+		if (indices.GraphicsFamily != indices.PresentFamily)
+		{
+			createInfo.imageSharingMode = VK_SHARING_MODE_CONCURRENT;
+			createInfo.queueFamilyIndexCount = 2;
+			createInfo.pQueueFamilyIndices = queueFamilyIndices;
+		}
+		else
+		{
+			createInfo.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
+			createInfo.queueFamilyIndexCount = 0;
+			createInfo.pQueueFamilyIndices = nullptr;
+		}
 		createInfo.preTransform = details.SurfaceCapabilities.currentTransform;
 		createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
 		createInfo.presentMode = presentMode;
@@ -597,8 +723,12 @@ private:
 		pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
 		pipelineLayoutCreateInfo.setLayoutCount = 0;
 		pipelineLayoutCreateInfo.pSetLayouts = nullptr;
-		pipelineLayoutCreateInfo.pushConstantRangeCount = 0;
-		pipelineLayoutCreateInfo.pPushConstantRanges = nullptr;
+		VkPushConstantRange pushConstantRange = {};
+		pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+		pushConstantRange.offset = 0;
+		pushConstantRange.size = sizeof(SMeshPushConstants);
+		pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+		pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
 		pipelineLayoutCreateInfo.setLayoutCount = 1;
 		pipelineLayoutCreateInfo.pSetLayouts = &descriptorSetLayout;
 
@@ -640,6 +770,31 @@ private:
 			throw std::runtime_error("Failed to create the graphics pipeline.");
 		}
 
+		// Same pipeline for SPackedVertex meshes, the specialization constant enables dequantization in the vertex shader
+		const auto packedBindingDescription = SPackedVertex::GetInputBindingDescription();
+		const auto packedAttributeDescriptions = SPackedVertex::GetInputAttributeDescriptions();
+		vertexInputStateCreateInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(packedAttributeDescriptions.size());
+		vertexInputStateCreateInfo.pVertexBindingDescriptions = &packedBindingDescription;
+		vertexInputStateCreateInfo.pVertexAttributeDescriptions = packedAttributeDescriptions.data();
+
+		const VkBool32 isPackedVertex = VK_TRUE;
+		VkSpecializationMapEntry specializationMapEntry = {};
+		specializationMapEntry.constantID = 0;
+		specializationMapEntry.offset = 0;
+		specializationMapEntry.size = sizeof(VkBool32);
+
+		VkSpecializationInfo specializationInfo = {};
+		specializationInfo.mapEntryCount = 1;
+		specializationInfo.pMapEntries = &specializationMapEntry;
+		specializationInfo.dataSize = sizeof(VkBool32);
+		specializationInfo.pData = &isPackedVertex;
+		shaderStages[0].pSpecializationInfo = &specializationInfo;
+
+		if (vkCreateGraphicsPipelines(device, nullptr, 1, &pipelineCreateInfo, nullptr, &packedGraphicsPipeline) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create the packed vertex graphics pipeline.");
+		}
+
 		vkDestroyShaderModule(device, vertShaderModule, nullptr);
 		vkDestroyShaderModule(device, fragShaderModule, nullptr);
 	}
@@ -680,6 +835,8 @@ private:
 		VkCommandPoolCreateInfo commandPoolCreateInfo = {};
 		commandPoolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
 		commandPoolCreateInfo.queueFamilyIndex = queueFamilyIndices.GraphicsFamily.value();
+		// The draw command buffers are re-recorded every frame, each when its image comes up
+		commandPoolCreateInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
 
 		// First Command Pool is for the Graphics Queue
 		if (vkCreateCommandPool(device, &commandPoolCreateInfo, nullptr, &vecCommandPools[0]) != VK_SUCCESS)
@@ -694,9 +851,16 @@ private:
 		{
 			throw std::runtime_error("Failed to create the command pool");
 		}
+
+		uploadQueues.GraphicsQueue = graphicsQueue;
+		uploadQueues.GraphicsCommandPool = vecCommandPools[0];
+		uploadQueues.GraphicsFamily = queueFamilyIndices.GraphicsFamily.value();
+		uploadQueues.TransferQueue = transferQueue;
+		uploadQueues.TransferCommandPool = vecCommandPools[1];
+		uploadQueues.TransferFamily = queueFamilyIndices.TransferFamily.value();
 	}
 
-	void createTextureImage(const std::string& textureDir)
+	void createTextureImage(const std::string& textureDir, CUploadBatch& uploadBatch)
 	{
 		int width, height, channels;
 		const auto pixels = stbi_load(textureDir.c_str(), &width, &height, &channels, STBI_rgb_alpha);
@@ -708,16 +872,8 @@ private:
 			throw std::runtime_error("Failed to load the texture.");
 		}
 
-		VkBuffer stagingBuffer;
-		VkDeviceMemory stagingBufferMemory;
-		createBuffer(texSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-					 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer,
-					 stagingBufferMemory);
-
-		void* data;
-		vkMapMemory(device, stagingBufferMemory, 0, texSize, 0, &data);
-		std::memcpy(data, pixels, texSize);
-		vkUnmapMemory(device, stagingBufferMemory);
+		const auto stagingRegion = uploadBatch.AllocateStaging(stagingRing, texSize);
+		std::memcpy(stagingRegion.pData, pixels, texSize);
 
 		stbi_image_free(pixels);
 
@@ -727,22 +883,12 @@ private:
 					VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
 					VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
 					textureImage,
-					textureImageMemory);
-
-		transitionImageLayout(textureImage,
-							  VK_FORMAT_R8G8B8A8_UNORM,
-							  VK_IMAGE_LAYOUT_UNDEFINED,
-							  VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+					textureImageAllocation);
 
-		copyBufferToImage(stagingBuffer, textureImage, width, height);
-
-		transitionImageLayout(textureImage,
-							  VK_FORMAT_R8G8B8A8_UNORM,
-							  VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-							  VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-
-		vkDestroyBuffer(device, stagingBuffer, nullptr);
-		vkFreeMemory(device, stagingBufferMemory, nullptr);
+		// For operations that end up in VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT USE GRAPHICS QUEUE
+		uploadBatch.TransitionImageLayout(textureImage, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+		uploadBatch.CopyBufferToImage(stagingRegion.Buffer, stagingRegion.Offset, textureImage, width, height);
+		uploadBatch.TransitionImageLayout(textureImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 	}
 
 	void createTextureImageView()
@@ -776,64 +922,6 @@ private:
 		}
 	}
 
-	void createVertexBuffer(GameObjectUPtr& gameObject)
-	{
-		const auto bufferSize = gameObject->GetVertexBufferSize();
-
-		VkBuffer stagingBuffer;
-		VkDeviceMemory stagingBufferMemory;
-		createBuffer(bufferSize,
-					 VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-					 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-					 stagingBuffer,
-					 stagingBufferMemory);
-
-		void* data;
-		vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
-		std::memcpy(data, gameObject->GetVertexData(), bufferSize);
-		vkUnmapMemory(device, stagingBufferMemory);
-
-		createBuffer(bufferSize,
-					 VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-					 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-					 gameObject->GetVertexBuffer(),
-					 gameObject->GetVertexBufferMemory());
-
-		copyBuffer(stagingBuffer, gameObject->GetVertexBuffer(), bufferSize);
-
-		// Cleanup staging buffer and memory
-		vkDestroyBuffer(device, stagingBuffer, nullptr);
-		vkFreeMemory(device, stagingBufferMemory, nullptr);
-	}
-
-	void createIndexBuffer(GameObjectUPtr& gameObject)
-	{
-		const auto bufferSize = gameObject->GetIndexBufferSize();
-		VkBuffer stagingBuffer;
-		VkDeviceMemory stagingBufferMemory;
-		createBuffer(bufferSize,
-					 VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-					 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-					 stagingBuffer,
-					 stagingBufferMemory);
-
-		void* data;
-		vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
-		std::memcpy(data, gameObject->GetIndexData(), bufferSize);
-		vkUnmapMemory(device, stagingBufferMemory);
-
-		createBuffer(bufferSize,
-					 VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
-					 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-					 gameObject->GetIndexBuffer(),
-					 gameObject->GetIndexBufferMemory());
-
-		copyBuffer(stagingBuffer, gameObject->GetIndexBuffer(), bufferSize);
-
-		vkDestroyBuffer(device, stagingBuffer, nullptr);
-		vkFreeMemory(device, stagingBufferMemory, nullptr);
-	}
-
 	void createDepthResources()
 	{
 		const auto depthFormat = CSetupHelpers::FindDepthFormat(physicalDevice);
@@ -844,23 +932,9 @@ private:
 					VK_IMAGE_TILING_OPTIMAL,
 					VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
 					VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, depthImage,
-					depthImageMemory);
+					depthImageAllocation);
 
 		depthImageView = createImageView(depthImage, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT);
-
-		//transitionImageLayout(depthImage, depthFormat, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
-	}
-
-	void createBuffersForGameObjects()
-	{
-		for (auto& gameObject : vecGameObject)
-		{
-			createVertexBuffer(gameObject);
-		}
-		for (auto& gameObject : vecGameObject)
-		{
-			createIndexBuffer(gameObject);
-		}
 	}
 
 	void createCommandBuffers()
@@ -877,66 +951,155 @@ private:
 		{
 			throw std::runtime_error("Failed to create the command buffers.");
 		}
+		parallelRecorder.CreateFrameResources(vecCommandBuffers.size());
+	}
+
+	// Binds the pipeline matching the mesh's vertex format and the geometry arena holding it, unless already bound
+	void bindMesh(const VkCommandBuffer commandBuffer, const IGameObject& gameObject, VkPipeline& boundPipeline,
+				  const CGeometryArena*& pBoundGeometryArena) const
+	{
+		const auto& modelInfo = *gameObject.mModelInformation;
+		const auto isPacked = modelInfo.VertexFormat == EVertexFormat::Packed;
+		const auto pipeline = isPacked ? packedGraphicsPipeline : graphicsPipeline;
+		if (pipeline != boundPipeline)
+		{
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+			boundPipeline = pipeline;
+		}
+		if (isPacked)
+		{
+			vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0,
+							   sizeof(SMeshPushConstants), &modelInfo.PackedDequantization);
+		}
+
+		// Meshes sharing an arena are drawn back to back without rebinding
+		const auto& geometryArena = gameObject.GetGeometryArena();
+		if (&geometryArena != pBoundGeometryArena)
+		{
+			VkDeviceSize vertexOffsets[] = { 0 };
+			vkCmdBindVertexBuffers(commandBuffer, 0, 1, &geometryArena.GetVertexBuffer(), vertexOffsets);
+			vkCmdBindIndexBuffer(commandBuffer, geometryArena.GetIndexBuffer(), 0, geometryArena.GetIndexType());
+			pBoundGeometryArena = &geometryArena;
+		}
+	}
+
+	// The draws don't depend on what is visible, so they are only built again when objects were added, removed or
+	// reordered or meshes became resident, and only written to the image's buffers when it holds an older build.
+	// Frames that change neither do no work per object. Only call while the image's buffers aren't in flight
+	void updateGpuDraws(const uint32_t imageIndex)
+	{
+		if (isGpuDrawStale || gpuDrawResidencyVersion != meshRegistry.GetResidencyVersion())
+		{
+			CGpuCuller::BuildDraws(vecGameObject, vecIndirectBatch, vecCullObject);
+			gpuDrawResidencyVersion = meshRegistry.GetResidencyVersion();
+			isGpuDrawStale = false;
+			++gpuDrawVersion;
+		}
+		if (vecWrittenGpuDrawVersion[imageIndex] == gpuDrawVersion)
+			return;
+
+		gpuCuller.WriteCullObjects(imageIndex, vecCullObject);
+		// Draw command i draws instance i
+		auto* pInstanceData = static_cast<uint8_t*>(vecUniformBuffer[imageIndex].Allocation.pMappedData) + instanceIndexOffset;
+		auto* pObjectIndex = reinterpret_cast<uint32_t*>(pInstanceData);
+		for (size_t i = 0; i != vecCullObject.size(); ++i)
+		{
+			pObjectIndex[i] = vecCullObject[i].ObjectIndex;
+		}
+		vecWrittenGpuDrawVersion[imageIndex] = gpuDrawVersion;
+	}
 
+	// Only call once the command buffer is no longer in flight. The draws are recorded into secondary command
+	// buffers across the recorder's threads, the primary only culls on the GPU and runs the render pass
+	void recordCommandBuffer(const uint32_t imageIndex)
+	{
 		std::array<VkClearValue, 2> arrClearValue = {};
 		arrClearValue[0].color = { 0.0f, 0.0f, 0.0f, 1.0f };
 		arrClearValue[1].depthStencil = { 1.0f, 0 };
 
-		for (size_t i = 0; i != vecCommandBuffers.size(); ++i)
+		VkCommandBufferBeginInfo commandBufferBeginInfo = {};
+		commandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		commandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+		if (vkBeginCommandBuffer(vecCommandBuffers[imageIndex], &commandBufferBeginInfo) != VK_SUCCESS)
 		{
-			VkCommandBufferBeginInfo commandBufferBeginInfo = {};
-			commandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+			throw std::runtime_error("Failed to begin recording the command buffer.");
+		}
 
-			if (vkBeginCommandBuffer(vecCommandBuffers[i], &commandBufferBeginInfo) != VK_SUCCESS)
-			{
-				throw std::runtime_error("Failed to begin recording the command buffer.");
-			}
+		// Every instance reads its transform through its object index. In GPU culling mode the compute pass runs
+		// first and draw command i draws instance i of its cull object's object, otherwise every group of objects
+		// sharing a mesh and visible ranges is drawn as instances of it
+		std::vector<SInstanceGroup> vecInstanceGroup;
+		if (isGpuCulling)
+		{
+			updateGpuDraws(imageIndex);
+			gpuCuller.RecordCull(vecCommandBuffers[imageIndex], imageIndex);
+		}
+		else
+		{
+			std::vector<uint32_t> vecObjectIndex;
+			CInstanceGroups::Build(vecGameObject, vecInstanceGroup, vecObjectIndex);
+			// The buffer isn't in flight while its command buffer is recorded
+			auto* pInstanceData = static_cast<uint8_t*>(vecUniformBuffer[imageIndex].Allocation.pMappedData) + instanceIndexOffset;
+			std::memcpy(pInstanceData, vecObjectIndex.data(), vecObjectIndex.size() * sizeof(uint32_t));
+		}
 
-			VkRenderPassBeginInfo renderPassBeginInfo = {};
-			renderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-			renderPassBeginInfo.renderPass = renderPass;
-			renderPassBeginInfo.framebuffer = vecSwapChainFramebuffers[i];
-			renderPassBeginInfo.renderArea.offset = { 0, 0 };
-			renderPassBeginInfo.renderArea.extent = swapChainExtent;
-			renderPassBeginInfo.clearValueCount = static_cast<uint32_t>(arrClearValue.size());
-			renderPassBeginInfo.pClearValues = arrClearValue.data();
-			// Begin Render Pass
-			vkCmdBeginRenderPass(vecCommandBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-			// Bind the Graphics Pipeline
-			vkCmdBindPipeline(vecCommandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
-			// Draw
-			for (size_t j = 0; j != vecGameObject.size(); ++j)
+		VkRenderPassBeginInfo renderPassBeginInfo = {};
+		renderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+		renderPassBeginInfo.renderPass = renderPass;
+		renderPassBeginInfo.framebuffer = vecSwapChainFramebuffers[imageIndex];
+		renderPassBeginInfo.renderArea.offset = { 0, 0 };
+		renderPassBeginInfo.renderArea.extent = swapChainExtent;
+		renderPassBeginInfo.clearValueCount = static_cast<uint32_t>(arrClearValue.size());
+		renderPassBeginInfo.pClearValues = arrClearValue.data();
+		// Begin Render Pass
+		vkCmdBeginRenderPass(vecCommandBuffers[imageIndex], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+
+		VkCommandBufferInheritanceInfo inheritanceInfo = {};
+		inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+		inheritanceInfo.renderPass = renderPass;
+		inheritanceInfo.subpass = 0;
+		inheritanceInfo.framebuffer = vecSwapChainFramebuffers[imageIndex];
+		// Each range binds its own descriptor set, pipelines and arenas, draws only read what is shared
+		const auto drawCount = isGpuCulling ? vecIndirectBatch.size() : vecInstanceGroup.size();
+		const auto& vecSecondary = parallelRecorder.Record(imageIndex, inheritanceInfo, drawCount,
+			[this, imageIndex, &vecInstanceGroup](const VkCommandBuffer commandBuffer, const size_t begin, const size_t end)
+		{
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &vecDescriptorSet[imageIndex], 0, nullptr);
+			VkPipeline boundPipeline = nullptr;
+			const CGeometryArena* pBoundGeometryArena = nullptr;
+			if (isGpuCulling)
 			{
-				VkDeviceSize vertexOffsets[] = { 0 };
-				vkCmdBindVertexBuffers(vecCommandBuffers[i], 0, 1, &vecGameObject[j]->GetVertexBuffer(), vertexOffsets);
-				vkCmdBindIndexBuffer(vecCommandBuffers[i], vecGameObject[j]->GetIndexBuffer(), 0, VK_INDEX_TYPE_UINT32);
-
-				uint32_t uboOffsets[] = { j * sizeof(SUniformBufferObject) };
-				vkCmdBindDescriptorSets(vecCommandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &vecDescriptorSet[i], 1, uboOffsets);
-
-				vkCmdDrawIndexed(vecCommandBuffers[i], vecGameObject[j]->GetIndexArraySize(), 1, 0, 0, 0);
+				for (auto i = begin; i != end; ++i)
+				{
+					bindMesh(commandBuffer, *vecIndirectBatch[i].pFirstGameObject, boundPipeline, pBoundGeometryArena);
+					gpuCuller.RecordDraw(commandBuffer, imageIndex, vecIndirectBatch[i]);
+				}
+				return;
 			}
-			//for(const auto& gameObject : vecGameObject)
-			//{				
-			//	VkBuffer vertexBuffers[] = {gameObject->GetVertexBuffer()};
-			//	VkDeviceSize vertexOffsets[] = {0};
-			//	
-			//	vkCmdBindVertexBuffers(vecCommandBuffers[i], 0, 1, vertexBuffers, vertexOffsets);
-			//	vkCmdBindIndexBuffer(vecCommandBuffers[i], gameObject->GetIndexBuffer(), 0, VK_INDEX_TYPE_UINT32);
-
-			//	vkCmdBindDescriptorSets(vecCommandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, vecDescriptorSet.size(),
-			//	                        &vecDescriptorSet[i], 0, nullptr);
-			//	// Now using indices to draw
-			//	vkCmdDrawIndexed(vecCommandBuffers[i], gameObject->GetIndexArraySize(), 1, 0, 0, 0);
-			//}
-			//vkCmdDraw(commandBuffer, vecVertices.size(), 1, 0, 0);
-			// End Render Pass
-			vkCmdEndRenderPass(vecCommandBuffers[i]);
-			// End recording the command buffer
-			if (vkEndCommandBuffer(vecCommandBuffers[i]) != VK_SUCCESS)
+			for (auto i = begin; i != end; ++i)
 			{
-				throw std::runtime_error("Failed to record command buffer end.");
+				const auto& instanceGroup = vecInstanceGroup[i];
+				const auto& gameObject = *instanceGroup.pFirstGameObject;
+				bindMesh(commandBuffer, gameObject, boundPipeline, pBoundGeometryArena);
+				const auto& geometryRange = gameObject.GetGeometryRange();
+
+				// One draw per run of visible meshlets, or the whole level of detail
+				for (const auto& drawRange : gameObject.GetDrawRanges())
+				{
+					vkCmdDrawIndexed(commandBuffer, drawRange.IndexCount, instanceGroup.InstanceCount,
+									 geometryRange.FirstIndex + drawRange.FirstIndex, static_cast<int32_t>(geometryRange.VertexOffset),
+									 instanceGroup.FirstInstance);
+				}
 			}
+		});
+		vkCmdExecuteCommands(vecCommandBuffers[imageIndex], static_cast<uint32_t>(vecSecondary.size()), vecSecondary.data());
+		// End Render Pass
+		vkCmdEndRenderPass(vecCommandBuffers[imageIndex]);
+		// End recording the command buffer
+		if (vkEndCommandBuffer(vecCommandBuffers[imageIndex]) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to record command buffer end.");
 		}
 	}
 
@@ -945,6 +1108,7 @@ private:
 		vecSemaphoreImageAvailable.resize(MAX_FRAMES_IN_FLIGHT);
 		vecSemaphoreRenderFinished.resize(MAX_FRAMES_IN_FLIGHT);
 		vecInFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
+		vecImagesInFlight.assign(vecSwapChainImages.size(), nullptr);
 
 		VkSemaphoreCreateInfo semaphoreCreateInfo = {};
 		semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
@@ -967,29 +1131,64 @@ private:
 		}
 	}
 
+	// One buffer per swap chain image, since every image's command buffer is recorded against its own.
+	// The camera block comes first, followed by the array of object transforms and the object index of
+	// every instance drawn
 	void createUniformBuffers()
 	{
-		const auto uboSize = sizeof(SUniformBufferObject);
+		// Grows geometrically so that adding objects to a watched scene rarely reallocates
+		if (vecGameObject.size() > uniformBufferCapacity)
+		{
+			uniformBufferCapacity = std::max(vecGameObject.size(), uniformBufferCapacity * 2);
+		}
+
+		// The arrays are bound at offsets into the buffer, which must be multiples of this
+		VkPhysicalDeviceProperties properties;
+		vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+		const auto alignment = properties.limits.minStorageBufferOffsetAlignment;
+		objectTransformOffset = (sizeof(SCameraUniform) + alignment - 1) & ~(alignment - 1);
+		instanceIndexOffset = (objectTransformOffset + sizeof(SObjectTransform) * uniformBufferCapacity + alignment - 1) & ~(alignment - 1);
 
 		vecUniformBuffer.resize(vecSwapChainImages.size());
-		vecUniformBufferMemory.resize(vecSwapChainImages.size());
+		// Nothing has been written to the new buffers yet
+		vecWrittenModelVersion.assign(vecSwapChainImages.size(), std::vector<uint32_t>(uniformBufferCapacity, 0));
+		vecWrittenGpuDrawVersion.assign(vecSwapChainImages.size(), 0);
 
-		for (size_t i = 0; i < vecUniformBuffer.size(); ++i)
+		for (auto& uniformBuffer : vecUniformBuffer)
 		{
-			createBuffer(uboSize * vecGameObject.size(),
-						 VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-						 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-						 vecUniformBuffer[i], vecUniformBufferMemory[i]);
+			memoryAllocator.CreateBuffer(instanceIndexOffset + sizeof(uint32_t) * uniformBufferCapacity,
+										 VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+										 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+										 uniformBuffer);
+		}
+		if (isGpuCulling)
+		{
+			gpuCuller.CreateFrameResources(memoryAllocator, vecUniformBuffer, objectTransformOffset, uniformBufferCapacity);
+		}
+	}
+
+	void destroyUniformBuffers()
+	{
+		if (isGpuCulling)
+		{
+			gpuCuller.DestroyFrameResources(memoryAllocator);
+		}
+		for (auto& uniformBuffer : vecUniformBuffer)
+		{
+			memoryAllocator.DestroyBuffer(uniformBuffer);
 		}
 	}
 
 	void createDescriptorPool()
 	{
-		std::array<VkDescriptorPoolSize, 2> vecDescriptorPoolSize = {};
-		vecDescriptorPoolSize[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
-		vecDescriptorPoolSize[0].descriptorCount = static_cast<uint32_t>(vecSwapChainImages.size());;
+		std::array<VkDescriptorPoolSize, 3> vecDescriptorPoolSize = {};
+		vecDescriptorPoolSize[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		vecDescriptorPoolSize[0].descriptorCount = static_cast<uint32_t>(vecSwapChainImages.size());
 		vecDescriptorPoolSize[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
 		vecDescriptorPoolSize[1].descriptorCount = static_cast<uint32_t>(vecSwapChainImages.size());;
+		// The object transforms and the instances' object indices
+		vecDescriptorPoolSize[2].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		vecDescriptorPoolSize[2].descriptorCount = static_cast<uint32_t>(vecSwapChainImages.size() * 2);
 
 		VkDescriptorPoolCreateInfo createInfo = {};
 		createInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
@@ -1005,11 +1204,11 @@ private:
 
 	void createDescriptorSetLayout()
 	{
-		VkDescriptorSetLayoutBinding uboLayoutBinding = {};
-		uboLayoutBinding.binding = 0;
-		uboLayoutBinding.descriptorCount = 1;
-		uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
-		uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+		VkDescriptorSetLayoutBinding cameraBinding = {};
+		cameraBinding.binding = 0;
+		cameraBinding.descriptorCount = 1;
+		cameraBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		cameraBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
 
 		VkDescriptorSetLayoutBinding samplerBinding = {};
 		samplerBinding.binding = 1;
@@ -1018,7 +1217,20 @@ private:
 		samplerBinding.pImmutableSamplers = nullptr;
 		samplerBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
 
-		std::array<VkDescriptorSetLayoutBinding, 2> bindings = { uboLayoutBinding, samplerBinding };
+		VkDescriptorSetLayoutBinding objectTransformBinding = {};
+		objectTransformBinding.binding = 2;
+		objectTransformBinding.descriptorCount = 1;
+		objectTransformBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		objectTransformBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+		// Indexed by gl_InstanceIndex, gives the index of the instance's object transform
+		VkDescriptorSetLayoutBinding instanceIndexBinding = {};
+		instanceIndexBinding.binding = 3;
+		instanceIndexBinding.descriptorCount = 1;
+		instanceIndexBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		instanceIndexBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+		std::array<VkDescriptorSetLayoutBinding, 4> bindings = { cameraBinding, samplerBinding, objectTransformBinding, instanceIndexBinding };
 
 		VkDescriptorSetLayoutCreateInfo layoutCreateInfo = {};
 		layoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
@@ -1048,24 +1260,34 @@ private:
 
 		for (size_t i = 0; i != vecSwapChainImages.size(); ++i)
 		{
-			VkDescriptorBufferInfo bufferInfo = {};
-			bufferInfo.buffer = vecUniformBuffer[i];
-			bufferInfo.offset = 0;
-			bufferInfo.range = sizeof(SUniformBufferObject);
+			VkDescriptorBufferInfo cameraBufferInfo = {};
+			cameraBufferInfo.buffer = vecUniformBuffer[i].Buffer;
+			cameraBufferInfo.offset = 0;
+			cameraBufferInfo.range = sizeof(SCameraUniform);
+
+			VkDescriptorBufferInfo objectTransformBufferInfo = {};
+			objectTransformBufferInfo.buffer = vecUniformBuffer[i].Buffer;
+			objectTransformBufferInfo.offset = objectTransformOffset;
+			objectTransformBufferInfo.range = sizeof(SObjectTransform) * uniformBufferCapacity;
+
+			VkDescriptorBufferInfo instanceIndexBufferInfo = {};
+			instanceIndexBufferInfo.buffer = vecUniformBuffer[i].Buffer;
+			instanceIndexBufferInfo.offset = instanceIndexOffset;
+			instanceIndexBufferInfo.range = sizeof(uint32_t) * uniformBufferCapacity;
 
 			VkDescriptorImageInfo imageInfo = {};
 			imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 			imageInfo.imageView = textureImageView;
 			imageInfo.sampler = textureSampler;
 
-			std::array<VkWriteDescriptorSet, 2> vecWriteDescriptorSet = {};
+			std::array<VkWriteDescriptorSet, 4> vecWriteDescriptorSet = {};
 			vecWriteDescriptorSet[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
 			vecWriteDescriptorSet[0].descriptorCount = 1;
-			vecWriteDescriptorSet[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+			vecWriteDescriptorSet[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
 			vecWriteDescriptorSet[0].dstSet = vecDescriptorSet[i];
 			vecWriteDescriptorSet[0].dstBinding = 0;
 			vecWriteDescriptorSet[0].dstArrayElement = 0;
-			vecWriteDescriptorSet[0].pBufferInfo = &bufferInfo;
+			vecWriteDescriptorSet[0].pBufferInfo = &cameraBufferInfo;
 			vecWriteDescriptorSet[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
 			vecWriteDescriptorSet[1].descriptorCount = 1;
 			vecWriteDescriptorSet[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
@@ -1073,6 +1295,20 @@ private:
 			vecWriteDescriptorSet[1].dstBinding = 1;
 			vecWriteDescriptorSet[1].dstArrayElement = 0;
 			vecWriteDescriptorSet[1].pImageInfo = &imageInfo;
+			vecWriteDescriptorSet[2].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			vecWriteDescriptorSet[2].descriptorCount = 1;
+			vecWriteDescriptorSet[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			vecWriteDescriptorSet[2].dstSet = vecDescriptorSet[i];
+			vecWriteDescriptorSet[2].dstBinding = 2;
+			vecWriteDescriptorSet[2].dstArrayElement = 0;
+			vecWriteDescriptorSet[2].pBufferInfo = &objectTransformBufferInfo;
+			vecWriteDescriptorSet[3].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			vecWriteDescriptorSet[3].descriptorCount = 1;
+			vecWriteDescriptorSet[3].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			vecWriteDescriptorSet[3].dstSet = vecDescriptorSet[i];
+			vecWriteDescriptorSet[3].dstBinding = 3;
+			vecWriteDescriptorSet[3].dstArrayElement = 0;
+			vecWriteDescriptorSet[3].pBufferInfo = &instanceIndexBufferInfo;
 
 			vkUpdateDescriptorSets(device, static_cast<uint32_t>(vecWriteDescriptorSet.size()),
 								   vecWriteDescriptorSet.data(), 0, nullptr);
@@ -1108,42 +1344,94 @@ private:
 
 		const auto currentTime = std::chrono::high_resolution_clock::now();
 
-		const auto deltaTime = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).
+		// In double so the object rotations stay exact however long the application runs
+		const auto deltaTime = std::chrono::duration<double, std::chrono::seconds::period>(currentTime - startTime).
 			count();
 
-		VkMemoryRequirements memoryRequirements;
-		vkGetBufferMemoryRequirements(device, vecUniformBuffer[imageIndex], &memoryRequirements);
+		SCameraUniform camera = {};
+		camera.View = glm::lookAt(glm::vec3(0.0f, 0.0f, 10.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+		camera.Projection = glm::perspective(glm::radians(45.0f),
+											 swapChainExtent.width / static_cast<float>(swapChainExtent.height),
+											 0.1f,
+											 100.f);
+		camera.Projection[1][1] *= -1; // Y is inverted compared to OpenGL
+		const auto arrPlane = CObjectCuller::GetFrustumPlanes(camera.Projection * camera.View);
+		std::copy(arrPlane.begin(), arrPlane.end(), camera.FrustumPlanes);
+
+		// Stays mapped for as long as the buffer exists
+		auto* data = static_cast<uint8_t*>(vecUniformBuffer[imageIndex].Allocation.pMappedData);
+		std::memcpy(data, &camera, sizeof(camera));
+		data += objectTransformOffset;
+
+		transformSystem.Update(deltaTime);
+		// The compute pass culls whole objects instead, and always draws the full detail level
+		if (!isGpuCulling)
+		{
+			cullObjects(arrPlane);
+		}
 
-		uint8_t* data;
-		vkMapMemory(device, vecUniformBufferMemory[imageIndex], 0, memoryRequirements.size, 0, reinterpret_cast<void**>(&data));
-		for (auto& gameObject : vecGameObject)
+		auto& vecWrittenVersion = vecWrittenModelVersion[imageIndex];
+		meshletStatistics = {};
+		for (size_t j = 0; j != vecGameObject.size(); ++j)
 		{
-			SUniformBufferObject ubo = {};
-			ubo.Model = glm::mat4(1.0f);
-
-			const auto scale = glm::scale(glm::mat4(1.0f), gameObject->mTransform.Scale);
-			const auto rotationX = glm::rotate(glm::mat4(1.0f),
-											   deltaTime * glm::radians(gameObject->mTransform.Rotation.x),
-											   glm::vec3(1.0f, 0.0f, 0.0f));
-			const auto rotationY = glm::rotate(glm::mat4(1.0f),
-											   deltaTime * glm::radians(gameObject->mTransform.Rotation.y),
-											   glm::vec3(0.0f, 1.0f, 0.0f));
-			const auto rotationZ = glm::rotate(glm::mat4(1.0f),
-											   deltaTime * glm::radians(gameObject->mTransform.Rotation.z),
-											   glm::vec3(0.0f, 0.0f, 1.0f));
-			const auto translate = glm::translate(glm::mat4(1.0f), gameObject->mTransform.Position);
-			ubo.Model = translate * rotationX * rotationY * rotationZ * scale * ubo.Model;
-			ubo.View = glm::lookAt(glm::vec3(0.0f, 0.0f, 10.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-			ubo.Projection = glm::perspective(glm::radians(45.0f),
-											  swapChainExtent.width / static_cast<float>(swapChainExtent.height),
-											  0.1f,
-											  100.f);
-			ubo.Projection[1][1] *= -1; // Y is inverted compared to OpenGL
-
-			std::memcpy(data, &ubo, sizeof(ubo));
-			data += sizeof(ubo);
-		}
-		vkUnmapMemory(device, vecUniformBufferMemory[imageIndex]);
+			// Neither drawn nor written, its slot is written once it comes back into view
+			auto& gameObject = vecGameObject[j];
+			if (!gameObject->mIsVisible)
+				continue;
+
+			if (!isGpuCulling)
+			{
+				const auto modelView = camera.View * transformSystem.GetModelMatrix(j);
+				gameObject->UpdateLod(modelView, camera.Projection[1][1]);
+				gameObject->UpdateDrawRanges(modelView, camera.Projection, meshletStatistics);
+			}
+
+			// Static objects are only written once per image, until they move
+			const auto version = transformSystem.GetVersion(j);
+			if (vecWrittenVersion[j] != version)
+			{
+				std::memcpy(data + j * sizeof(SObjectTransform), &transformSystem.GetObjectTransform(j), sizeof(SObjectTransform));
+				vecWrittenVersion[j] = version;
+			}
+		}
+
+#ifdef PRINT_MESHLET_STATISTICS
+		static auto lastPrintTime = startTime;
+		if (currentTime - lastPrintTime > std::chrono::seconds(1))
+		{
+			lastPrintTime = currentTime;
+			std::cout << "Meshlets: " << meshletStatistics.MeshletCount << ", frustum culled "
+				<< meshletStatistics.FrustumCulledCount << ", backface culled " << meshletStatistics.BackfaceCulledCount << std::endl;
+		}
+#endif
+	}
+
+	// Refreshes the world space boxes of the objects whose model matrix changed, then culls every box against
+	// the frustum. Objects left out are skipped by the next recording
+	void cullObjects(const std::array<glm::vec4, 6>& arrPlane)
+	{
+		if (frustumCuller.GetCount() != vecGameObject.size())
+		{
+			frustumCuller.Resize(vecGameObject.size());
+			vecBoundsModelVersion.assign(vecGameObject.size(), 0);
+		}
+		for (size_t j = 0; j != vecGameObject.size(); ++j)
+		{
+			const auto& gameObject = vecGameObject[j];
+			const auto version = transformSystem.GetVersion(j);
+			if (gameObject->IsDrawable() && vecBoundsModelVersion[j] != version)
+			{
+				const auto& modelInfo = *gameObject->mModelInformation;
+				frustumCuller.SetBounds(j, modelInfo.BoundsMin, modelInfo.BoundsMax, transformSystem.GetModelMatrix(j));
+				vecBoundsModelVersion[j] = version;
+			}
+		}
+
+		frustumCuller.Cull(arrPlane, vecObjectVisible);
+		for (size_t j = 0; j != vecGameObject.size(); ++j)
+		{
+			vecGameObject[j]->mIsVisible = vecObjectVisible[j] != 0;
+		}
 	}
 
 	void drawFrame()
@@ -1166,7 +1454,23 @@ private:
 			throw std::runtime_error("Failed to acquire the swapchain image");
 		}
 
+		// The image may still be in use by an earlier frame that was given another set of sync objects
+		if (vecImagesInFlight[imageIndex] != nullptr)
+		{
+			vkWaitForFences(device, 1, &vecImagesInFlight[imageIndex], VK_TRUE, std::numeric_limits<uint64_t>::max());
+#ifdef VALIDATE_GPU_CULLING
+			// The image's last cull has executed and nothing it read has been written over yet
+			if (isGpuCulling)
+			{
+				validateGpuCulling(imageIndex);
+			}
+#endif
+		}
+		vecImagesInFlight[imageIndex] = vecInFlightFences[currentFrame];
+
+		// Also culls and selects the levels of detail, so it has to come before recording
 		updateUniformBuffer(imageIndex);
+		recordCommandBuffer(imageIndex);
 
 		VkSubmitInfo submitInfo = {};
 		VkSemaphore waitSemaphores[] = {
@@ -1218,6 +1522,21 @@ private:
 		currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
 	}
 
+#ifdef VALIDATE_GPU_CULLING
+	void validateGpuCulling(const uint32_t imageIndex) const
+	{
+		static auto lastPrintTime = std::chrono::high_resolution_clock::now();
+		const auto mismatchCount = gpuCuller.Validate(imageIndex);
+		const auto currentTime = std::chrono::high_resolution_clock::now();
+		if (mismatchCount != 0 || currentTime - lastPrintTime > std::chrono::seconds(1))
+		{
+			lastPrintTime = currentTime;
+			std::cout << "GPU culling: " << gpuCuller.GetVisibleCount(imageIndex) << " of " << gpuCuller.GetObjectCount(imageIndex)
+				<< " objects visible, " << mismatchCount << " draw commands differ from the CPU reference" << std::endl;
+		}
+	}
+#endif
+
 	void recreateSwapChain()
 	{
 		auto width = 0, height = 0;
@@ -1241,6 +1560,7 @@ private:
 		createDescriptorPool();
 		createDescriptorSets();
 		createCommandBuffers();
+		vecImagesInFlight.assign(vecSwapChainImages.size(), nullptr);
 	}
 
 	void cleanupSwapChain()
@@ -1250,14 +1570,15 @@ private:
 			vkDestroyFramebuffer(device, framebuffer, nullptr);
 		}
 
-		vkDestroyImage(device, depthImage, nullptr);
-		vkFreeMemory(device, depthImageMemory, nullptr);
 		vkDestroyImageView(device, depthImageView, nullptr);
+		memoryAllocator.DestroyImage(depthImage, depthImageAllocation);
 
 		vkFreeCommandBuffers(device, vecCommandPools[0], static_cast<uint32_t>(vecCommandBuffers.size()),
 							 vecCommandBuffers.data());
+		parallelRecorder.DestroyFrameResources();
 
 		vkDestroyPipeline(device, graphicsPipeline, nullptr);
+		vkDestroyPipeline(device, packedGraphicsPipeline, nullptr);
 		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 		vkDestroyRenderPass(device, renderPass, nullptr);
 		for (auto imageView : vecSwapChainImageViews)
@@ -1266,50 +1587,14 @@ private:
 		}
 		vkDestroySwapchainKHR(device, swapChain, nullptr);
 
-		for (size_t i = 0; i < vecUniformBuffer.size(); ++i)
-		{
-			vkDestroyBuffer(device, vecUniformBuffer[i], nullptr);
-			vkFreeMemory(device, vecUniformBufferMemory[i], nullptr);
-		}
+		destroyUniformBuffers();
 
 		vkDestroyDescriptorPool(device, descriptorPool, nullptr);
 	}
 
-	void createBuffer(const VkDeviceSize size, const VkBufferUsageFlags usageFlags,
-					  const VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory) const
-	{
-		VkBufferCreateInfo bufferCreateInfo = {};
-		bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-		bufferCreateInfo.size = size;
-		bufferCreateInfo.usage = usageFlags;
-		bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-
-		if (vkCreateBuffer(device, &bufferCreateInfo, nullptr, &buffer) != VK_SUCCESS)
-		{
-			throw std::runtime_error("Failed to create the buffer.");
-		}
-
-		// Get Memory Requirements
-		VkMemoryRequirements memoryRequirements;
-		vkGetBufferMemoryRequirements(device, buffer, &memoryRequirements);
-
-		VkMemoryAllocateInfo memoryAllocateInfo = {};
-		memoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-		memoryAllocateInfo.allocationSize = memoryRequirements.size;
-		memoryAllocateInfo.memoryTypeIndex = CSetupHelpers::FindMemoryType(
-			physicalDevice, memoryRequirements.memoryTypeBits, properties);
-
-		if (vkAllocateMemory(device, &memoryAllocateInfo, nullptr, &bufferMemory) != VK_SUCCESS)
-		{
-			throw std::runtime_error("Failed to allocate memory for the buffer.");
-		}
-
-		vkBindBufferMemory(device, buffer, bufferMemory, 0);
-	}
-
 	void createImage(const uint32_t width, const uint32_t height, const VkFormat format, const VkImageTiling tiling,
 					 const VkImageUsageFlags usage, const VkMemoryPropertyFlags properties, VkImage& image,
-					 VkDeviceMemory& imageMemory) const
+					 SMemoryAllocation& imageAllocation)
 	{
 		VkImageCreateInfo imageCreateInfo = {};
 		imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -1326,158 +1611,7 @@ private:
 		imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 		imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 
-		vkCreateImage(device, &imageCreateInfo, nullptr, &image);
-
-		VkMemoryRequirements memoryRequirements = {};
-		vkGetImageMemoryRequirements(device, image, &memoryRequirements);
-
-		VkMemoryAllocateInfo allocateInfo = {};
-		allocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-		allocateInfo.allocationSize = memoryRequirements.size;
-		allocateInfo.memoryTypeIndex = CSetupHelpers::FindMemoryType(physicalDevice, memoryRequirements.memoryTypeBits,
-																	 properties);
-
-		if (vkAllocateMemory(device, &allocateInfo, nullptr, &imageMemory) != VK_SUCCESS)
-		{
-			throw std::runtime_error("Failed to allocate memory for the image.");
-		}
-
-		vkBindImageMemory(device, image, imageMemory, 0);
-	}
-
-	void copyBuffer(const VkBuffer srcBuffer, const VkBuffer dstBuffer, const VkDeviceSize size)
-	{
-		const auto commandBuffer = CreateBeginCommandBuffer(1);
-		// Copy vertex buffer using command buffer
-		VkBufferCopy bufferCopy;
-		bufferCopy.size = size;
-		bufferCopy.dstOffset = 0;
-		bufferCopy.srcOffset = 0;
-		vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &bufferCopy);
-		// End command buffer
-		EndCommandBuffer(commandBuffer, 1);
-	}
-
-	void transitionImageLayout(const VkImage image, const VkFormat format, const VkImageLayout oldLayout,
-							   const VkImageLayout newLayout)
-	{
-		const auto commandBuffer = CreateBeginCommandBuffer(0);
-
-
-		VkImageMemoryBarrier memoryBarrier = {};
-		memoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-		memoryBarrier.oldLayout = oldLayout;
-		memoryBarrier.newLayout = newLayout;
-		memoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-		memoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-		memoryBarrier.image = image;
-		memoryBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		memoryBarrier.subresourceRange.baseMipLevel = 0;
-		memoryBarrier.subresourceRange.levelCount = 1;
-		memoryBarrier.subresourceRange.baseArrayLayer = 0;
-		memoryBarrier.subresourceRange.layerCount = 1;
-
-		VkPipelineStageFlags sourceStage;
-		VkPipelineStageFlags destinationStage;
-
-		if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED &&
-			newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL)
-		{
-			memoryBarrier.srcAccessMask = 0;
-			memoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-
-			sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-			destinationStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-		}
-		else if (oldLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL &&
-				 newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
-		{
-			memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-			memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-			sourceStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-			destinationStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-		}
-		else if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED &&
-				 newLayout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL)
-		{
-			memoryBarrier.srcAccessMask = 0;
-			memoryBarrier.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
-				VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-
-			sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-			destinationStage = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-		}
-		else
-		{
-			throw std::invalid_argument("Unsupported layout transition.");
-		}
-
-		vkCmdPipelineBarrier(commandBuffer,
-							 sourceStage, destinationStage,
-							 0, 0,
-							 nullptr, 0,
-							 nullptr, 1,
-							 &memoryBarrier);
-
-		EndCommandBuffer(commandBuffer, 0);
-	}
-
-	void copyBufferToImage(const VkBuffer buffer, const VkImage image, const uint32_t width, const uint32_t height)
-	{
-		// For operations that end up in VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT USE GRAPHICS QUEUE
-		const auto commandBuffer = CreateBeginCommandBuffer(0);
-
-		VkBufferImageCopy bufferImageCopy = {};
-		bufferImageCopy.bufferOffset = 0;
-		bufferImageCopy.bufferRowLength = 0;
-		bufferImageCopy.bufferImageHeight = 0;
-		bufferImageCopy.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		bufferImageCopy.imageSubresource.mipLevel = 0;
-		bufferImageCopy.imageSubresource.baseArrayLayer = 0;
-		bufferImageCopy.imageSubresource.layerCount = 1;
-		bufferImageCopy.imageOffset = { 0, 0, 0 };
-		bufferImageCopy.imageExtent.width = width;
-		bufferImageCopy.imageExtent.height = height;
-		bufferImageCopy.imageExtent.depth = 1;
-
-		vkCmdCopyBufferToImage(commandBuffer, buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &bufferImageCopy);
-
-		EndCommandBuffer(commandBuffer, 0);
-	}
-
-	[[nodiscard]] VkCommandBuffer CreateBeginCommandBuffer(const uint32_t queueIndex)
-	{
-		VkCommandBufferAllocateInfo allocateInfo = {};
-		allocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-		allocateInfo.commandBufferCount = 1;
-		allocateInfo.commandPool = vecCommandPools[queueIndex];
-		allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-
-		VkCommandBuffer commandBuffer;
-		vkAllocateCommandBuffers(device, &allocateInfo, &commandBuffer);
-
-		VkCommandBufferBeginInfo beginInfo = {};
-		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-
-		vkBeginCommandBuffer(commandBuffer, &beginInfo);
-
-		return commandBuffer;
-	}
-
-	void EndCommandBuffer(VkCommandBuffer commandBuffer, const uint32_t queueIndex)
-	{
-		vkEndCommandBuffer(commandBuffer);
-
-		VkSubmitInfo submitInfo = {};
-		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-		submitInfo.commandBufferCount = 1;
-		submitInfo.pCommandBuffers = &commandBuffer;
-
-		vkQueueSubmit(queueIndex == 0 ? graphicsQueue : transferQueue, 1, &submitInfo, nullptr);
-		vkQueueWaitIdle(queueIndex == 0 ? graphicsQueue : transferQueue);
-		vkFreeCommandBuffers(device, vecCommandPools[queueIndex], 1, &commandBuffer);
+		memoryAllocator.CreateImage(imageCreateInfo, properties, image, imageAllocation);
 	}
 
 	[[nodiscard]] VkShaderModule createShaderModule(const std::vector<char>& code) const
@@ -1527,41 +1661,146 @@ private:
 	// No need to cleanup, will be cleaned up with the descriptor pool
 	std::vector<VkDescriptorSet> vecDescriptorSet;
 	VkPipeline graphicsPipeline = nullptr;
+	VkPipeline packedGraphicsPipeline = nullptr;
 	std::vector<VkFramebuffer> vecSwapChainFramebuffers;
 	std::vector<VkCommandPool> vecCommandPools;
+	// Meshes stream in on the transfer queue, the texture goes through the graphics queue
+	SUploadQueues uploadQueues;
 	// No need to cleanup, will be cleaned up with the command pool
 	std::vector<VkCommandBuffer> vecCommandBuffers;
 	std::vector<VkSemaphore> vecSemaphoreImageAvailable;
 	std::vector<VkSemaphore> vecSemaphoreRenderFinished;
 	std::vector<VkFence> vecInFlightFences;
+	// The in flight fence of the frame currently using each swap chain image, not owned
+	std::vector<VkFence> vecImagesInFlight;
 	size_t currentFrame = 0;
 	bool framebufferResized = false;
-	std::vector<SVertex> vecVertices;
-	std::vector<uint32_t> vecIndices;
 	VkImage textureImage = nullptr;
-	VkDeviceMemory textureImageMemory = nullptr;
+	SMemoryAllocation textureImageAllocation;
 	VkImageView textureImageView = nullptr;
 	VkSampler textureSampler = nullptr;
-	/*VkBuffer vertexBuffer = nullptr;
-	VkDeviceMemory vertexBufferMemory = nullptr;
-	VkBuffer indexBuffer = nullptr;
-	VkDeviceMemory indexBufferMemory = nullptr;*/
 	VkImage depthImage = nullptr;
-	VkDeviceMemory depthImageMemory = nullptr;
+	SMemoryAllocation depthImageAllocation;
 	VkImageView depthImageView = nullptr;
-	std::vector<VkBuffer> vecUniformBuffer;
-	std::vector<VkDeviceMemory> vecUniformBufferMemory;
-
+	// Per swap chain image, persistently mapped
+	std::vector<SBuffer> vecUniformBuffer;
+	// Per swap chain image and object, the model matrix version last written there, zero when stale
+	std::vector<std::vector<uint32_t>> vecWrittenModelVersion;
+	// In game objects, at least vecGameObject.size()
+	size_t uniformBufferCapacity = 0;
+	// Where the object transforms and the instances' object indices start in each uniform buffer
+	VkDeviceSize objectTransformOffset = 0;
+	VkDeviceSize instanceIndexOffset = 0;
+
+	CDeviceMemoryAllocator memoryAllocator;
+	// Every upload copies its data through this
+	CStagingRing stagingRing;
 	GameObjectVecPtrs vecGameObject;
+	// Shared by the mesh loads and the per frame work. The thread starting per frame work takes a share of it
+	// itself, so there is one worker fewer than there are hardware threads
+	CThreadPool threadPool{ std::max(2u, std::thread::hardware_concurrency()) - 1 };
+	CMeshRegistry meshRegistry{ threadPool };
+	const bool isWatchingScene;
+	// Cleared in createLogicalDevice when the device can't draw the culled objects indirectly
+	bool isGpuCulling;
+	// Only initialized when culling on the GPU
+	CGpuCuller gpuCuller;
+	// When culling on the GPU, the batches and cull objects of every drawable object
+	std::vector<SIndirectBatch> vecIndirectBatch;
+	std::vector<SGpuCullObject> vecCullObject;
+	// Set when objects were added, removed or reordered since the draws were built
+	bool isGpuDrawStale = true;
+	// The mesh registry's residency version the draws were built for
+	uint64_t gpuDrawResidencyVersion = 0;
+	// Bumped on every build of the draws. Per swap chain image, the build last written there, zero when stale
+	uint64_t gpuDrawVersion = 0;
+	std::vector<uint64_t> vecWrittenGpuDrawVersion;
+	// Only created when watching the scene
+	std::unique_ptr<CFileWatcher> pSceneWatcher;
+	// Totals over every object for the last frame
+	SMeshletCullStatistics meshletStatistics;
+	// Model matrices of the game objects, in the same order
+	CTransformSystem transformSystem{ threadPool };
+	// Owns the secondary command buffers the draws are recorded into
+	CParallelRecorder parallelRecorder;
+	// World space boxes of the game objects, in the same order, when culling on the CPU
+	CFrustumCuller frustumCuller{ threadPool };
+	// Per game object, the model matrix version its box was computed from, zero when stale
+	std::vector<uint32_t> vecBoundsModelVersion;
+	std::vector<uint8_t> vecObjectVisible;
 };
 
-int main()
+int main(int argc, char* argv[])
 {
 #ifdef _MSC_VER
 	_CrtSetDbgFlag(_CRTDBG_ALLOC_MEM_DF | _CRTDBG_LEAK_CHECK_DF);
 #endif
 
-	HelloTriangleApp app;
+	// HelloTriangle --convert-scene <input> <output> turns a JSON scene into a binary one, or back
+	if (argc == 4 && std::strcmp(argv[1], "--convert-scene") == 0)
+	{
+		try
+		{
+			CBinaryScene::Convert(argv[2], argv[3]);
+		}
+		catch (const std::exception & e)
+		{
+			std::cerr << e.what() << std::endl;
+			return EXIT_FAILURE;
+		}
+		return EXIT_SUCCESS;
+	}
+
+	// HelloTriangle --benchmark-model-loading times the OBJ loaders on the chalet and on a generated 10M triangle mesh.
+	// HelloTriangle --benchmark-frustum-culling times the scalar, AVX2 and multithreaded culls of 1M random boxes.
+	// HelloTriangle --benchmark-transforms times glm::rotate chains against the SSE compose of 10K and 100K objects.
+	// HelloTriangle --benchmark-scene-loading times the SAX parser against a DOM and the binary scene for 100K objects
+	const auto isBenchmarkingModelLoading = argc == 2 && std::strcmp(argv[1], "--benchmark-model-loading") == 0;
+	const auto isBenchmarkingFrustumCulling = argc == 2 && std::strcmp(argv[1], "--benchmark-frustum-culling") == 0;
+	const auto isBenchmarkingTransforms = argc == 2 && std::strcmp(argv[1], "--benchmark-transforms") == 0;
+	const auto isBenchmarkingSceneLoading = argc == 2 && std::strcmp(argv[1], "--benchmark-scene-loading") == 0;
+	if (isBenchmarkingModelLoading || isBenchmarkingFrustumCulling || isBenchmarkingTransforms || isBenchmarkingSceneLoading)
+	{
+		try
+		{
+			// Sized like the application's, the calling thread takes a share of the work itself
+			CThreadPool threadPool(std::max(2u, std::thread::hardware_concurrency()) - 1);
+			if (isBenchmarkingModelLoading)
+			{
+				CModelLoader::Benchmark(10000000);
+			}
+			else if (isBenchmarkingFrustumCulling)
+			{
+				CFrustumCuller::Benchmark(threadPool, 1000000);
+			}
+			else if (isBenchmarkingTransforms)
+			{
+				CTransformSystem::Benchmark(threadPool, 10000);
+				CTransformSystem::Benchmark(threadPool, 100000);
+			}
+			else
+			{
+				CSceneParser::Benchmark(100000);
+			}
+		}
+		catch (const std::exception & e)
+		{
+			std::cerr << e.what() << std::endl;
+			return EXIT_FAILURE;
+		}
+		return EXIT_SUCCESS;
+	}
+
+	// HelloTriangle [--watch-scene] [--gpu-culling]. --watch-scene reloads the scene whenever Scene.json is
+	// saved, --gpu-culling culls objects in a compute pass and draws them with indirect draws
+	auto isWatchingScene = false;
+	auto isGpuCulling = false;
+	for (auto i = 1; i < argc; ++i)
+	{
+		isWatchingScene |= std::strcmp(argv[i], "--watch-scene") == 0;
+		isGpuCulling |= std::strcmp(argv[i], "--gpu-culling") == 0;
+	}
+	HelloTriangleApp app(isWatchingScene, isGpuCulling);
 
 	try
 	{
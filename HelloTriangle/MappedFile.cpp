@@ -0,0 +1,73 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+CMappedFile::CMappedFile(const char* filename)
+{
+	fileHandle = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+							 FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (fileHandle == INVALID_HANDLE_VALUE)
+	{
+		fileHandle = nullptr;
+		return;
+	}
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart == 0)
+		return;
+
+	mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mappingHandle == nullptr)
+		return;
+
+	pData = static_cast<const char*>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+	if (pData != nullptr)
+		dataSize = static_cast<size_t>(fileSize.QuadPart);
+}
+
+CMappedFile::~CMappedFile()
+{
+	if (pData != nullptr)
+		UnmapViewOfFile(pData);
+	if (mappingHandle != nullptr)
+		CloseHandle(mappingHandle);
+	if (fileHandle != nullptr)
+		CloseHandle(fileHandle);
+}
+#else
+CMappedFile::CMappedFile(const char* filename)
+{
+	fileDescriptor = open(filename, O_RDONLY);
+	if (fileDescriptor < 0)
+		return;
+
+	struct stat fileStat = {};
+	if (fstat(fileDescriptor, &fileStat) != 0 || fileStat.st_size == 0)
+		return;
+
+	auto pMapping = mmap(nullptr, static_cast<size_t>(fileStat.st_size), PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+	if (pMapping == MAP_FAILED)
+		return;
+
+	pData = static_cast<const char*>(pMapping);
+	dataSize = static_cast<size_t>(fileStat.st_size);
+}
+
+CMappedFile::~CMappedFile()
+{
+	if (pData != nullptr)
+		munmap(const_cast<char*>(pData), dataSize);
+	if (fileDescriptor >= 0)
+		close(fileDescriptor);
+}
+#endif
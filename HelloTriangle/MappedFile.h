@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+
+// Read-only memory mapping of a whole file. Check IsOpen() after construction,
+// a missing or empty file leaves the mapping closed
+class CMappedFile
+{
+public:
+	explicit CMappedFile(const char* filename);
+	~CMappedFile();
+	CMappedFile(const CMappedFile&) = delete;
+	CMappedFile& operator=(const CMappedFile&) = delete;
+	CMappedFile(CMappedFile&&) = delete;
+	CMappedFile& operator=(CMappedFile&&) = delete;
+
+	[[nodiscard]] bool IsOpen() const { return pData != nullptr; }
+	[[nodiscard]] const char* GetData() const { return pData; }
+	[[nodiscard]] size_t GetSize() const { return dataSize; }
+
+private:
+	const char* pData = nullptr;
+	size_t dataSize = 0;
+#ifdef _WIN32
+	void* fileHandle = nullptr;
+	void* mappingHandle = nullptr;
+#else
+	int fileDescriptor = -1;
+#endif
+};
@@ -0,0 +1,323 @@
+#include "MemoryBlockMetadata.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace
+{
+	uint64_t alignUp(const uint64_t value, const uint64_t alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+
+	// value must not be 0
+	uint32_t findLowestBit(const uint64_t value)
+	{
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanForward64(&index, value);
+		return index;
+#else
+		return static_cast<uint32_t>(__builtin_ctzll(value));
+#endif
+	}
+
+	// value must not be 0
+	uint32_t findHighestBit(const uint64_t value)
+	{
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanReverse64(&index, value);
+		return index;
+#else
+		return 63 - static_cast<uint32_t>(__builtin_clzll(value));
+#endif
+	}
+}
+
+bool IBlockMetadata::isOnSharedPage(const uint64_t aEnd, const EAllocationType a, const uint64_t bOffset, const EAllocationType b) const
+{
+	if (mGranularity <= 1 || a == b || a == EAllocationType::Free || b == EAllocationType::Free)
+		return false;
+	const auto pageMask = ~(mGranularity - 1);
+	return ((aEnd - 1) & pageMask) == (bOffset & pageMask);
+}
+
+bool CLinearBlockMetadata::Allocate(const uint64_t size, const uint64_t alignment, const EAllocationType type, SBlockAllocation& outAllocation)
+{
+	auto offset = alignUp(nextOffset, alignment);
+	if (mAllocationCount != 0 && isOnSharedPage(nextOffset, lastType, offset, type))
+		offset = alignUp(offset, mGranularity);
+	if (offset > mBlockSize || size > mBlockSize - offset)
+		return false;
+
+	nextOffset = offset + size;
+	lastType = type;
+	mUsedSize += size;
+	++mAllocationCount;
+	outAllocation = { offset, size, 0 };
+	return true;
+}
+
+void CLinearBlockMetadata::Free(const SBlockAllocation& allocation)
+{
+	mUsedSize -= allocation.Size;
+	if (--mAllocationCount == 0)
+	{
+		nextOffset = 0;
+		lastType = EAllocationType::Free;
+	}
+}
+
+CTlsfBlockMetadata::CTlsfBlockMetadata(const uint64_t blockSize, const uint64_t granularity) : IBlockMetadata(blockSize, granularity)
+{
+	arrFreeHead.fill(NO_RANGE);
+	const auto rangeIndex = createRange();
+	vecRange[rangeIndex].Size = blockSize;
+	insertFree(rangeIndex);
+}
+
+bool CTlsfBlockMetadata::Allocate(const uint64_t size, const uint64_t alignment, const EAllocationType type, SBlockAllocation& outAllocation)
+{
+	if (size > mBlockSize - mUsedSize)
+		return false;
+
+	// Any range in the list above size plus the worst case padding fits, so the first one found is taken
+	auto searchSize = size + alignment - 1;
+	if (mGranularity > 1)
+		searchSize += mGranularity - 1;
+	if (searchSize >= SECOND_LEVEL_COUNT)
+		searchSize += (uint64_t(1) << (findHighestBit(searchSize) - SECOND_LEVEL_BITS)) - 1;
+
+	uint64_t offset = 0;
+	const auto goodFitList = findList(searchSize);
+	auto rangeIndex = findFreeRange(goodFitList, LIST_COUNT - 1, size, alignment, type, offset);
+	if (rangeIndex == NO_RANGE && goodFitList != 0)
+	{
+		// Nothing that big is free, a smaller range may still fit once aligned
+		rangeIndex = findFreeRange(findList(size), goodFitList - 1, size, alignment, type, offset);
+		if (rangeIndex == NO_RANGE)
+			return false;
+	}
+	else if (rangeIndex == NO_RANGE)
+	{
+		return false;
+	}
+
+	removeFree(rangeIndex);
+	if (offset != vecRange[rangeIndex].Offset)
+	{
+		// The previous range is in use, otherwise the two would have been merged
+		insertFree(splitFront(rangeIndex, offset - vecRange[rangeIndex].Offset));
+	}
+	auto allocationIndex = rangeIndex;
+	if (vecRange[rangeIndex].Size != size)
+	{
+		allocationIndex = splitFront(rangeIndex, size);
+		insertFree(rangeIndex);
+	}
+
+	vecRange[allocationIndex].Type = type;
+	mUsedSize += size;
+	++mAllocationCount;
+	outAllocation = { offset, size, allocationIndex };
+	return true;
+}
+
+void CTlsfBlockMetadata::Free(const SBlockAllocation& allocation)
+{
+	auto rangeIndex = allocation.Handle;
+	vecRange[rangeIndex].Type = EAllocationType::Free;
+	mUsedSize -= allocation.Size;
+	--mAllocationCount;
+
+	const auto nextIndex = vecRange[rangeIndex].NextPhysical;
+	if (nextIndex != NO_RANGE && vecRange[nextIndex].Type == EAllocationType::Free)
+	{
+		removeFree(nextIndex);
+		mergeIntoNext(rangeIndex);
+		rangeIndex = nextIndex;
+	}
+	const auto prevIndex = vecRange[rangeIndex].PrevPhysical;
+	if (prevIndex != NO_RANGE && vecRange[prevIndex].Type == EAllocationType::Free)
+	{
+		removeFree(prevIndex);
+		mergeIntoNext(prevIndex);
+	}
+	insertFree(rangeIndex);
+}
+
+void CTlsfBlockMetadata::Grow(const uint64_t newBlockSize)
+{
+	// Unused slots are zeroed, so only the range at the end of the block matches
+	uint32_t lastIndex = 0;
+	while (vecRange[lastIndex].Offset + vecRange[lastIndex].Size != mBlockSize)
+		++lastIndex;
+
+	const auto addedSize = newBlockSize - mBlockSize;
+	mBlockSize = newBlockSize;
+	if (vecRange[lastIndex].Type == EAllocationType::Free)
+	{
+		removeFree(lastIndex);
+		vecRange[lastIndex].Size += addedSize;
+		insertFree(lastIndex);
+		return;
+	}
+
+	const auto rangeIndex = createRange();
+	auto& range = vecRange[rangeIndex];
+	range.Offset = newBlockSize - addedSize;
+	range.Size = addedSize;
+	range.PrevPhysical = lastIndex;
+	vecRange[lastIndex].NextPhysical = rangeIndex;
+	insertFree(rangeIndex);
+}
+
+uint32_t CTlsfBlockMetadata::findList(const uint64_t size)
+{
+	if (size < SECOND_LEVEL_COUNT)
+		return static_cast<uint32_t>(size);
+	const auto highestBit = findHighestBit(size);
+	const auto firstLevel = highestBit - SECOND_LEVEL_BITS + 1;
+	const auto secondLevel = static_cast<uint32_t>(size >> (highestBit - SECOND_LEVEL_BITS)) & (SECOND_LEVEL_COUNT - 1);
+	return firstLevel * SECOND_LEVEL_COUNT + secondLevel;
+}
+
+uint32_t CTlsfBlockMetadata::findFreeRange(const uint32_t firstList, const uint32_t lastList, const uint64_t size, const uint64_t alignment,
+										   const EAllocationType type, uint64_t& outOffset) const
+{
+	auto firstLevel = firstList / SECOND_LEVEL_COUNT;
+	uint64_t secondLevelMask = arrSecondLevelBitmap[firstLevel] & (~uint32_t(0) << (firstList % SECOND_LEVEL_COUNT));
+	while (true)
+	{
+		while (secondLevelMask != 0)
+		{
+			const auto list = firstLevel * SECOND_LEVEL_COUNT + findLowestBit(secondLevelMask);
+			if (list > lastList)
+				return NO_RANGE;
+			for (auto rangeIndex = arrFreeHead[list]; rangeIndex != NO_RANGE; rangeIndex = vecRange[rangeIndex].NextFree)
+			{
+				if (fits(vecRange[rangeIndex], size, alignment, type, outOffset))
+					return rangeIndex;
+			}
+			secondLevelMask &= secondLevelMask - 1;
+		}
+
+		if (firstLevel + 1 == FIRST_LEVEL_COUNT)
+			return NO_RANGE;
+		const auto firstLevelMask = firstLevelBitmap & (~uint64_t(0) << (firstLevel + 1));
+		if (firstLevelMask == 0)
+			return NO_RANGE;
+		firstLevel = findLowestBit(firstLevelMask);
+		secondLevelMask = arrSecondLevelBitmap[firstLevel];
+	}
+}
+
+bool CTlsfBlockMetadata::fits(const SRange& range, const uint64_t size, const uint64_t alignment, const EAllocationType type,
+							  uint64_t& outOffset) const
+{
+	auto offset = alignUp(range.Offset, alignment);
+	if (range.PrevPhysical != NO_RANGE)
+	{
+		const auto& prev = vecRange[range.PrevPhysical];
+		if (isOnSharedPage(prev.Offset + prev.Size, prev.Type, offset, type))
+			offset = alignUp(offset, mGranularity);
+	}
+	if (offset + size > range.Offset + range.Size)
+		return false;
+	if (range.NextPhysical != NO_RANGE)
+	{
+		const auto& next = vecRange[range.NextPhysical];
+		if (isOnSharedPage(offset + size, type, next.Offset, next.Type))
+			return false;
+	}
+	outOffset = offset;
+	return true;
+}
+
+void CTlsfBlockMetadata::insertFree(const uint32_t rangeIndex)
+{
+	const auto list = findList(vecRange[rangeIndex].Size);
+	const auto firstLevel = list / SECOND_LEVEL_COUNT;
+	const auto secondLevel = list % SECOND_LEVEL_COUNT;
+	auto& head = arrFreeHead[list];
+
+	auto& range = vecRange[rangeIndex];
+	range.PrevFree = NO_RANGE;
+	range.NextFree = head;
+	if (head != NO_RANGE)
+		vecRange[head].PrevFree = rangeIndex;
+	head = rangeIndex;
+
+	arrSecondLevelBitmap[firstLevel] |= 1u << secondLevel;
+	firstLevelBitmap |= uint64_t(1) << firstLevel;
+	++freeRangeCount;
+}
+
+void CTlsfBlockMetadata::removeFree(const uint32_t rangeIndex)
+{
+	const auto& range = vecRange[rangeIndex];
+	if (range.NextFree != NO_RANGE)
+		vecRange[range.NextFree].PrevFree = range.PrevFree;
+	if (range.PrevFree != NO_RANGE)
+	{
+		vecRange[range.PrevFree].NextFree = range.NextFree;
+	}
+	else
+	{
+		const auto list = findList(range.Size);
+		const auto firstLevel = list / SECOND_LEVEL_COUNT;
+		const auto secondLevel = list % SECOND_LEVEL_COUNT;
+		arrFreeHead[list] = range.NextFree;
+		if (range.NextFree == NO_RANGE)
+		{
+			arrSecondLevelBitmap[firstLevel] &= ~(1u << secondLevel);
+			if (arrSecondLevelBitmap[firstLevel] == 0)
+				firstLevelBitmap &= ~(uint64_t(1) << firstLevel);
+		}
+	}
+	--freeRangeCount;
+}
+
+uint32_t CTlsfBlockMetadata::splitFront(const uint32_t rangeIndex, const uint64_t size)
+{
+	const auto frontIndex = createRange();
+	auto& range = vecRange[rangeIndex];
+	auto& front = vecRange[frontIndex];
+	front.Offset = range.Offset;
+	front.Size = size;
+	front.PrevPhysical = range.PrevPhysical;
+	front.NextPhysical = rangeIndex;
+	if (range.PrevPhysical != NO_RANGE)
+		vecRange[range.PrevPhysical].NextPhysical = frontIndex;
+	range.PrevPhysical = frontIndex;
+	range.Offset += size;
+	range.Size -= size;
+	return frontIndex;
+}
+
+void CTlsfBlockMetadata::mergeIntoNext(const uint32_t rangeIndex)
+{
+	const auto& range = vecRange[rangeIndex];
+	auto& next = vecRange[range.NextPhysical];
+	next.Offset = range.Offset;
+	next.Size += range.Size;
+	next.PrevPhysical = range.PrevPhysical;
+	if (range.PrevPhysical != NO_RANGE)
+		vecRange[range.PrevPhysical].NextPhysical = range.NextPhysical;
+	vecRange[rangeIndex] = SRange();
+	vecUnusedRange.push_back(rangeIndex);
+}
+
+uint32_t CTlsfBlockMetadata::createRange()
+{
+	if (!vecUnusedRange.empty())
+	{
+		const auto rangeIndex = vecUnusedRange.back();
+		vecUnusedRange.pop_back();
+		return rangeIndex;
+	}
+	vecRange.emplace_back();
+	return static_cast<uint32_t>(vecRange.size() - 1);
+}
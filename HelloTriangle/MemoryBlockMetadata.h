@@ -0,0 +1,129 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+// What occupies a range of a memory block. Buffers and linear images may not share a
+// bufferImageGranularity page with optimal images
+enum class EAllocationType : uint8_t
+{
+	Free,
+	Linear,
+	Optimal
+};
+
+// A range handed out by a block, Handle is only meaningful to the block that returned it
+struct SBlockAllocation
+{
+	uint64_t Offset = 0;
+	uint64_t Size = 0;
+	uint32_t Handle = 0;
+};
+
+// Bookkeeping of the ranges in use inside one device memory block. Knows nothing about Vulkan,
+// so the strategies can be exercised on the CPU without a device
+class IBlockMetadata
+{
+public:
+	IBlockMetadata(const uint64_t blockSize, const uint64_t granularity) : mBlockSize(blockSize), mGranularity(granularity) {}
+
+	virtual ~IBlockMetadata() = default;
+	IBlockMetadata(const IBlockMetadata&) = delete;
+	IBlockMetadata(IBlockMetadata&&) = delete;
+	IBlockMetadata& operator=(const IBlockMetadata&) = delete;
+	IBlockMetadata& operator=(IBlockMetadata&&) = delete;
+
+	// Alignment must be a power of two. Returns false when no free range fits
+	virtual bool Allocate(uint64_t size, uint64_t alignment, EAllocationType type, SBlockAllocation& outAllocation) = 0;
+	virtual void Free(const SBlockAllocation& allocation) = 0;
+
+	[[nodiscard]] bool IsEmpty() const { return mAllocationCount == 0; }
+	[[nodiscard]] uint64_t GetBlockSize() const { return mBlockSize; }
+	[[nodiscard]] uint64_t GetUsedSize() const { return mUsedSize; }
+	[[nodiscard]] uint32_t GetAllocationCount() const { return mAllocationCount; }
+
+protected:
+	// Whether a resource of type b starting at bOffset must move to the next page because
+	// a resource of type a ends at aEnd
+	[[nodiscard]] bool isOnSharedPage(uint64_t aEnd, EAllocationType a, uint64_t bOffset, EAllocationType b) const;
+
+	uint64_t mBlockSize;
+	// bufferImageGranularity, a power of two
+	uint64_t mGranularity;
+	uint64_t mUsedSize = 0;
+	uint32_t mAllocationCount = 0;
+};
+
+// Bump allocator, memory is only reclaimed once everything in the block has been freed.
+// Suits short-lived resources that are released together, like staging buffers
+class CLinearBlockMetadata final : public IBlockMetadata
+{
+public:
+	using IBlockMetadata::IBlockMetadata;
+
+	bool Allocate(uint64_t size, uint64_t alignment, EAllocationType type, SBlockAllocation& outAllocation) override;
+	void Free(const SBlockAllocation& allocation) override;
+
+private:
+	uint64_t nextOffset = 0;
+	EAllocationType lastType = EAllocationType::Free;
+};
+
+// Two-level segregated fit: free ranges are binned by the power of two of their size and then
+// 16 linear subdivisions of it, with a bitmap per level so finding a big enough range is a couple
+// of bit scans. Neighbouring free ranges are merged as soon as one is freed
+class CTlsfBlockMetadata final : public IBlockMetadata
+{
+public:
+	CTlsfBlockMetadata(uint64_t blockSize, uint64_t granularity);
+
+	bool Allocate(uint64_t size, uint64_t alignment, EAllocationType type, SBlockAllocation& outAllocation) override;
+	void Free(const SBlockAllocation& allocation) override;
+
+	// Extends the managed range to newBlockSize, the added space joins the last range if it's free
+	void Grow(uint64_t newBlockSize);
+
+	[[nodiscard]] uint32_t GetFreeRangeCount() const { return freeRangeCount; }
+
+private:
+	static constexpr uint32_t SECOND_LEVEL_BITS = 4;
+	static constexpr uint32_t SECOND_LEVEL_COUNT = 1 << SECOND_LEVEL_BITS;
+	// Sizes below SECOND_LEVEL_COUNT share the first level, every bit above it gets one
+	static constexpr uint32_t FIRST_LEVEL_COUNT = 64 - SECOND_LEVEL_BITS + 1;
+	static constexpr uint32_t LIST_COUNT = FIRST_LEVEL_COUNT * SECOND_LEVEL_COUNT;
+	static constexpr uint32_t NO_RANGE = UINT32_MAX;
+
+	// A used or free range, linked to its neighbours in the block and to the others in its free list
+	struct SRange
+	{
+		uint64_t Offset = 0;
+		uint64_t Size = 0;
+		uint32_t PrevPhysical = NO_RANGE;
+		uint32_t NextPhysical = NO_RANGE;
+		uint32_t PrevFree = NO_RANGE;
+		uint32_t NextFree = NO_RANGE;
+		EAllocationType Type = EAllocationType::Free;
+	};
+
+	// Free lists are numbered in order of size, so a range of lists is a range of sizes
+	[[nodiscard]] static uint32_t findList(uint64_t size);
+	// The first range in lists firstList to lastList that fits, or NO_RANGE
+	[[nodiscard]] uint32_t findFreeRange(uint32_t firstList, uint32_t lastList, uint64_t size, uint64_t alignment,
+										 EAllocationType type, uint64_t& outOffset) const;
+	[[nodiscard]] bool fits(const SRange& range, uint64_t size, uint64_t alignment, EAllocationType type, uint64_t& outOffset) const;
+	void insertFree(uint32_t rangeIndex);
+	void removeFree(uint32_t rangeIndex);
+	// Splits size bytes off the front of a range, the new range is returned and comes first in the block
+	uint32_t splitFront(uint32_t rangeIndex, uint64_t size);
+	// Merges a range into the one that follows it and releases its slot
+	void mergeIntoNext(uint32_t rangeIndex);
+	uint32_t createRange();
+
+	std::vector<SRange> vecRange;
+	std::vector<uint32_t> vecUnusedRange;
+	std::array<uint32_t, LIST_COUNT> arrFreeHead;
+	std::array<uint32_t, FIRST_LEVEL_COUNT> arrSecondLevelBitmap{};
+	uint64_t firstLevelBitmap = 0;
+	uint32_t freeRangeCount = 0;
+};
@@ -0,0 +1,135 @@
+#include "MeshCache.h"
+#include "CommonStructs.h"
+#include "MappedFile.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+namespace
+{
+	constexpr uint32_t MESH_CACHE_MAGIC = 0x4853454D; // "MESH"
+	// Version 2 stores the index buffer in optimized triangle order, version 3 adds the levels of detail,
+	// version 4 fills in the normals
+	constexpr uint32_t MESH_CACHE_VERSION = 4;
+	// Covers optimalBufferCopyOffsetAlignment and nonCoherentAtomSize on the hardware we target
+	constexpr uint64_t MESH_CACHE_ALIGNMENT = 256;
+
+	struct SMeshCacheHeader
+	{
+		uint32_t Magic;
+		uint32_t Version;
+		// Source OBJ size and write time, the cache is stale if either changed
+		uint64_t SourceSize;
+		int64_t SourceWriteTime;
+		uint32_t VertexStride;
+		uint32_t VertexCount;
+		uint32_t IndexCount;
+		uint32_t LodCount;
+		float CreaseAngle;
+		uint64_t VertexOffset;
+		uint64_t IndexOffset;
+		uint64_t LodOffset;
+	};
+
+	uint64_t alignOffset(const uint64_t offset)
+	{
+		return (offset + MESH_CACHE_ALIGNMENT - 1) & ~(MESH_CACHE_ALIGNMENT - 1);
+	}
+
+	bool getSourceStamp(const std::string& sourceFilename, uint64_t& outSize, int64_t& outWriteTime)
+	{
+		std::error_code errorCode;
+		outSize = std::filesystem::file_size(sourceFilename, errorCode);
+		if (errorCode)
+			return false;
+		const auto writeTime = std::filesystem::last_write_time(sourceFilename, errorCode);
+		if (errorCode)
+			return false;
+		outWriteTime = static_cast<int64_t>(writeTime.time_since_epoch().count());
+		return true;
+	}
+}
+
+bool CMeshCache::Load(const std::string& sourceFilename, const float creaseAngle, SModelInformation& modelInfo)
+{
+	uint64_t sourceSize;
+	int64_t sourceWriteTime;
+	if (!getSourceStamp(sourceFilename, sourceSize, sourceWriteTime))
+		return false;
+
+	auto mappedFile = std::make_shared<CMappedFile>(GetCacheFilename(sourceFilename).c_str());
+	if (!mappedFile->IsOpen() || mappedFile->GetSize() < sizeof(SMeshCacheHeader))
+		return false;
+
+	SMeshCacheHeader header;
+	std::memcpy(&header, mappedFile->GetData(), sizeof(header));
+
+	if (header.Magic != MESH_CACHE_MAGIC ||
+		header.Version != MESH_CACHE_VERSION ||
+		header.VertexStride != sizeof(SVertex) ||
+		header.SourceSize != sourceSize ||
+		header.SourceWriteTime != sourceWriteTime ||
+		header.CreaseAngle != creaseAngle)
+	{
+		return false;
+	}
+
+	// Also catches a cache file that was cut short while being written
+	if (header.VertexOffset + uint64_t(header.VertexCount) * sizeof(SVertex) > mappedFile->GetSize() ||
+		header.IndexOffset + uint64_t(header.IndexCount) * sizeof(uint32_t) > mappedFile->GetSize() ||
+		header.LodOffset + uint64_t(header.LodCount) * sizeof(SLodLevel) > mappedFile->GetSize() ||
+		header.LodCount == 0)
+	{
+		return false;
+	}
+
+	// The table is tiny, copy it rather than keep pointing into the mapping
+	const auto pLod = reinterpret_cast<const SLodLevel*>(mappedFile->GetData() + header.LodOffset);
+	modelInfo.VecLod.assign(pLod, pLod + header.LodCount);
+
+	modelInfo.pMappedVertex = reinterpret_cast<const SVertex*>(mappedFile->GetData() + header.VertexOffset);
+	modelInfo.pMappedIndex = reinterpret_cast<const uint32_t*>(mappedFile->GetData() + header.IndexOffset);
+	modelInfo.VertexCount = header.VertexCount;
+	modelInfo.IndexCount = header.IndexCount;
+	modelInfo.MappedCache = std::move(mappedFile);
+	return true;
+}
+
+void CMeshCache::Store(const std::string& sourceFilename, const float creaseAngle, const SModelInformation& modelInfo)
+{
+	SMeshCacheHeader header = {};
+	header.Magic = MESH_CACHE_MAGIC;
+	header.Version = MESH_CACHE_VERSION;
+	if (!getSourceStamp(sourceFilename, header.SourceSize, header.SourceWriteTime))
+		return;
+	header.VertexStride = sizeof(SVertex);
+	header.CreaseAngle = creaseAngle;
+	header.VertexCount = static_cast<uint32_t>(modelInfo.VecVertex.size());
+	header.IndexCount = static_cast<uint32_t>(modelInfo.VecIndex.size());
+	header.VertexOffset = alignOffset(sizeof(SMeshCacheHeader));
+	header.IndexOffset = alignOffset(header.VertexOffset + uint64_t(header.VertexCount) * sizeof(SVertex));
+	header.LodCount = static_cast<uint32_t>(modelInfo.VecLod.size());
+	header.LodOffset = alignOffset(header.IndexOffset + uint64_t(header.IndexCount) * sizeof(uint32_t));
+
+	std::ofstream writeStream(GetCacheFilename(sourceFilename), std::ios::binary | std::ios::trunc);
+	if (!writeStream.is_open())
+	{
+		std::cout << "Failed to write the mesh cache for " << sourceFilename << std::endl;
+		return;
+	}
+
+	const char padding[MESH_CACHE_ALIGNMENT] = {};
+	writeStream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	writeStream.write(padding, header.VertexOffset - sizeof(header));
+	writeStream.write(reinterpret_cast<const char*>(modelInfo.VecVertex.data()), header.VertexCount * sizeof(SVertex));
+	writeStream.write(padding, header.IndexOffset - (header.VertexOffset + header.VertexCount * sizeof(SVertex)));
+	writeStream.write(reinterpret_cast<const char*>(modelInfo.VecIndex.data()), header.IndexCount * sizeof(uint32_t));
+	writeStream.write(padding, header.LodOffset - (header.IndexOffset + header.IndexCount * sizeof(uint32_t)));
+	writeStream.write(reinterpret_cast<const char*>(modelInfo.VecLod.data()), header.LodCount * sizeof(SLodLevel));
+}
+
+std::string CMeshCache::GetCacheFilename(const std::string& sourceFilename)
+{
+	return sourceFilename + ".meshcache";
+}
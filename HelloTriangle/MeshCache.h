@@ -0,0 +1,19 @@
+#pragma once
+
+#include <string>
+
+struct SModelInformation;
+
+// Binary copy of a loaded OBJ stored next to it as <obj>.meshcache.
+// Layout: SMeshCacheHeader, then the SVertex and index arrays, each aligned to
+// MESH_CACHE_ALIGNMENT so they can be copied straight into a staging buffer
+class CMeshCache
+{
+public:
+	// Maps the cache file if it is still valid for the source OBJ and points modelInfo at its arrays.
+	// Generated normals depend on the crease angle, a cache built with a different one is stale
+	static bool Load(const std::string& sourceFilename, float creaseAngle, SModelInformation& modelInfo);
+	static void Store(const std::string& sourceFilename, float creaseAngle, const SModelInformation& modelInfo);
+
+	static std::string GetCacheFilename(const std::string& sourceFilename);
+};
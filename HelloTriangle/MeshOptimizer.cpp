@@ -0,0 +1,250 @@
+#include "MeshOptimizer.h"
+#include "Common.h"
+
+namespace
+{
+	constexpr uint32_t NO_VERTEX = UINT32_MAX;
+}
+
+void CMeshOptimizer::Optimize(std::vector<SVertex>& vecVertex, std::vector<uint32_t>& vecIndex)
+{
+	if (vecIndex.empty())
+		return;
+
+	OptimizeTriangleOrder(vecVertex, vecIndex);
+	optimizeVertexFetch(vecVertex, vecIndex);
+}
+
+void CMeshOptimizer::OptimizeTriangleOrder(const std::vector<SVertex>& vecVertex, std::vector<uint32_t>& vecIndex)
+{
+	if (vecIndex.empty())
+		return;
+
+	const auto vecClusterStart = optimizeVertexCache(vecIndex, vecVertex.size());
+	optimizeOverdraw(vecVertex, vecIndex, vecClusterStart);
+}
+
+SVertexCacheStatistics CMeshOptimizer::AnalyzeVertexCache(const std::vector<uint32_t>& vecIndex, const size_t vertexCount,
+														  const uint32_t cacheSize)
+{
+	// A vertex is in the FIFO if fewer than cacheSize vertices were pushed after it
+	std::vector<uint32_t> vecCacheTime(vertexCount, 0);
+	auto time = cacheSize + 1;
+	size_t transformCount = 0;
+	size_t uniqueCount = 0;
+	for (const auto index : vecIndex)
+	{
+		if (vecCacheTime[index] == 0)
+			++uniqueCount;
+		if (time - vecCacheTime[index] > cacheSize)
+		{
+			vecCacheTime[index] = time++;
+			++transformCount;
+		}
+	}
+
+	SVertexCacheStatistics statistics;
+	if (!vecIndex.empty())
+	{
+		statistics.ACMR = static_cast<float>(transformCount) / static_cast<float>(vecIndex.size() / 3);
+		statistics.ATVR = static_cast<float>(transformCount) / static_cast<float>(uniqueCount);
+	}
+	return statistics;
+}
+
+// Tipsify, from Sander, Nehab and Barczak, "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw".
+// Emits all triangles around a fanning vertex, then moves to the adjacent vertex that will still be in the cache
+std::vector<uint32_t> CMeshOptimizer::optimizeVertexCache(std::vector<uint32_t>& vecIndex, const size_t vertexCount)
+{
+	const auto triangleCount = vecIndex.size() / 3;
+
+	// Vertex to triangle adjacency, stored as compressed rows
+	std::vector<uint32_t> vecLiveCount(vertexCount, 0);
+	for (const auto index : vecIndex)
+	{
+		++vecLiveCount[index];
+	}
+	std::vector<uint32_t> vecAdjacencyStart(vertexCount + 1, 0);
+	for (size_t vertex = 0; vertex != vertexCount; ++vertex)
+	{
+		vecAdjacencyStart[vertex + 1] = vecAdjacencyStart[vertex] + vecLiveCount[vertex];
+	}
+	std::vector<uint32_t> vecAdjacency(vecIndex.size());
+	{
+		std::vector<uint32_t> vecFill(vecAdjacencyStart.begin(), vecAdjacencyStart.end() - 1);
+		for (size_t corner = 0; corner != triangleCount * 3; ++corner)
+		{
+			vecAdjacency[vecFill[vecIndex[corner]]++] = static_cast<uint32_t>(corner / 3);
+		}
+	}
+
+	std::vector<uint32_t> vecCacheTime(vertexCount, 0);
+	std::vector<bool> vecEmitted(triangleCount, false);
+	std::vector<uint32_t> vecDeadEnd;
+	vecDeadEnd.reserve(vecIndex.size());
+	std::vector<uint32_t> vecCandidate;
+	std::vector<uint32_t> vecOutIndex;
+	vecOutIndex.reserve(triangleCount * 3);
+	std::vector<uint32_t> vecClusterStart;
+
+	auto time = VERTEX_CACHE_SIZE + 1;
+	size_t cursor = 0;
+
+	// Falls back to recently used vertices first, then scans the input for anything left
+	const auto skipDeadEnd = [&]()
+	{
+		while (!vecDeadEnd.empty())
+		{
+			const auto vertex = vecDeadEnd.back();
+			vecDeadEnd.pop_back();
+			if (vecLiveCount[vertex] != 0)
+				return vertex;
+		}
+		for (; cursor != vertexCount; ++cursor)
+		{
+			if (vecLiveCount[cursor] != 0)
+				return static_cast<uint32_t>(cursor);
+		}
+		return NO_VERTEX;
+	};
+
+	auto fanVertex = skipDeadEnd();
+	auto isNewCluster = true;
+	while (fanVertex != NO_VERTEX)
+	{
+		if (isNewCluster)
+			vecClusterStart.push_back(static_cast<uint32_t>(vecOutIndex.size()));
+
+		vecCandidate.clear();
+		for (auto adjacency = vecAdjacencyStart[fanVertex]; adjacency != vecAdjacencyStart[fanVertex + 1]; ++adjacency)
+		{
+			const auto triangle = vecAdjacency[adjacency];
+			if (vecEmitted[triangle])
+				continue;
+
+			for (uint32_t corner = 0; corner != 3; ++corner)
+			{
+				const auto vertex = vecIndex[triangle * 3 + corner];
+				vecOutIndex.push_back(vertex);
+				vecDeadEnd.push_back(vertex);
+				vecCandidate.push_back(vertex);
+				--vecLiveCount[vertex];
+				if (time - vecCacheTime[vertex] > VERTEX_CACHE_SIZE)
+					vecCacheTime[vertex] = time++;
+			}
+			vecEmitted[triangle] = true;
+		}
+
+		// Prefer the oldest candidate that stays in the cache while its remaining triangles are emitted
+		fanVertex = NO_VERTEX;
+		int64_t bestPriority = -1;
+		for (const auto vertex : vecCandidate)
+		{
+			if (vecLiveCount[vertex] == 0)
+				continue;
+
+			int64_t priority = 0;
+			if (time - vecCacheTime[vertex] + 2 * vecLiveCount[vertex] <= VERTEX_CACHE_SIZE)
+				priority = time - vecCacheTime[vertex];
+			if (priority > bestPriority)
+			{
+				bestPriority = priority;
+				fanVertex = vertex;
+			}
+		}
+
+		// Jumping elsewhere in the mesh mostly flushes the cache, so reordering clusters there is cheap
+		isNewCluster = fanVertex == NO_VERTEX;
+		if (isNewCluster)
+			fanVertex = skipDeadEnd();
+	}
+
+	vecIndex.swap(vecOutIndex);
+	return vecClusterStart;
+}
+
+// Draws the clusters facing away from the mesh centre first, they are the most likely to occlude the rest
+void CMeshOptimizer::optimizeOverdraw(const std::vector<SVertex>& vecVertex, std::vector<uint32_t>& vecIndex,
+									  const std::vector<uint32_t>& vecClusterStart)
+{
+	const auto clusterCount = vecClusterStart.size();
+	if (clusterCount < 2)
+		return;
+
+	std::vector<glm::vec3> vecClusterNormal(clusterCount, glm::vec3(0.0f));
+	std::vector<glm::vec3> vecClusterCentroid(clusterCount, glm::vec3(0.0f));
+	std::vector<float> vecClusterArea(clusterCount, 0.0f);
+	auto meshCentroid = glm::vec3(0.0f);
+	auto meshArea = 0.0f;
+
+	for (size_t cluster = 0; cluster != clusterCount; ++cluster)
+	{
+		const auto end = cluster + 1 != clusterCount ? vecClusterStart[cluster + 1] : vecIndex.size();
+		for (size_t corner = vecClusterStart[cluster]; corner != end; corner += 3)
+		{
+			const auto& position0 = vecVertex[vecIndex[corner + 0]].Position;
+			const auto& position1 = vecVertex[vecIndex[corner + 1]].Position;
+			const auto& position2 = vecVertex[vecIndex[corner + 2]].Position;
+			const auto normal = glm::cross(position1 - position0, position2 - position0);
+			const auto area = glm::length(normal) * 0.5f;
+			const auto centroid = (position0 + position1 + position2) / 3.0f;
+
+			vecClusterNormal[cluster] += normal;
+			vecClusterCentroid[cluster] += centroid * area;
+			vecClusterArea[cluster] += area;
+		}
+		meshCentroid += vecClusterCentroid[cluster];
+		meshArea += vecClusterArea[cluster];
+	}
+	if (meshArea > 0.0f)
+		meshCentroid /= meshArea;
+
+	std::vector<float> vecSortKey(clusterCount, 0.0f);
+	for (size_t cluster = 0; cluster != clusterCount; ++cluster)
+	{
+		const auto normalLength = glm::length(vecClusterNormal[cluster]);
+		if (vecClusterArea[cluster] > 0.0f && normalLength > 0.0f)
+		{
+			const auto centroid = vecClusterCentroid[cluster] / vecClusterArea[cluster];
+			vecSortKey[cluster] = glm::dot(centroid - meshCentroid, vecClusterNormal[cluster] / normalLength);
+		}
+	}
+
+	std::vector<uint32_t> vecClusterOrder(clusterCount);
+	for (size_t cluster = 0; cluster != clusterCount; ++cluster)
+	{
+		vecClusterOrder[cluster] = static_cast<uint32_t>(cluster);
+	}
+	std::stable_sort(vecClusterOrder.begin(), vecClusterOrder.end(), [&vecSortKey](const uint32_t a, const uint32_t b)
+	{
+		return vecSortKey[a] > vecSortKey[b];
+	});
+
+	std::vector<uint32_t> vecOutIndex;
+	vecOutIndex.reserve(vecIndex.size());
+	for (const auto cluster : vecClusterOrder)
+	{
+		const auto end = cluster + 1 != clusterCount ? vecClusterStart[cluster + 1] : vecIndex.size();
+		vecOutIndex.insert(vecOutIndex.end(), vecIndex.begin() + vecClusterStart[cluster], vecIndex.begin() + end);
+	}
+	vecIndex.swap(vecOutIndex);
+}
+
+// Renumbers the vertices in the order the index buffer first reaches them so fetches walk memory linearly
+void CMeshOptimizer::optimizeVertexFetch(std::vector<SVertex>& vecVertex, std::vector<uint32_t>& vecIndex)
+{
+	std::vector<uint32_t> vecRemap(vecVertex.size(), NO_VERTEX);
+	std::vector<SVertex> vecOutVertex;
+	vecOutVertex.reserve(vecVertex.size());
+	for (auto& index : vecIndex)
+	{
+		auto& remapped = vecRemap[index];
+		if (remapped == NO_VERTEX)
+		{
+			remapped = static_cast<uint32_t>(vecOutVertex.size());
+			vecOutVertex.push_back(vecVertex[index]);
+		}
+		index = remapped;
+	}
+	vecVertex.swap(vecOutVertex);
+}
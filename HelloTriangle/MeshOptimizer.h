@@ -0,0 +1,37 @@
+#pragma once
+#include "CommonStructs.h"
+
+#include <vector>
+
+struct SVertexCacheStatistics
+{
+	// Average cache miss ratio, transformed vertices per triangle. 0.5 is the lower bound
+	float ACMR = 0.0f;
+	// Average transform to vertex ratio, transformed vertices per unique vertex. 1.0 is the lower bound
+	float ATVR = 0.0f;
+};
+
+// Reorders indexed triangle lists for the post-transform vertex cache, overdraw and vertex fetch
+class CMeshOptimizer
+{
+public:
+	// Size of the FIFO cache used by Tipsify and by AnalyzeVertexCache
+	static constexpr uint32_t VERTEX_CACHE_SIZE = 16;
+
+	// Tipsify triangle order, clusters sorted to reduce overdraw, then vertices renumbered in
+	// order of first use. Unreferenced vertices are dropped
+	static void Optimize(std::vector<SVertex>& vecVertex, std::vector<uint32_t>& vecIndex);
+	// Only the triangle order, for index buffers that have to keep indexing an existing vertex array
+	static void OptimizeTriangleOrder(const std::vector<SVertex>& vecVertex, std::vector<uint32_t>& vecIndex);
+
+	// Simulates a FIFO post-transform cache over the index buffer
+	[[nodiscard]] static SVertexCacheStatistics AnalyzeVertexCache(const std::vector<uint32_t>& vecIndex, size_t vertexCount,
+																   uint32_t cacheSize = VERTEX_CACHE_SIZE);
+
+private:
+	// Returns the offset into the new index buffer where every cluster starts
+	static std::vector<uint32_t> optimizeVertexCache(std::vector<uint32_t>& vecIndex, size_t vertexCount);
+	static void optimizeOverdraw(const std::vector<SVertex>& vecVertex, std::vector<uint32_t>& vecIndex,
+								 const std::vector<uint32_t>& vecClusterStart);
+	static void optimizeVertexFetch(std::vector<SVertex>& vecVertex, std::vector<uint32_t>& vecIndex);
+};
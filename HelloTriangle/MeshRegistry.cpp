@@ -0,0 +1,278 @@
+#include "MeshRegistry.h"
+#include "ModelLoader.h"
+
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+
+ModelInformationSPtr CMeshRegistry::AcquireAsync(const SObjectInformation& objectInformation)
+{
+	const auto key = makeKey(objectInformation);
+	const auto iter = mapMesh.find(key);
+	if (iter != mapMesh.end())
+	{
+		return iter->second;
+	}
+
+	auto modelInfo = std::make_shared<SModelInformation>();
+	// The worker only touches this SModelInformation until the future is ready
+	auto parse = pThreadPool->Submit([objectInformation, modelInfo]()
+	{
+		CModelLoader::LoadModel(objectInformation, *modelInfo);
+	});
+	vecPendingLoad.push_back({ key, objectInformation.FileName, modelInfo, std::move(parse) });
+
+	mapMesh.emplace(key, modelInfo);
+	return modelInfo;
+}
+
+void CMeshRegistry::ProcessPendingLoads(const VkDevice& device, CDeviceMemoryAllocator& allocator, CStagingRing& stagingRing,
+										const SUploadQueues& uploadQueues)
+{
+	// Retired first so that the staging space they hold can be used below
+	for (auto iter = vecUploadInFlight.begin(); iter != vecUploadInFlight.end();)
+	{
+		if (!iter->IsAcquireSubmitted)
+		{
+			if (!iter->TransferBatch.IsComplete())
+			{
+				++iter;
+				continue;
+			}
+			iter->TransferBatch.Finish();
+			// Its semaphore has been signaled already. Draws submitted after it come after its barriers
+			iter->AcquireBatch.Submit();
+			iter->IsAcquireSubmitted = true;
+			for (auto& modelInfo : iter->vecModelInfo)
+			{
+				modelInfo->IsResident = true;
+			}
+			++residencyVersion;
+		}
+
+		if (iter->AcquireBatch.IsComplete())
+		{
+			iter->AcquireBatch.Finish();
+			iter = vecUploadInFlight.erase(iter);
+		}
+		else
+		{
+			++iter;
+		}
+	}
+
+	SUploadInFlight uploadInFlight;
+	uploadInFlight.TransferBatch.Begin(device, uploadQueues.TransferQueue, uploadQueues.TransferCommandPool);
+	uploadInFlight.AcquireBatch.Begin(device, uploadQueues.GraphicsQueue, uploadQueues.GraphicsCommandPool);
+	std::vector<SStagingRegion> vecRegion;
+	for (auto iter = vecPendingLoad.begin(); iter != vecPendingLoad.end();)
+	{
+		if (iter->Parse.valid() && iter->Parse.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+		{
+			try
+			{
+				// Rethrows anything the loader threw on the worker
+				iter->Parse.get();
+			}
+			catch (const std::exception& e)
+			{
+				dropFailedLoad(*iter, e);
+				iter = vecPendingLoad.erase(iter);
+				continue;
+			}
+		}
+		if (iter->Parse.valid())
+		{
+			++iter;
+			continue;
+		}
+
+		// Parsed, possibly on an earlier call when the ring was full then
+		SStagingRegion region;
+		if (!uploadInFlight.TransferBatch.TryAllocateStaging(stagingRing, CBufferManager::GetModelUploadSize(*iter->ModelInfo), region))
+		{
+			if (!iter->IsDeferred)
+			{
+				iter->IsDeferred = true;
+				++deferredUploadCount;
+			}
+			++iter;
+			continue;
+		}
+		try
+		{
+			allocateGeometry(device, allocator, uploadQueues, *iter->ModelInfo);
+		}
+		catch (const std::exception& e)
+		{
+			// Nothing gets recorded into the region
+			stagingRing.Release(region);
+			dropFailedLoad(*iter, e);
+			iter = vecPendingLoad.erase(iter);
+			continue;
+		}
+		uploadInFlight.vecModelInfo.push_back(std::move(iter->ModelInfo));
+		vecRegion.push_back(region);
+		iter = vecPendingLoad.erase(iter);
+	}
+	if (uploadInFlight.vecModelInfo.empty())
+		return;
+
+	// Recorded once every arena has its final buffers, a growing arena replaces them. The transfer family
+	// never takes ownership of the arena buffers, it overwrites whole ranges whose old contents don't matter
+	for (size_t i = 0; i < vecRegion.size(); ++i)
+	{
+		auto& modelInfo = *uploadInFlight.vecModelInfo[i];
+		CBufferManager::RecordModelUpload(uploadInFlight.TransferBatch, vecRegion[i], modelInfo);
+		CBufferManager::RecordModelHandoff(uploadInFlight.TransferBatch, uploadInFlight.AcquireBatch,
+										   uploadQueues.TransferFamily, uploadQueues.GraphicsFamily, modelInfo);
+		// The geometry has been copied into the staging region
+		modelInfo.ReleaseGeometryData();
+	}
+	// Every mesh that finished parsing since the last call goes in one submission
+	if (uploadQueues.HasDedicatedTransfer())
+	{
+		VkSemaphore transferDone;
+		uploadInFlight.TransferBatch.Submit(&transferDone);
+		uploadInFlight.AcquireBatch.AddWaitSemaphore(transferDone, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
+	}
+	else
+	{
+		uploadInFlight.TransferBatch.Submit();
+	}
+	vecUploadInFlight.push_back(std::move(uploadInFlight));
+}
+
+void CMeshRegistry::ReleaseUnused()
+{
+	for (auto iter = mapMesh.begin(); iter != mapMesh.end();)
+	{
+		// The registry's own reference is the only one left, pending loads and uploads hold a second one
+		if (iter->second.use_count() == 1)
+		{
+			destroyMesh(*iter->second);
+			iter = mapMesh.erase(iter);
+		}
+		else
+		{
+			++iter;
+		}
+	}
+}
+
+void CMeshRegistry::Cleanup(CDeviceMemoryAllocator& allocator)
+{
+	for (auto& uploadInFlight : vecUploadInFlight)
+	{
+		uploadInFlight.TransferBatch.Wait();
+		uploadInFlight.TransferBatch.Finish();
+		// Never submitted when the transfer had not been seen to complete, its semaphore is simply destroyed then
+		uploadInFlight.AcquireBatch.Wait();
+		uploadInFlight.AcquireBatch.Finish();
+	}
+	vecUploadInFlight.clear();
+
+	for (auto& pendingLoad : vecPendingLoad)
+	{
+		if (pendingLoad.Parse.valid())
+		{
+			// Let the worker finish with the SModelInformation, its result is not needed
+			pendingLoad.Parse.wait();
+		}
+	}
+	vecPendingLoad.clear();
+
+	for (auto& [fileName, modelInfo] : mapMesh)
+	{
+		destroyMesh(*modelInfo);
+	}
+	mapMesh.clear();
+
+	for (auto& pGeometryArena : arrGeometryArena)
+	{
+		if (pGeometryArena)
+			pGeometryArena->Cleanup(allocator);
+		pGeometryArena.reset();
+	}
+}
+
+void CMeshRegistry::dropFailedLoad(const SPendingLoad& pendingLoad, const std::exception& e)
+{
+	std::cout << pendingLoad.FileName << ": " << e.what() << std::endl;
+	// The game objects keep it until they acquire the file again
+	pendingLoad.ModelInfo->ReleaseGeometryData();
+	pendingLoad.ModelInfo->IsFailed = true;
+	const auto meshIter = mapMesh.find(pendingLoad.Key);
+	if (meshIter != mapMesh.end() && meshIter->second == pendingLoad.ModelInfo)
+		mapMesh.erase(meshIter);
+}
+
+std::string CMeshRegistry::makeKey(const SObjectInformation& objectInformation)
+{
+	// A file name can't contain a null character and the settings have a fixed size, so the key is unambiguous
+	std::string key = objectInformation.FileName;
+	key += '\0';
+	key += static_cast<char>(objectInformation.VertexFormat);
+	key += objectInformation.BuildMeshlets ? '1' : '0';
+	char creaseAngle[sizeof(float)];
+	std::memcpy(creaseAngle, &objectInformation.CreaseAngle, sizeof(float));
+	key.append(creaseAngle, sizeof(float));
+	return key;
+}
+
+void CMeshRegistry::allocateGeometry(const VkDevice& device, CDeviceMemoryAllocator& allocator, const SUploadQueues& uploadQueues,
+									 SModelInformation& modelInfo)
+{
+	const auto arenaIndex = static_cast<size_t>(modelInfo.VertexFormat) * 2 + (modelInfo.IndexType == VK_INDEX_TYPE_UINT16 ? 1 : 0);
+	auto& pGeometryArena = arrGeometryArena[arenaIndex];
+	if (!pGeometryArena)
+	{
+		pGeometryArena = std::make_unique<CGeometryArena>(static_cast<uint32_t>(modelInfo.GetVertexStride()), modelInfo.IndexType);
+	}
+
+	if (!pGeometryArena->TryAllocate(modelInfo.VertexCount, modelInfo.IndexCount, modelInfo.GeometryRange))
+	{
+		// The uploads in flight target the buffers about to be replaced, and the copy into the new ones has to
+		// see what they wrote on the graphics family, which owns the buffers
+		drainUploads();
+		pGeometryArena->Grow(device, allocator, uploadQueues.GraphicsQueue, uploadQueues.GraphicsCommandPool,
+							 modelInfo.VertexCount, modelInfo.IndexCount);
+		if (!pGeometryArena->TryAllocate(modelInfo.VertexCount, modelInfo.IndexCount, modelInfo.GeometryRange))
+		{
+			throw std::runtime_error("The geometry arena has no room after growing.");
+		}
+	}
+	// Only once it holds a range, destroyMesh frees it
+	modelInfo.pGeometryArena = pGeometryArena.get();
+}
+
+void CMeshRegistry::drainUploads()
+{
+	for (auto& uploadInFlight : vecUploadInFlight)
+	{
+		if (!uploadInFlight.IsAcquireSubmitted)
+		{
+			uploadInFlight.TransferBatch.Wait();
+			uploadInFlight.TransferBatch.Finish();
+			uploadInFlight.AcquireBatch.Submit();
+			for (auto& modelInfo : uploadInFlight.vecModelInfo)
+			{
+				modelInfo->IsResident = true;
+			}
+			++residencyVersion;
+		}
+		uploadInFlight.AcquireBatch.Wait();
+		uploadInFlight.AcquireBatch.Finish();
+	}
+	vecUploadInFlight.clear();
+}
+
+void CMeshRegistry::destroyMesh(SModelInformation& modelInfo)
+{
+	// Meshes still parsing when the registry is cleaned up never got a range
+	if (modelInfo.pGeometryArena != nullptr)
+	{
+		modelInfo.pGeometryArena->Free(modelInfo.GeometryRange);
+		modelInfo.pGeometryArena = nullptr;
+	}
+}
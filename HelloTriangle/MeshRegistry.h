@@ -0,0 +1,91 @@
+#pragma once
+#include "BufferManager.h"
+#include "CommonStructs.h"
+#include "GeometryArena.h"
+#include "ThreadPool.h"
+#include "UploadBatch.h"
+#include "TypeAliases.h"
+
+#include <array>
+#include <future>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Owns the meshes used by the scene, keyed by filename and mesh settings. Every game object
+// that references the same file with the same settings shares one SModelInformation. The geometry
+// of every mesh lives in one of a few geometry arenas, one per vertex format and index type
+class CMeshRegistry
+{
+public:
+	// Files are parsed on the thread pool's workers, it must outlive the registry
+	explicit CMeshRegistry(CThreadPool& threadPool) : pThreadPool(&threadPool) {}
+
+	// Returns straight away and parses the file on a worker thread. The mesh
+	// is not resident until ProcessPendingLoads has seen its upload complete
+	[[nodiscard]] ModelInformationSPtr AcquireAsync(const SObjectInformation& objectInformation);
+	// Retires the finished uploads and starts those of the parsed meshes, all of them in one submission on
+	// the transfer queue. Uploads that find the staging ring full wait for a later call. A mesh that fails
+	// to load or to find room in its arena is logged, flagged IsFailed and dropped, so that the next request
+	// for the file loads it again
+	void ProcessPendingLoads(const VkDevice& device, CDeviceMemoryAllocator& allocator, CStagingRing& stagingRing,
+							 const SUploadQueues& uploadQueues);
+	// Frees the arena ranges of the meshes that are no longer referenced by any game object.
+	// The device must be done drawing them
+	void ReleaseUnused();
+	// Waits for the uploads in flight
+	void Cleanup(CDeviceMemoryAllocator& allocator);
+
+	[[nodiscard]] size_t GetMeshCount() const { return mapMesh.size(); }
+	[[nodiscard]] bool HasPendingLoads() const { return !vecPendingLoad.empty() || !vecUploadInFlight.empty(); }
+	// Meshes whose upload had to wait for a later call because the staging ring was full, each counted once
+	[[nodiscard]] uint64_t GetDeferredUploadCount() const { return deferredUploadCount; }
+	// Bumped whenever meshes become resident, so callers can tell when the set of drawable objects changed
+	[[nodiscard]] uint64_t GetResidencyVersion() const { return residencyVersion; }
+
+private:
+	struct SPendingLoad
+	{
+		// Of mapMesh
+		std::string Key;
+		std::string FileName;
+		ModelInformationSPtr ModelInfo;
+		std::future<void> Parse;
+		// Parsed but found the staging ring full on an earlier call
+		bool IsDeferred = false;
+	};
+
+	// Meshes whose uploads went in the same submission
+	struct SUploadInFlight
+	{
+		CUploadBatch TransferBatch;
+		// Takes the geometry over on the graphics queue. Only submitted once the transfer has executed, so
+		// that rendering never waits for it. Records nothing without a dedicated transfer family
+		CUploadBatch AcquireBatch;
+		bool IsAcquireSubmitted = false;
+		std::vector<ModelInformationSPtr> vecModelInfo;
+	};
+
+	// The file name followed by every setting that changes the mesh built from it
+	static std::string makeKey(const SObjectInformation& objectInformation);
+	// Logs why the mesh failed and forgets it
+	void dropFailedLoad(const SPendingLoad& pendingLoad, const std::exception& e);
+	// Finds room for the mesh in the arena matching its vertex format and index type
+	void allocateGeometry(const VkDevice& device, CDeviceMemoryAllocator& allocator, const SUploadQueues& uploadQueues,
+						  SModelInformation& modelInfo);
+	// Waits for every upload in flight and makes its meshes resident
+	void drainUploads();
+	static void destroyMesh(SModelInformation& modelInfo);
+
+	// Indexed by vertex format, then 16 or 32 bit indices
+	std::array<std::unique_ptr<CGeometryArena>, 4> arrGeometryArena;
+	std::unordered_map<std::string, ModelInformationSPtr> mapMesh;
+	// Still parsing or waiting for staging space
+	std::vector<SPendingLoad> vecPendingLoad;
+	std::vector<SUploadInFlight> vecUploadInFlight;
+	uint64_t deferredUploadCount = 0;
+	uint64_t residencyVersion = 0;
+	// Not owned
+	CThreadPool* pThreadPool;
+};
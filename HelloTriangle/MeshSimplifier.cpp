@@ -0,0 +1,277 @@
+#include "MeshSimplifier.h"
+#include "Common.h"
+
+#include <unordered_map>
+
+namespace
+{
+	// Symmetric 4x4 matrix summing the squared distances to a set of planes, weighted by triangle area
+	struct SQuadric
+	{
+		double XX = 0.0, XY = 0.0, XZ = 0.0, XW = 0.0;
+		double YY = 0.0, YZ = 0.0, YW = 0.0;
+		double ZZ = 0.0, ZW = 0.0;
+		double WW = 0.0;
+		double Weight = 0.0;
+
+		void AddPlane(const glm::vec3& normal, const double distance, const double weight)
+		{
+			const double x = normal.x, y = normal.y, z = normal.z;
+			XX += weight * x * x; XY += weight * x * y; XZ += weight * x * z; XW += weight * x * distance;
+			YY += weight * y * y; YZ += weight * y * z; YW += weight * y * distance;
+			ZZ += weight * z * z; ZW += weight * z * distance;
+			WW += weight * distance * distance;
+			Weight += weight;
+		}
+
+		void Add(const SQuadric& other)
+		{
+			XX += other.XX; XY += other.XY; XZ += other.XZ; XW += other.XW;
+			YY += other.YY; YZ += other.YZ; YW += other.YW;
+			ZZ += other.ZZ; ZW += other.ZW;
+			WW += other.WW;
+			Weight += other.Weight;
+		}
+
+		// Weighted sum of squared distances from the point to the planes
+		[[nodiscard]] double Evaluate(const glm::vec3& point) const
+		{
+			const double x = point.x, y = point.y, z = point.z;
+			return XX * x * x + 2.0 * XY * x * y + 2.0 * XZ * x * z + 2.0 * XW * x +
+				YY * y * y + 2.0 * YZ * y * z + 2.0 * YW * y +
+				ZZ * z * z + 2.0 * ZW * z +
+				WW;
+		}
+	};
+
+	struct SCollapse
+	{
+		uint32_t From;
+		uint32_t To;
+		float Error;
+	};
+
+	uint64_t edgeKey(const uint32_t from, const uint32_t to)
+	{
+		return (static_cast<uint64_t>(from) << 32) | to;
+	}
+
+	// Error of collapsing from onto to, as the average distance to the planes both vertices have gathered
+	float collapseError(const SQuadric& from, const SQuadric& to, const glm::vec3& position)
+	{
+		SQuadric combined = from;
+		combined.Add(to);
+		if (combined.Weight <= 0.0)
+			return 0.0f;
+		return static_cast<float>(std::sqrt(std::max(combined.Evaluate(position), 0.0) / combined.Weight));
+	}
+}
+
+float CMeshSimplifier::Simplify(const std::vector<SVertex>& vecVertex, const std::vector<uint32_t>& vecIndex,
+								const size_t targetIndexCount, const float maxError, std::vector<uint32_t>& outVecIndex)
+{
+	const auto vertexCount = vecVertex.size();
+	outVecIndex = vecIndex;
+
+	// Vertices that only differ in normal or texture coordinates share a position; collapsing
+	// one of them would tear the seam open, so they stay where they are
+	std::vector<uint32_t> vecPositionId(vertexCount);
+	std::vector<uint32_t> vecPositionUseCount(vertexCount, 0);
+	{
+		std::unordered_map<glm::vec3, uint32_t> mapPosition;
+		mapPosition.reserve(vertexCount);
+		for (size_t vertex = 0; vertex != vertexCount; ++vertex)
+		{
+			vecPositionId[vertex] = mapPosition.emplace(vecVertex[vertex].Position, static_cast<uint32_t>(vertex)).first->second;
+		}
+	}
+	{
+		std::vector<bool> vecReferenced(vertexCount, false);
+		for (const auto index : vecIndex)
+		{
+			if (!vecReferenced[index])
+			{
+				vecReferenced[index] = true;
+				++vecPositionUseCount[vecPositionId[index]];
+			}
+		}
+	}
+
+	std::vector<bool> vecCollapsible(vertexCount, true);
+	for (size_t vertex = 0; vertex != vertexCount; ++vertex)
+	{
+		if (vecPositionUseCount[vecPositionId[vertex]] > 1)
+			vecCollapsible[vertex] = false;
+	}
+
+	// Edges that aren't shared by exactly two consistently wound triangles mark open borders and non-manifold spots
+	{
+		std::unordered_map<uint64_t, uint32_t> mapEdgeCount;
+		mapEdgeCount.reserve(vecIndex.size());
+		for (size_t corner = 0; corner != vecIndex.size(); ++corner)
+		{
+			const auto next = corner % 3 == 2 ? corner - 2 : corner + 1;
+			++mapEdgeCount[edgeKey(vecPositionId[vecIndex[corner]], vecPositionId[vecIndex[next]])];
+		}
+		for (size_t corner = 0; corner != vecIndex.size(); ++corner)
+		{
+			const auto next = corner % 3 == 2 ? corner - 2 : corner + 1;
+			const auto from = vecPositionId[vecIndex[corner]];
+			const auto to = vecPositionId[vecIndex[next]];
+			const auto forward = mapEdgeCount.find(edgeKey(from, to));
+			const auto backward = mapEdgeCount.find(edgeKey(to, from));
+			if (forward->second != 1 || backward == mapEdgeCount.end() || backward->second != 1)
+			{
+				vecCollapsible[vecIndex[corner]] = false;
+				vecCollapsible[vecIndex[next]] = false;
+			}
+		}
+	}
+
+	std::vector<SQuadric> vecQuadric(vertexCount);
+	for (size_t corner = 0; corner != vecIndex.size(); corner += 3)
+	{
+		const auto& position0 = vecVertex[vecIndex[corner + 0]].Position;
+		const auto& position1 = vecVertex[vecIndex[corner + 1]].Position;
+		const auto& position2 = vecVertex[vecIndex[corner + 2]].Position;
+		const auto normal = glm::cross(position1 - position0, position2 - position0);
+		const auto doubleArea = glm::length(normal);
+		if (doubleArea <= 0.0f)
+			continue;
+
+		const auto unitNormal = normal / doubleArea;
+		const auto distance = -glm::dot(unitNormal, position0);
+		for (uint32_t i = 0; i != 3; ++i)
+		{
+			vecQuadric[vecIndex[corner + i]].AddPlane(unitNormal, distance, doubleArea * 0.5);
+		}
+	}
+
+	std::vector<uint32_t> vecAdjacencyStart(vertexCount + 1);
+	std::vector<uint32_t> vecAdjacency;
+	std::vector<SCollapse> vecCollapse;
+	std::vector<uint32_t> vecRemap(vertexCount);
+	std::vector<bool> vecTouched(vertexCount);
+	auto resultError = 0.0f;
+
+	// Each pass collapses the cheapest independent edges, then rebuilds the index buffer
+	while (outVecIndex.size() > targetIndexCount)
+	{
+		std::fill(vecAdjacencyStart.begin(), vecAdjacencyStart.end(), 0);
+		for (const auto index : outVecIndex)
+		{
+			++vecAdjacencyStart[index + 1];
+		}
+		for (size_t vertex = 0; vertex != vertexCount; ++vertex)
+		{
+			vecAdjacencyStart[vertex + 1] += vecAdjacencyStart[vertex];
+		}
+		vecAdjacency.resize(outVecIndex.size());
+		{
+			std::vector<uint32_t> vecFill(vecAdjacencyStart.begin(), vecAdjacencyStart.end() - 1);
+			for (size_t corner = 0; corner != outVecIndex.size(); ++corner)
+			{
+				vecAdjacency[vecFill[outVecIndex[corner]]++] = static_cast<uint32_t>(corner / 3);
+			}
+		}
+
+		// Collapsible vertices are surrounded by closed fans, so every half-edge leaving them shows up once
+		vecCollapse.clear();
+		for (size_t corner = 0; corner != outVecIndex.size(); ++corner)
+		{
+			const auto next = corner % 3 == 2 ? corner - 2 : corner + 1;
+			const auto from = outVecIndex[corner];
+			const auto to = outVecIndex[next];
+			if (vecCollapsible[from])
+				vecCollapse.push_back({ from, to, collapseError(vecQuadric[from], vecQuadric[to], vecVertex[to].Position) });
+		}
+		std::sort(vecCollapse.begin(), vecCollapse.end(), [](const SCollapse& lhs, const SCollapse& rhs)
+		{
+			return lhs.Error < rhs.Error;
+		});
+
+		for (size_t vertex = 0; vertex != vertexCount; ++vertex)
+		{
+			vecRemap[vertex] = static_cast<uint32_t>(vertex);
+		}
+		std::fill(vecTouched.begin(), vecTouched.end(), false);
+
+		const auto triangleBudget = (outVecIndex.size() - targetIndexCount) / 3;
+		size_t removedTriangleCount = 0;
+		size_t collapseCount = 0;
+		for (const auto& collapse : vecCollapse)
+		{
+			if (collapse.Error > maxError || removedTriangleCount >= triangleBudget)
+				break;
+			if (vecTouched[collapse.From] || vecTouched[collapse.To])
+				continue;
+
+			// Reject the collapse if any surviving triangle around From would flip over
+			const auto& toPosition = vecVertex[collapse.To].Position;
+			auto isValid = true;
+			size_t sharedTriangleCount = 0;
+			for (auto adjacency = vecAdjacencyStart[collapse.From]; adjacency != vecAdjacencyStart[collapse.From + 1]; ++adjacency)
+			{
+				const auto* pTriangle = &outVecIndex[vecAdjacency[adjacency] * 3];
+				if (pTriangle[0] == collapse.To || pTriangle[1] == collapse.To || pTriangle[2] == collapse.To)
+				{
+					++sharedTriangleCount;
+					continue;
+				}
+
+				glm::vec3 arrPosition[3];
+				for (uint32_t i = 0; i != 3; ++i)
+				{
+					arrPosition[i] = vecVertex[pTriangle[i]].Position;
+				}
+				const auto oldNormal = glm::cross(arrPosition[1] - arrPosition[0], arrPosition[2] - arrPosition[0]);
+				for (uint32_t i = 0; i != 3; ++i)
+				{
+					if (pTriangle[i] == collapse.From)
+						arrPosition[i] = toPosition;
+				}
+				const auto newNormal = glm::cross(arrPosition[1] - arrPosition[0], arrPosition[2] - arrPosition[0]);
+				if (glm::dot(oldNormal, newNormal) <= 0.0f)
+				{
+					isValid = false;
+					break;
+				}
+			}
+			if (!isValid)
+				continue;
+
+			vecRemap[collapse.From] = collapse.To;
+			vecQuadric[collapse.To].Add(vecQuadric[collapse.From]);
+			// The one-ring of From changes shape, keep it out of the rest of this pass
+			for (auto adjacency = vecAdjacencyStart[collapse.From]; adjacency != vecAdjacencyStart[collapse.From + 1]; ++adjacency)
+			{
+				const auto* pTriangle = &outVecIndex[vecAdjacency[adjacency] * 3];
+				vecTouched[pTriangle[0]] = true;
+				vecTouched[pTriangle[1]] = true;
+				vecTouched[pTriangle[2]] = true;
+			}
+			resultError = std::max(resultError, collapse.Error);
+			removedTriangleCount += sharedTriangleCount;
+			++collapseCount;
+		}
+
+		if (collapseCount == 0)
+			break;
+
+		size_t writeIndex = 0;
+		for (size_t corner = 0; corner != outVecIndex.size(); corner += 3)
+		{
+			const auto a = vecRemap[outVecIndex[corner + 0]];
+			const auto b = vecRemap[outVecIndex[corner + 1]];
+			const auto c = vecRemap[outVecIndex[corner + 2]];
+			if (a == b || b == c || c == a)
+				continue;
+			outVecIndex[writeIndex++] = a;
+			outVecIndex[writeIndex++] = b;
+			outVecIndex[writeIndex++] = c;
+		}
+		outVecIndex.resize(writeIndex);
+	}
+
+	return resultError;
+}
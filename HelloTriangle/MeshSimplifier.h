@@ -0,0 +1,17 @@
+#pragma once
+#include "CommonStructs.h"
+
+#include <vector>
+
+// Edge collapse simplification driven by quadric error metrics (Garland and Heckbert).
+// Vertices are only ever collapsed onto their neighbours, never moved or created, so every
+// level of detail indexes the original vertex array and can share its vertex buffer
+class CMeshSimplifier
+{
+public:
+	// Collapses edges until the index count reaches targetIndexCount or the next collapse would move the
+	// surface by more than maxError. Vertices on open borders or UV seams are never collapsed.
+	// Returns the largest error introduced, as a distance in mesh units
+	static float Simplify(const std::vector<SVertex>& vecVertex, const std::vector<uint32_t>& vecIndex,
+						  size_t targetIndexCount, float maxError, std::vector<uint32_t>& outVecIndex);
+};
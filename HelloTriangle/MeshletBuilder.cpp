@@ -0,0 +1,121 @@
+#include "MeshletBuilder.h"
+#include "Common.h"
+
+namespace
+{
+	// Below this the triangles face too many directions for the cone to ever cull anything
+	constexpr float MIN_CONE_SPREAD = 0.1f;
+}
+
+void CMeshletBuilder::Build(SModelInformation& modelInfo)
+{
+	auto& meshlets = modelInfo.Meshlets;
+	meshlets = {};
+	if (modelInfo.VecLod.empty())
+		return;
+
+	const auto pIndex = modelInfo.GetIndexData();
+	const auto& fullDetail = modelInfo.VecLod[0];
+
+	// Which meshlet last referenced each vertex, offset by one so zero means none yet
+	std::vector<uint32_t> vecVertexMeshlet(modelInfo.VertexCount, 0);
+	uint32_t meshletVertexCount = 0;
+	auto firstIndex = fullDetail.FirstIndex;
+	const auto endIndex = fullDetail.FirstIndex + fullDetail.IndexCount;
+
+	const auto countNewVertices = [&](const uint32_t index)
+	{
+		const auto meshletId = static_cast<uint32_t>(meshlets.GetCount()) + 1;
+		uint32_t newVertexCount = 0;
+		for (uint32_t corner = 0; corner != 3; ++corner)
+		{
+			if (vecVertexMeshlet[pIndex[index + corner]] != meshletId)
+			{
+				vecVertexMeshlet[pIndex[index + corner]] = meshletId;
+				++newVertexCount;
+			}
+		}
+		return newVertexCount;
+	};
+
+	for (auto index = firstIndex; index != endIndex; index += 3)
+	{
+		const auto isTriangleLimit = (index - firstIndex) / 3 == MAX_MESHLET_TRIANGLES;
+		auto newVertexCount = isTriangleLimit ? 0 : countNewVertices(index);
+		if (isTriangleLimit || meshletVertexCount + newVertexCount > MAX_MESHLET_VERTICES)
+		{
+			meshlets.VecFirstIndex.push_back(firstIndex);
+			meshlets.VecIndexCount.push_back(index - firstIndex);
+			firstIndex = index;
+			meshletVertexCount = 0;
+			// Counted again against the new meshlet
+			newVertexCount = countNewVertices(index);
+		}
+		meshletVertexCount += newVertexCount;
+	}
+	if (firstIndex != endIndex)
+	{
+		meshlets.VecFirstIndex.push_back(firstIndex);
+		meshlets.VecIndexCount.push_back(endIndex - firstIndex);
+	}
+
+	meshlets.VecBoundingSphere.resize(meshlets.GetCount());
+	meshlets.VecNormalCone.resize(meshlets.GetCount());
+	for (size_t meshlet = 0; meshlet != meshlets.GetCount(); ++meshlet)
+	{
+		computeBounds(modelInfo, meshlets.VecFirstIndex[meshlet], meshlets.VecIndexCount[meshlet],
+					  meshlets.VecBoundingSphere[meshlet], meshlets.VecNormalCone[meshlet]);
+	}
+}
+
+void CMeshletBuilder::computeBounds(const SModelInformation& modelInfo, const uint32_t firstIndex, const uint32_t indexCount,
+									glm::vec4& outBoundingSphere, glm::vec4& outNormalCone)
+{
+	const auto pVertex = modelInfo.GetVertexData();
+	const auto pIndex = modelInfo.GetIndexData() + firstIndex;
+
+	auto boundsMin = pVertex[pIndex[0]].Position;
+	auto boundsMax = boundsMin;
+	auto normalSum = glm::vec3(0.0f);
+	for (uint32_t corner = 0; corner != indexCount; corner += 3)
+	{
+		const auto& position0 = pVertex[pIndex[corner + 0]].Position;
+		const auto& position1 = pVertex[pIndex[corner + 1]].Position;
+		const auto& position2 = pVertex[pIndex[corner + 2]].Position;
+		boundsMin = glm::min(glm::min(boundsMin, position0), glm::min(position1, position2));
+		boundsMax = glm::max(glm::max(boundsMax, position0), glm::max(position1, position2));
+
+		const auto normal = glm::cross(position1 - position0, position2 - position0);
+		const auto length = glm::length(normal);
+		if (length > 0.0f)
+			normalSum += normal / length;
+	}
+
+	const auto center = (boundsMin + boundsMax) * 0.5f;
+	auto radiusSquared = 0.0f;
+	for (uint32_t corner = 0; corner != indexCount; ++corner)
+	{
+		const auto offset = pVertex[pIndex[corner]].Position - center;
+		radiusSquared = std::max(radiusSquared, glm::dot(offset, offset));
+	}
+	outBoundingSphere = glm::vec4(center, std::sqrt(radiusSquared));
+
+	// The cone holds every triangle normal, the cutoff is the sine of the widest angle between a normal and the axis
+	outNormalCone = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+	const auto normalSumLength = glm::length(normalSum);
+	if (normalSumLength <= 0.0f)
+		return;
+
+	const auto axis = normalSum / normalSumLength;
+	auto minDot = 1.0f;
+	for (uint32_t corner = 0; corner != indexCount; corner += 3)
+	{
+		const auto& position0 = pVertex[pIndex[corner + 0]].Position;
+		const auto normal = glm::cross(pVertex[pIndex[corner + 1]].Position - position0, pVertex[pIndex[corner + 2]].Position - position0);
+		const auto length = glm::length(normal);
+		if (length > 0.0f)
+			minDot = std::min(minDot, glm::dot(normal / length, axis));
+	}
+	if (minDot > MIN_CONE_SPREAD)
+		outNormalCone = glm::vec4(axis, std::sqrt(1.0f - minDot * minDot));
+}
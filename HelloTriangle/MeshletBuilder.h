@@ -0,0 +1,18 @@
+#pragma once
+#include "CommonStructs.h"
+
+// Splits level 0 of a mesh into meshlets and computes their culling bounds
+class CMeshletBuilder
+{
+public:
+	static constexpr uint32_t MAX_MESHLET_VERTICES = 64;
+	static constexpr uint32_t MAX_MESHLET_TRIANGLES = 124;
+
+	// Meshlets are cut from the index buffer in its existing order, which the mesh optimizer
+	// has already made spatially coherent, so the buffer itself doesn't change
+	static void Build(SModelInformation& modelInfo);
+
+private:
+	static void computeBounds(const SModelInformation& modelInfo, uint32_t firstIndex, uint32_t indexCount,
+							  glm::vec4& outBoundingSphere, glm::vec4& outNormalCone);
+};
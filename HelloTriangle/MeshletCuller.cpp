@@ -0,0 +1,48 @@
+#include "MeshletCuller.h"
+#include "Common.h"
+#include "ObjectCuller.h"
+
+void CMeshletCuller::Cull(const SMeshlets& meshlets, const glm::mat4& modelViewProjection, const glm::vec3& cameraPosition,
+						  std::vector<SDrawRange>& outVecDrawRange, SMeshletCullStatistics& statistics)
+{
+	const auto arrPlane = CObjectCuller::GetFrustumPlanes(modelViewProjection);
+
+	outVecDrawRange.clear();
+	statistics.MeshletCount += static_cast<uint32_t>(meshlets.GetCount());
+	for (size_t meshlet = 0; meshlet != meshlets.GetCount(); ++meshlet)
+	{
+		const auto& sphere = meshlets.VecBoundingSphere[meshlet];
+		const auto center = glm::vec3(sphere);
+
+		auto isOutside = false;
+		for (const auto& plane : arrPlane)
+		{
+			if (glm::dot(glm::vec3(plane), center) + plane.w < -sphere.w)
+			{
+				isOutside = true;
+				break;
+			}
+		}
+		if (isOutside)
+		{
+			++statistics.FrustumCulledCount;
+			continue;
+		}
+
+		// Every triangle faces away if the view direction lies inside the cone widened by the sphere
+		const auto& cone = meshlets.VecNormalCone[meshlet];
+		const auto toCenter = center - cameraPosition;
+		if (glm::dot(toCenter, glm::vec3(cone)) >= cone.w * glm::length(toCenter) + sphere.w)
+		{
+			++statistics.BackfaceCulledCount;
+			continue;
+		}
+
+		const auto firstIndex = meshlets.VecFirstIndex[meshlet];
+		const auto indexCount = meshlets.VecIndexCount[meshlet];
+		if (!outVecDrawRange.empty() && outVecDrawRange.back().FirstIndex + outVecDrawRange.back().IndexCount == firstIndex)
+			outVecDrawRange.back().IndexCount += indexCount;
+		else
+			outVecDrawRange.push_back({ firstIndex, indexCount });
+	}
+}
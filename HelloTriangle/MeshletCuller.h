@@ -0,0 +1,22 @@
+#pragma once
+#include "CommonStructs.h"
+
+#include <vector>
+
+struct SMeshletCullStatistics
+{
+	uint32_t MeshletCount = 0;
+	uint32_t FrustumCulledCount = 0;
+	uint32_t BackfaceCulledCount = 0;
+};
+
+// CPU frustum and normal cone culling of meshlets
+class CMeshletCuller
+{
+public:
+	// Everything is in mesh space: the planes are taken from the model view projection matrix and the
+	// camera position has to be transformed by the inverse model view. Visible meshlets that follow each
+	// other in the index buffer are merged into one draw range. Assumes uniform scaling for the cones
+	static void Cull(const SMeshlets& meshlets, const glm::mat4& modelViewProjection, const glm::vec3& cameraPosition,
+					 std::vector<SDrawRange>& outVecDrawRange, SMeshletCullStatistics& statistics);
+};
@@ -1,56 +1,145 @@
 ﻿#include "Common.h"
 #include "CommonStructs.h"
 #include "ModelLoader.h"
-#include "FileReader.h"
+#include "BinaryScene.h"
 #include "GameObject.h"
-
-#include <rapidjson/document.h>
-using namespace rapidjson;
+#include "MeshCache.h"
+#include "MeshletBuilder.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "NormalGenerator.h"
+#include "ObjParser.h"
+#include "SceneParser.h"
+#include "VertexQuantizer.h"
+#include "VertexWelder.h"
 
 #define TINYOBJLOADER_IMPLEMENTATION
 #include <tiny_obj_loader.h>
 
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
 #include <unordered_map>
 
-
-void CModelLoader::GetSceneHierarchy(const char* filename, GameObjectVecPtrs& goPtrs)
+namespace
 {
-	CFileReader fileReader(filename);
-	std::vector<char> out;
-	fileReader.ReadFile(out);
+	// Including the full detail level
+	constexpr uint32_t LOD_MAX_COUNT = 4;
+	// Collapses that move the surface further than this fraction of the bounding radius are rejected
+	constexpr float LOD_MAX_RELATIVE_ERROR = 0.02f;
+	// A level has to get down to this fraction of the previous level's indices to be kept
+	constexpr float LOD_MIN_REDUCTION = 0.8f;
+	constexpr auto BENCHMARK_MODEL_FILENAME = "Models/Chalet/chalet.obj";
 
-	// Parse the scene hierarchy
-	const auto sceneHierarchy = std::string(out.begin(), out.end());
-	Document sceneDoc;
-	sceneDoc.Parse(sceneHierarchy.data());
+	// Objects using one file with different mesh settings get meshes of their own, which may be loaded at the
+	// same time. Only one of them reads or writes the file's mesh cache at a time
+	std::mutex& getMeshCacheMutex(const std::string& filename)
+	{
+		static std::mutex mapMutex;
+		static std::unordered_map<std::string, std::mutex> mapMeshCacheMutex;
+		const std::lock_guard<std::mutex> lock(mapMutex);
+		return mapMeshCacheMutex[filename];
+	}
 
-	const auto& sceneObj = sceneDoc["Scene"];
-	goPtrs.reserve(sceneObj.Size());
-	
-	for(size_t index = 0; index != sceneObj.Size(); ++index)
+	// A rippled grid of quads with texture coordinates and no normals, so both the fan triangulation
+	// and the normal generation get exercised. Returns the number of triangles written
+	size_t writeSyntheticObj(const std::string& filename, const size_t triangleCount)
+	{
+		const auto quadsPerSide = static_cast<size_t>(std::ceil(std::sqrt(static_cast<double>(triangleCount) / 2.0)));
+		const auto verticesPerSide = quadsPerSide + 1;
+
+		std::ofstream writeStream(filename, std::ios::binary | std::ios::trunc);
+		if (!writeStream)
+			throw std::runtime_error("Failed to create " + filename);
+
+		char line[128];
+		for (size_t row = 0; row != verticesPerSide; ++row)
+		{
+			for (size_t column = 0; column != verticesPerSide; ++column)
+			{
+				const auto u = static_cast<double>(column) / quadsPerSide;
+				const auto v = static_cast<double>(row) / quadsPerSide;
+				const auto length = std::snprintf(line, sizeof(line), "v %.6f %.6f %.6f\nvt %.6f %.6f\n",
+					u * 100.0 - 50.0, std::sin(u * 40.0) * std::cos(v * 40.0), v * 100.0 - 50.0, u, v);
+				writeStream.write(line, length);
+			}
+		}
+		for (size_t row = 0; row != quadsPerSide; ++row)
+		{
+			for (size_t column = 0; column != quadsPerSide; ++column)
+			{
+				// OBJ indices are one based
+				const auto corner = row * verticesPerSide + column + 1;
+				const auto length = std::snprintf(line, sizeof(line), "f %zu/%zu %zu/%zu %zu/%zu %zu/%zu\n",
+					corner, corner, corner + verticesPerSide, corner + verticesPerSide,
+					corner + verticesPerSide + 1, corner + verticesPerSide + 1, corner + 1, corner + 1);
+				writeStream.write(line, length);
+			}
+		}
+		return 2 * quadsPerSide * quadsPerSide;
+	}
+
+	void benchmarkObj(const std::string& filename)
+	{
+		const auto time = [&filename](const char* name, const std::function<void()>& load)
+		{
+			const auto startTime = std::chrono::high_resolution_clock::now();
+			load();
+			const auto loadTime = std::chrono::duration<float, std::chrono::milliseconds::period>(
+				std::chrono::high_resolution_clock::now() - startTime).count();
+			std::cout << filename << ": " << name << " took " << loadTime << " ms" << std::endl;
+		};
+
+		time("tinyobj", [&filename]()
+		{
+			std::vector<SVertex> vecVertex;
+			std::vector<uint32_t> vecIndex;
+			CModelLoader::LoadModel(SObjectInformation(filename, filename), vecVertex, vecIndex);
+		});
+
+		std::vector<SVertex> vecVertex;
+		std::vector<uint32_t> vecIndex;
+		auto hasNormals = false;
+		time("CObjParser on one thread", [&]()
+		{
+			if (!CObjParser::Parse(filename, vecVertex, vecIndex, hasNormals, 1))
+				throw std::runtime_error("Failed to load the object");
+		});
+		vecVertex.clear();
+		vecIndex.clear();
+		time("CObjParser", [&]()
+		{
+			if (!CObjParser::Parse(filename, vecVertex, vecIndex, hasNormals))
+				throw std::runtime_error("Failed to load the object");
+		});
+		if (!hasNormals)
+		{
+			time("normal generation", [&]()
+			{
+				CNormalGenerator::Generate(vecVertex, vecIndex);
+			});
+		}
+		std::cout << filename << ": " << vecIndex.size() / 3 << " triangles, " << vecVertex.size() << " vertices" << std::endl;
+	}
+}
+
+void CModelLoader::GetSceneHierarchy(const char* filename, GameObjectVecPtrs& goPtrs)
+{
+	if (CBinaryScene::IsBinaryScene(filename))
 	{
-		const auto& model = sceneObj[static_cast<rapidjson::SizeType>(index)];
-		const auto file = model["Filename"].GetString();
-		const auto name = model["Name"].GetString();
-		const auto transform = model["Transform"].GetObject();
-		const auto position = transform["Position"].GetArray();
-		const auto rotation = transform["Rotation"].GetArray();
-		const auto scale = transform["Scale"].GetArray();
-		const auto objectPosition = glm::vec3(position[0].GetFloat(), 
-											  position[1].GetFloat(), 
-											  position[2].GetFloat());
-		const auto objectRotation = glm::vec3(rotation[0].GetFloat(),
-											  rotation[1].GetFloat(),
-											  rotation[2].GetFloat());
-		const auto objectScale = glm::vec3(scale[0].GetFloat(),
-										   scale[1].GetFloat(), 
-										   scale[2].GetFloat());
-
-		SObjectInformation objectInformation(file, name);
-		STransform objectTransform(objectPosition, objectRotation, objectScale);
-		GameObjectUPtr uptr(new CStaticGameObject(objectInformation, objectTransform));
-		goPtrs.push_back(std::move(uptr));
+		CBinaryScene::Load(filename, goPtrs);
+		return;
 	}
+
+	// A binary copy converted from the JSON needs no parsing, use it for as long as the JSON hasn't been edited since
+	const auto binaryFilename = CBinaryScene::GetUpToDateBinaryFilename(filename);
+	if (!binaryFilename.empty())
+		CBinaryScene::Load(binaryFilename.c_str(), goPtrs);
+	else
+		CSceneParser::Parse(filename, goPtrs);
 }
 
 void CModelLoader::LoadModel(const SObjectInformation& modelInformation,
@@ -72,9 +161,18 @@ void CModelLoader::LoadModel(const SObjectInformation& modelInformation,
 	if(!result)
 		throw std::runtime_error("Failed to load the object");
 
+	size_t indexCount = 0;
+	for (const auto& shape : vecShape)
+	{
+		indexCount += shape.mesh.indices.size();
+	}
 
-	outVecVertex.reserve(attrib.GetVertices().size());
+	outVecIndex.reserve(indexCount);
+	outVecVertex.reserve(attrib.vertices.size() / 3);
 
+	// OBJ indexes positions and texture coordinates separately, so weld identical
+	// combinations into a single vertex and let the index buffer do the sharing
+	CVertexWelder welder(indexCount);
 	for(const auto& shape : vecShape)
 	{
 		for(const auto& index : shape.mesh.indices)
@@ -86,47 +184,168 @@ void CModelLoader::LoadModel(const SObjectInformation& modelInformation,
 
 			vertex.TextureCoords.x = attrib.texcoords[2 * index.texcoord_index + 0];
 			vertex.TextureCoords.y = 1.0f - attrib.texcoords[2 * index.texcoord_index + 1];
-			
-			outVecVertex.push_back(vertex);
-			outVecIndex.push_back(static_cast<uint32_t>(outVecIndex.size()));
+
+			if (index.normal_index >= 0)
+			{
+				vertex.Normal.x = attrib.normals[3 * index.normal_index + 0];
+				vertex.Normal.y = attrib.normals[3 * index.normal_index + 1];
+				vertex.Normal.z = attrib.normals[3 * index.normal_index + 2];
+			}
+
+			outVecIndex.push_back(welder.Weld(vertex, outVecVertex));
 		}
 	}
+
+	if (indexCount != 0)
+	{
+		std::cout << modelInformation.FileName << ": welded " << indexCount << " vertices into "
+			<< outVecVertex.size() << " (" << 100.0 * outVecVertex.size() / indexCount << "%)" << std::endl;
+	}
 }
 
 void CModelLoader::LoadModel(const SObjectInformation& objectInformation, SModelInformation& modelInfo)
 {
-	tinyobj::attrib_t attrib;
-	std::vector<tinyobj::shape_t> vecShape;
-	std::vector<tinyobj::material_t> vecMaterial;
-	std::string warn, error;
+	{
+		const std::lock_guard<std::mutex> lock(getMeshCacheMutex(objectInformation.FileName));
+		if (!CMeshCache::Load(objectInformation.FileName, objectInformation.CreaseAngle, modelInfo))
+			parseModel(objectInformation, modelInfo);
+	}
+
+	computeBounds(modelInfo);
+	if (objectInformation.BuildMeshlets)
+	{
+		CMeshletBuilder::Build(modelInfo);
+		std::cout << objectInformation.FileName << ": " << modelInfo.Meshlets.GetCount() << " meshlets" << std::endl;
+	}
 
+	// The mesh cache always holds SVertex, packing is cheap enough to redo on every load
+	if (objectInformation.VertexFormat == EVertexFormat::Packed)
+		CVertexQuantizer::Pack(modelInfo);
+	narrowIndices(modelInfo);
+}
 
-	const auto result = tinyobj::LoadObj(&attrib, &vecShape, &vecMaterial, &warn, &error, objectInformation.FileName.c_str());
+void CModelLoader::buildLods(const SObjectInformation& objectInformation, SModelInformation& modelInfo)
+{
+	const auto fullIndexCount = static_cast<uint32_t>(modelInfo.VecIndex.size());
+	modelInfo.VecLod.clear();
+	modelInfo.VecLod.push_back({ 0, fullIndexCount, 0.0f });
 
-	if (!warn.empty())
-		std::cout << warn << std::endl;
-	if (!error.empty())
-		std::cout << error << std::endl;
-	if (!result)
-		throw std::runtime_error("Failed to load the object");
+	computeBounds(modelInfo);
+	const auto maxError = modelInfo.BoundsRadius * LOD_MAX_RELATIVE_ERROR;
 
+	std::vector<uint32_t> vecLodIndex;
+	for (uint32_t level = 1; level != LOD_MAX_COUNT; ++level)
+	{
+		// Each level is simplified from the previous one, which is far cheaper than starting over from level 0
+		const auto& previousLod = modelInfo.VecLod.back();
+		const std::vector<uint32_t> vecPreviousIndex(modelInfo.VecIndex.begin() + previousLod.FirstIndex,
+													 modelInfo.VecIndex.begin() + previousLod.FirstIndex + previousLod.IndexCount);
+		const auto targetIndexCount = previousLod.IndexCount / 6 * 3;
+		const auto error = CMeshSimplifier::Simplify(modelInfo.VecVertex, vecPreviousIndex, targetIndexCount, maxError, vecLodIndex);
 
-	modelInfo.VecVertex.reserve(attrib.GetVertices().size());
-	// TODO: Find a better way to do the loading
-	for (const auto& shape : vecShape)
+		// Not worth a level of its own, the mesh is mostly locked seams or already at the error limit
+		if (vecLodIndex.size() > previousLod.IndexCount * LOD_MIN_REDUCTION)
+			break;
+
+		CMeshOptimizer::OptimizeTriangleOrder(modelInfo.VecVertex, vecLodIndex);
+		SLodLevel lod;
+		lod.FirstIndex = static_cast<uint32_t>(modelInfo.VecIndex.size());
+		lod.IndexCount = static_cast<uint32_t>(vecLodIndex.size());
+		lod.Error = std::max(error, previousLod.Error);
+		modelInfo.VecIndex.insert(modelInfo.VecIndex.end(), vecLodIndex.begin(), vecLodIndex.end());
+		modelInfo.VecLod.push_back(lod);
+
+		std::cout << objectInformation.FileName << ": LOD " << level << " has " << lod.IndexCount / 3
+			<< " triangles, error " << lod.Error << std::endl;
+	}
+}
+
+void CModelLoader::computeBounds(SModelInformation& modelInfo)
+{
+	const auto pVertex = modelInfo.GetVertexData();
+	const auto vertexCount = modelInfo.MappedCache ? modelInfo.VertexCount : static_cast<uint32_t>(modelInfo.VecVertex.size());
+	if (vertexCount == 0)
+		return;
+
+	auto boundsMin = pVertex[0].Position;
+	auto boundsMax = pVertex[0].Position;
+	for (uint32_t i = 1; i != vertexCount; ++i)
 	{
-		for (const auto& index : shape.mesh.indices)
-		{
-			SVertex vertex = {};
-			vertex.Position.x = attrib.vertices[3 * index.vertex_index + 0];
-			vertex.Position.y = attrib.vertices[3 * index.vertex_index + 1];
-			vertex.Position.z = attrib.vertices[3 * index.vertex_index + 2];
+		boundsMin = glm::min(boundsMin, pVertex[i].Position);
+		boundsMax = glm::max(boundsMax, pVertex[i].Position);
+	}
 
-			vertex.TextureCoords.x = attrib.texcoords[2 * index.texcoord_index + 0];
-			vertex.TextureCoords.y = 1.0f - attrib.texcoords[2 * index.texcoord_index + 1];
+	modelInfo.BoundsMin = boundsMin;
+	modelInfo.BoundsMax = boundsMax;
+	// Centred on the box, not minimal but close enough for picking levels of detail
+	modelInfo.BoundsCenter = (boundsMin + boundsMax) * 0.5f;
+	auto radiusSquared = 0.0f;
+	for (uint32_t i = 0; i != vertexCount; ++i)
+	{
+		const auto offset = pVertex[i].Position - modelInfo.BoundsCenter;
+		radiusSquared = std::max(radiusSquared, glm::dot(offset, offset));
+	}
+	modelInfo.BoundsRadius = std::sqrt(radiusSquared);
+}
 
-			modelInfo.VecVertex.push_back(vertex);
-			modelInfo.VecIndex.push_back(static_cast<uint32_t>(modelInfo.VecIndex.size()));
-		}
+void CModelLoader::narrowIndices(SModelInformation& modelInfo)
+{
+	// Stay below 0xFFFF so the index can never be read as a primitive restart
+	if (modelInfo.VertexCount > UINT16_MAX)
+		return;
+
+	const auto pIndex = modelInfo.GetIndexData();
+	modelInfo.VecIndex16.resize(modelInfo.IndexCount);
+	for (uint32_t i = 0; i != modelInfo.IndexCount; ++i)
+	{
+		modelInfo.VecIndex16[i] = static_cast<uint16_t>(pIndex[i]);
 	}
+	modelInfo.IndexType = VK_INDEX_TYPE_UINT16;
+}
+
+void CModelLoader::parseModel(const SObjectInformation& objectInformation, SModelInformation& modelInfo)
+{
+	auto hasNormals = false;
+	if (!CObjParser::Parse(objectInformation.FileName, modelInfo.VecVertex, modelInfo.VecIndex, hasNormals))
+		throw std::runtime_error("Failed to load the object");
+
+	if (!hasNormals)
+	{
+		const auto parsedVertexCount = modelInfo.VecVertex.size();
+		CNormalGenerator::Generate(modelInfo.VecVertex, modelInfo.VecIndex, objectInformation.CreaseAngle);
+		std::cout << objectInformation.FileName << ": generated normals, " << modelInfo.VecVertex.size() - parsedVertexCount
+			<< " vertices split along creases" << std::endl;
+	}
+
+	std::cout << objectInformation.FileName << ": " << modelInfo.VecIndex.size() / 3 << " triangles, "
+		<< modelInfo.VecVertex.size() << " vertices" << std::endl;
+
+	// Paid once, the optimized buffers are what goes into the mesh cache
+	const auto cacheBefore = CMeshOptimizer::AnalyzeVertexCache(modelInfo.VecIndex, modelInfo.VecVertex.size());
+	CMeshOptimizer::Optimize(modelInfo.VecVertex, modelInfo.VecIndex);
+	const auto cacheAfter = CMeshOptimizer::AnalyzeVertexCache(modelInfo.VecIndex, modelInfo.VecVertex.size());
+	std::cout << objectInformation.FileName << ": ACMR " << cacheBefore.ACMR << " -> " << cacheAfter.ACMR
+		<< ", ATVR " << cacheBefore.ATVR << " -> " << cacheAfter.ATVR << std::endl;
+
+	buildLods(objectInformation, modelInfo);
+
+	modelInfo.VertexCount = static_cast<uint32_t>(modelInfo.VecVertex.size());
+	modelInfo.IndexCount = static_cast<uint32_t>(modelInfo.VecIndex.size());
+
+	CMeshCache::Store(objectInformation.FileName, objectInformation.CreaseAngle, modelInfo);
+}
+
+void CModelLoader::Benchmark(const size_t syntheticTriangleCount)
+{
+	if (std::filesystem::exists(BENCHMARK_MODEL_FILENAME))
+		benchmarkObj(BENCHMARK_MODEL_FILENAME);
+	else
+		std::cout << BENCHMARK_MODEL_FILENAME << " not found, skipping it" << std::endl;
+
+	const auto path = (std::filesystem::temp_directory_path() / "ModelBenchmark.obj").string();
+	const auto triangleCount = writeSyntheticObj(path, syntheticTriangleCount);
+	std::cout << path << ": generated " << triangleCount << " triangles, "
+		<< std::filesystem::file_size(path) / (1024 * 1024) << " MiB" << std::endl;
+	benchmarkObj(path);
+	std::filesystem::remove(path);
 }
@@ -14,4 +14,16 @@ public:
 	static void GetSceneHierarchy(const char* filename, GameObjectVecPtrs& goPtrs);
 	static void LoadModel(const SObjectInformation& modelInformation, std::vector<SVertex>& outVecVertex, std::vector<uint32_t>& outVecIndex);
 	static void LoadModel(const SObjectInformation &objectInformation, SModelInformation& modelInfo);
+	// Times tinyobj against CObjParser, on one thread and on all of them, for the chalet and for a generated
+	// grid of syntheticTriangleCount triangles. Nothing is cached and the generated file is deleted afterwards
+	static void Benchmark(size_t syntheticTriangleCount);
+
+private:
+	// Parses and optimizes the OBJ, then writes the mesh cache
+	static void parseModel(const SObjectInformation& objectInformation, SModelInformation& modelInfo);
+	// Appends the simplified levels of detail to the index buffer
+	static void buildLods(const SObjectInformation& objectInformation, SModelInformation& modelInfo);
+	static void computeBounds(SModelInformation& modelInfo);
+	// Switches the mesh to 16 bit indices when its vertex count allows it
+	static void narrowIndices(SModelInformation& modelInfo);
 };
@@ -0,0 +1,370 @@
+#include "NormalGenerator.h"
+#include "Common.h"
+#include "VertexWelder.h"
+
+#include <cfloat>
+#include <emmintrin.h>
+#include <thread>
+
+namespace
+{
+	constexpr size_t MIN_TRIANGLES_PER_THREAD = 1 << 16;
+	constexpr size_t MIN_POSITIONS_PER_THREAD = 1 << 15;
+	// Triangles handled by one iteration of the SSE loop
+	constexpr size_t LANE_COUNT = 4;
+
+	// One entry per triangle, laid out for the SSE loop that fills it
+	struct SFaceData
+	{
+		std::vector<float> VecNormalX;
+		std::vector<float> VecNormalY;
+		std::vector<float> VecNormalZ;
+		// Interior angle in radians at each of the three corners
+		std::array<std::vector<float>, 3> ArrVecCornerAngle;
+	};
+
+	// Splits [0, count) into at most threadCount ranges and runs the first on the calling thread.
+	// The split only depends on the arguments, so two calls with the same ones visit the same ranges
+	template <typename TFunction>
+	void parallelFor(const size_t count, const size_t minPerThread, const uint32_t threadCount, TFunction function)
+	{
+		const auto rangeCount = std::clamp<size_t>(count / minPerThread, 1, threadCount);
+		std::vector<std::thread> vecThread;
+		vecThread.reserve(rangeCount - 1);
+		for (size_t range = 1; range < rangeCount; ++range)
+		{
+			vecThread.emplace_back(function, count * range / rangeCount, count * (range + 1) / rangeCount, range);
+		}
+		function(size_t(0), count / rangeCount, size_t(0));
+		for (auto& thread : vecThread)
+		{
+			thread.join();
+		}
+	}
+
+	// Abramowitz and Stegun 4.4.45, off by less than 7e-5 radians which is plenty for a weight
+	__m128 acosApproximation(const __m128 x)
+	{
+		const auto absX = _mm_min_ps(_mm_andnot_ps(_mm_set1_ps(-0.0f), x), _mm_set1_ps(1.0f));
+		auto polynomial = _mm_set1_ps(-0.0187293f);
+		polynomial = _mm_add_ps(_mm_mul_ps(polynomial, absX), _mm_set1_ps(0.0742610f));
+		polynomial = _mm_add_ps(_mm_mul_ps(polynomial, absX), _mm_set1_ps(-0.2121144f));
+		polynomial = _mm_add_ps(_mm_mul_ps(polynomial, absX), _mm_set1_ps(1.5707288f));
+		const auto result = _mm_mul_ps(_mm_sqrt_ps(_mm_sub_ps(_mm_set1_ps(1.0f), absX)), polynomial);
+
+		// acos(-x) = pi - acos(x)
+		const auto isNegative = _mm_cmplt_ps(x, _mm_setzero_ps());
+		const auto mirrored = _mm_sub_ps(_mm_set1_ps(3.14159265f), result);
+		return _mm_or_ps(_mm_and_ps(isNegative, mirrored), _mm_andnot_ps(isNegative, result));
+	}
+
+	__m128 dot3(const __m128* a, const __m128* b)
+	{
+		return _mm_add_ps(_mm_add_ps(_mm_mul_ps(a[0], b[0]), _mm_mul_ps(a[1], b[1])), _mm_mul_ps(a[2], b[2]));
+	}
+
+	// Zero instead of infinity for degenerate vectors, so collapsed triangles drop out of every sum
+	__m128 inverseLength(const __m128* v)
+	{
+		const auto lengthSquared = dot3(v, v);
+		const auto isValid = _mm_cmpgt_ps(lengthSquared, _mm_set1_ps(FLT_MIN));
+		return _mm_and_ps(isValid, _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(lengthSquared)));
+	}
+
+	void storeLanes(float* pOut, const __m128 value, const size_t laneCount)
+	{
+		if (laneCount == LANE_COUNT)
+		{
+			_mm_storeu_ps(pOut, value);
+			return;
+		}
+		alignas(16) float arrLane[LANE_COUNT];
+		_mm_store_ps(arrLane, value);
+		std::copy(arrLane, arrLane + laneCount, pOut);
+	}
+
+	// Unit face normals and corner angles for four triangles at a time
+	void computeFaces(const std::vector<SVertex>& vecVertex, const std::vector<uint32_t>& vecIndex,
+					  const size_t firstTriangle, const size_t endTriangle, SFaceData& faces)
+	{
+		for (auto triangle = firstTriangle; triangle < endTriangle; triangle += LANE_COUNT)
+		{
+			const auto laneCount = std::min(LANE_COUNT, endTriangle - triangle);
+
+			// Transpose the corners into one register per coordinate, the tail repeats its last triangle
+			alignas(16) float arrCoordinate[3][3][LANE_COUNT];
+			for (size_t lane = 0; lane != LANE_COUNT; ++lane)
+			{
+				const auto laneTriangle = triangle + std::min(lane, laneCount - 1);
+				for (size_t corner = 0; corner != 3; ++corner)
+				{
+					const auto& position = vecVertex[vecIndex[laneTriangle * 3 + corner]].Position;
+					arrCoordinate[corner][0][lane] = position.x;
+					arrCoordinate[corner][1][lane] = position.y;
+					arrCoordinate[corner][2][lane] = position.z;
+				}
+			}
+
+			__m128 arrPosition[3][3];
+			for (size_t corner = 0; corner != 3; ++corner)
+			{
+				for (size_t axis = 0; axis != 3; ++axis)
+				{
+					arrPosition[corner][axis] = _mm_load_ps(arrCoordinate[corner][axis]);
+				}
+			}
+
+			// Edge leaving each corner towards the next one
+			__m128 arrEdge[3][3];
+			for (size_t corner = 0; corner != 3; ++corner)
+			{
+				for (size_t axis = 0; axis != 3; ++axis)
+				{
+					arrEdge[corner][axis] = _mm_sub_ps(arrPosition[(corner + 1) % 3][axis], arrPosition[corner][axis]);
+				}
+			}
+
+			// cross(p1 - p0, p2 - p0) == cross(edge 2, edge 0)
+			__m128 arrNormal[3];
+			for (size_t axis = 0; axis != 3; ++axis)
+			{
+				const auto axis1 = (axis + 1) % 3;
+				const auto axis2 = (axis + 2) % 3;
+				arrNormal[axis] = _mm_sub_ps(_mm_mul_ps(arrEdge[2][axis1], arrEdge[0][axis2]),
+											 _mm_mul_ps(arrEdge[2][axis2], arrEdge[0][axis1]));
+			}
+			const auto inverseNormalLength = inverseLength(arrNormal);
+			storeLanes(&faces.VecNormalX[triangle], _mm_mul_ps(arrNormal[0], inverseNormalLength), laneCount);
+			storeLanes(&faces.VecNormalY[triangle], _mm_mul_ps(arrNormal[1], inverseNormalLength), laneCount);
+			storeLanes(&faces.VecNormalZ[triangle], _mm_mul_ps(arrNormal[2], inverseNormalLength), laneCount);
+
+			// The angle at a corner lies between its outgoing edge and the reversed incoming one
+			const __m128 arrInverseEdgeLength[3] = {
+				inverseLength(arrEdge[0]), inverseLength(arrEdge[1]), inverseLength(arrEdge[2])
+			};
+			const auto isValidFace = _mm_cmpgt_ps(inverseNormalLength, _mm_setzero_ps());
+			for (size_t corner = 0; corner != 3; ++corner)
+			{
+				const auto previous = (corner + 2) % 3;
+				const auto cosine = _mm_mul_ps(_mm_sub_ps(_mm_setzero_ps(), dot3(arrEdge[corner], arrEdge[previous])),
+											   _mm_mul_ps(arrInverseEdgeLength[corner], arrInverseEdgeLength[previous]));
+				const auto angle = _mm_and_ps(isValidFace, acosApproximation(cosine));
+				storeLanes(&faces.ArrVecCornerAngle[corner][triangle], angle, laneCount);
+			}
+		}
+	}
+
+	glm::vec3 normalizeOrZero(const glm::vec3& v)
+	{
+		const auto length = glm::length(v);
+		return length > 0.0f ? v / length : glm::vec3(0.0f);
+	}
+
+	// Reused from one position to the next by the thread that owns them
+	struct SCornerScratch
+	{
+		std::vector<glm::vec3> VecFaceNormal;
+		std::vector<glm::vec3> VecWeightedNormal;
+		std::vector<glm::vec3> VecNormal;
+	};
+
+	// Normal at every corner around one position, from the faces there that lie within the crease angle of the
+	// corner's own face. Degenerate faces have no normal to compare against and smooth over every face instead
+	void computeCornerNormals(const SFaceData& faces, const uint32_t* pBegin, const uint32_t* pEnd, const bool isSmooth,
+							  const float creaseCosine, SCornerScratch& scratch)
+	{
+		const auto cornerCount = static_cast<size_t>(pEnd - pBegin);
+		scratch.VecFaceNormal.resize(cornerCount);
+		scratch.VecWeightedNormal.resize(cornerCount);
+		scratch.VecNormal.resize(cornerCount);
+
+		auto smoothNormal = glm::vec3(0.0f);
+		for (size_t i = 0; i != cornerCount; ++i)
+		{
+			const auto triangle = pBegin[i] / 3;
+			scratch.VecFaceNormal[i] = glm::vec3(faces.VecNormalX[triangle], faces.VecNormalY[triangle], faces.VecNormalZ[triangle]);
+			scratch.VecWeightedNormal[i] = scratch.VecFaceNormal[i] * faces.ArrVecCornerAngle[pBegin[i] % 3][triangle];
+			smoothNormal += scratch.VecWeightedNormal[i];
+		}
+		smoothNormal = normalizeOrZero(smoothNormal);
+		if (isSmooth)
+		{
+			std::fill(scratch.VecNormal.begin(), scratch.VecNormal.end(), smoothNormal);
+			return;
+		}
+
+		for (size_t i = 0; i != cornerCount; ++i)
+		{
+			auto normal = glm::vec3(0.0f);
+			for (size_t j = 0; j != cornerCount; ++j)
+			{
+				if (glm::dot(scratch.VecFaceNormal[i], scratch.VecFaceNormal[j]) >= creaseCosine)
+					normal += scratch.VecWeightedNormal[j];
+			}
+			normal = normalizeOrZero(normal);
+			scratch.VecNormal[i] = normal != glm::vec3(0.0f) ? normal : smoothNormal;
+		}
+	}
+}
+
+void CNormalGenerator::Generate(std::vector<SVertex>& vecVertex, std::vector<uint32_t>& vecIndex, const float creaseAngle,
+								uint32_t threadCount)
+{
+	const auto triangleCount = vecIndex.size() / 3;
+	if (triangleCount == 0)
+		return;
+	if (threadCount == 0)
+		threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+	SFaceData faces;
+	faces.VecNormalX.resize(triangleCount);
+	faces.VecNormalY.resize(triangleCount);
+	faces.VecNormalZ.resize(triangleCount);
+	for (auto& vecCornerAngle : faces.ArrVecCornerAngle)
+	{
+		vecCornerAngle.resize(triangleCount);
+	}
+	parallelFor(triangleCount, MIN_TRIANGLES_PER_THREAD, threadCount, [&](const size_t begin, const size_t end, size_t)
+	{
+		computeFaces(vecVertex, vecIndex, begin, end, faces);
+	});
+
+	// The OBJ welding kept vertices that differ in texture coordinates apart, weld again on position alone
+	std::vector<uint32_t> vecPositionId(vecVertex.size());
+	size_t positionCount;
+	{
+		std::vector<SVertex> vecPosition;
+		CVertexWelder welder(vecVertex.size());
+		for (size_t vertex = 0; vertex != vecVertex.size(); ++vertex)
+		{
+			SVertex key = {};
+			key.Position = vecVertex[vertex].Position;
+			vecPositionId[vertex] = welder.Weld(key, vecPosition);
+		}
+		positionCount = vecPosition.size();
+	}
+
+	// Position to corner adjacency, stored as compressed rows
+	std::vector<uint32_t> vecCornerStart(positionCount + 1, 0);
+	for (const auto index : vecIndex)
+	{
+		++vecCornerStart[vecPositionId[index] + 1];
+	}
+	for (size_t position = 0; position != positionCount; ++position)
+	{
+		vecCornerStart[position + 1] += vecCornerStart[position];
+	}
+	std::vector<uint32_t> vecCorner(vecIndex.size());
+	{
+		std::vector<uint32_t> vecFill(vecCornerStart.begin(), vecCornerStart.end() - 1);
+		for (size_t corner = 0; corner != vecIndex.size(); ++corner)
+		{
+			vecCorner[vecFill[vecPositionId[vecIndex[corner]]]++] = static_cast<uint32_t>(corner);
+		}
+	}
+
+	const auto isSmooth = creaseAngle >= 180.0f;
+	const auto creaseCosine = std::cos(glm::radians(creaseAngle));
+	if (isSmooth)
+	{
+		// Every corner around a position agrees, and every vertex belongs to exactly one position
+		parallelFor(positionCount, MIN_POSITIONS_PER_THREAD, threadCount, [&](const size_t begin, const size_t end, size_t)
+		{
+			SCornerScratch scratch;
+			for (auto position = begin; position != end; ++position)
+			{
+				const auto pBegin = vecCorner.data() + vecCornerStart[position];
+				const auto pEnd = vecCorner.data() + vecCornerStart[position + 1];
+				computeCornerNormals(faces, pBegin, pEnd, true, creaseCosine, scratch);
+				for (size_t i = 0; i != scratch.VecNormal.size(); ++i)
+				{
+					vecVertex[vecIndex[pBegin[i]]].Normal = scratch.VecNormal[i];
+				}
+			}
+		});
+		return;
+	}
+
+	// Corners of one vertex that end up on different sides of a crease need vertices of their own. The first
+	// pass only counts them per range, so the second can append them at known offsets without locking
+	const auto splitVertices = [&](const size_t begin, const size_t end, const uint32_t firstNewVertex, const bool isWriting)
+	{
+		SCornerScratch scratch;
+		std::vector<uint32_t> vecCornerVertex;
+		std::vector<uint32_t> vecCornerOutput;
+		uint32_t splitCount = 0;
+		for (auto position = begin; position != end; ++position)
+		{
+			const auto pBegin = vecCorner.data() + vecCornerStart[position];
+			const auto pEnd = vecCorner.data() + vecCornerStart[position + 1];
+			const auto cornerCount = static_cast<size_t>(pEnd - pBegin);
+			computeCornerNormals(faces, pBegin, pEnd, false, creaseCosine, scratch);
+			const auto& vecCornerNormal = scratch.VecNormal;
+			vecCornerVertex.resize(cornerCount);
+			vecCornerOutput.resize(cornerCount);
+			for (size_t i = 0; i != cornerCount; ++i)
+			{
+				vecCornerVertex[i] = vecIndex[pBegin[i]];
+			}
+
+			for (size_t i = 0; i != cornerCount; ++i)
+			{
+				auto isFirstUse = true;
+				auto isShared = false;
+				for (size_t j = 0; j != i && !isShared; ++j)
+				{
+					if (vecCornerVertex[j] != vecCornerVertex[i])
+						continue;
+					isFirstUse = false;
+					if (vecCornerNormal[j] == vecCornerNormal[i])
+					{
+						vecCornerOutput[i] = vecCornerOutput[j];
+						isShared = true;
+					}
+				}
+				if (isShared)
+					continue;
+
+				if (isFirstUse)
+				{
+					vecCornerOutput[i] = vecCornerVertex[i];
+				}
+				else
+				{
+					vecCornerOutput[i] = firstNewVertex + splitCount++;
+					if (isWriting)
+						vecVertex[vecCornerOutput[i]] = vecVertex[vecCornerVertex[i]];
+				}
+				if (isWriting)
+					vecVertex[vecCornerOutput[i]].Normal = vecCornerNormal[i];
+			}
+
+			if (isWriting)
+			{
+				for (size_t i = 0; i != cornerCount; ++i)
+				{
+					vecIndex[pBegin[i]] = vecCornerOutput[i];
+				}
+			}
+		}
+		return splitCount;
+	};
+
+	std::vector<uint32_t> vecRangeFirstVertex(threadCount, 0);
+	parallelFor(positionCount, MIN_POSITIONS_PER_THREAD, threadCount, [&](const size_t begin, const size_t end, const size_t range)
+	{
+		vecRangeFirstVertex[range] = splitVertices(begin, end, 0, false);
+	});
+	auto vertexCount = static_cast<uint32_t>(vecVertex.size());
+	for (auto& firstVertex : vecRangeFirstVertex)
+	{
+		const auto splitCount = firstVertex;
+		firstVertex = vertexCount;
+		vertexCount += splitCount;
+	}
+	vecVertex.resize(vertexCount);
+	parallelFor(positionCount, MIN_POSITIONS_PER_THREAD, threadCount, [&](const size_t begin, const size_t end, const size_t range)
+	{
+		splitVertices(begin, end, vecRangeFirstVertex[range], true);
+	});
+}
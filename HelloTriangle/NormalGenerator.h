@@ -0,0 +1,17 @@
+#pragma once
+#include "CommonStructs.h"
+
+#include <vector>
+
+// Smooth vertex normals for meshes that come without them. Every face normal is weighted by the
+// angle of the corner it meets the vertex with, so the result doesn't depend on how the surface
+// was triangulated. Vertices sharing a position share a normal, which keeps UV seams smooth
+class CNormalGenerator
+{
+public:
+	// Faces meeting at more than creaseAngle degrees don't smooth into each other, vertices on
+	// such a crease are split and the index buffer updated. 180 smooths across every edge.
+	// Zero threadCount picks one thread per hardware thread
+	static void Generate(std::vector<SVertex>& vecVertex, std::vector<uint32_t>& vecIndex, float creaseAngle = 180.0f,
+						 uint32_t threadCount = 0);
+};
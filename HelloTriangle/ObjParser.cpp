@@ -0,0 +1,417 @@
+#include "ObjParser.h"
+#include "MappedFile.h"
+#include "VertexWelder.h"
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <thread>
+
+namespace
+{
+	constexpr size_t MIN_CHUNK_SIZE = 1 << 20;
+	constexpr int32_t MISSING_INDEX = INT32_MIN;
+
+	struct SObjCorner
+	{
+		// Zero based, MISSING_INDEX when the face doesn't reference the attribute
+		int32_t Position;
+		int32_t TexCoord;
+		int32_t Normal;
+		// Bit per attribute, set if the OBJ used a negative index. Those are
+		// stored relative to the chunk and rebased when the chunks are merged
+		uint32_t RelativeMask;
+	};
+
+	struct SObjChunk
+	{
+		std::vector<float> VecPosition;
+		std::vector<float> VecTexCoord;
+		std::vector<float> VecNormal;
+		std::vector<SObjCorner> VecCorner;
+	};
+
+	const double POWERS_OF_TEN[] = {
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+		1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+
+	bool isSpace(const char c)
+	{
+		return c == ' ' || c == '\t' || c == '\r';
+	}
+
+	const char* skipSpaces(const char* p, const char* end)
+	{
+		while (p != end && isSpace(*p))
+			++p;
+		return p;
+	}
+
+	const char* skipLine(const char* p, const char* end)
+	{
+		while (p != end && *p != '\n')
+			++p;
+		return p == end ? end : p + 1;
+	}
+
+	bool isDigit(const char c)
+	{
+		return static_cast<unsigned>(c - '0') < 10;
+	}
+
+	// Eight ASCII characters loaded as one little-endian integer are all digits when every byte
+	// is in 0x30..0x39, which holds when the high nibbles are 3 both before and after adding 6
+	bool isEightDigits(const uint64_t chars)
+	{
+		return ((chars & 0xF0F0F0F0F0F0F0F0) |
+			(((chars + 0x0606060606060606) & 0xF0F0F0F0F0F0F0F0) >> 4)) == 0x3333333333333333;
+	}
+
+	bool isFourDigits(const uint32_t chars)
+	{
+		return ((chars & 0xF0F0F0F0) | (((chars + 0x06060606) & 0xF0F0F0F0) >> 4)) == 0x33333333;
+	}
+
+	// Combines neighbouring digits pairwise with one multiply per step: two digits
+	// into each 16-bit lane, four into each 32-bit lane, then all eight
+	uint32_t parseEightDigits(uint64_t chars)
+	{
+		chars = ((chars & 0x0F0F0F0F0F0F0F0F) * 2561) >> 8;
+		chars = ((chars & 0x00FF00FF00FF00FF) * 6553601) >> 16;
+		return static_cast<uint32_t>(((chars & 0x0000FFFF0000FFFF) * 42949672960001) >> 32);
+	}
+
+	uint32_t parseFourDigits(uint32_t chars)
+	{
+		chars = ((chars & 0x0F0F0F0F) * 2561) >> 8;
+		return ((chars & 0x00FF00FF) * 6553601) >> 16;
+	}
+
+	// Appends the digits at p to mantissa, eight or four at a time while they fit in the 19 digits a
+	// uint64_t holds, one at a time after that. Digits past the 19th are counted in outDroppedCount
+	const char* parseDigits(const char* p, const char* end, uint64_t& mantissa, int& digitCount, int& outDroppedCount)
+	{
+		outDroppedCount = 0;
+		while (end - p >= 8 && digitCount <= 19 - 8)
+		{
+			uint64_t chars;
+			std::memcpy(&chars, p, sizeof(chars));
+			if (!isEightDigits(chars))
+				break;
+			mantissa = mantissa * 100000000 + parseEightDigits(chars);
+			digitCount += 8;
+			p += 8;
+		}
+		if (end - p >= 4 && digitCount <= 19 - 4)
+		{
+			uint32_t chars;
+			std::memcpy(&chars, p, sizeof(chars));
+			if (isFourDigits(chars))
+			{
+				mantissa = mantissa * 10000 + parseFourDigits(chars);
+				digitCount += 4;
+				p += 4;
+			}
+		}
+		for (; p != end && isDigit(*p); ++p)
+		{
+			if (digitCount < 19)
+			{
+				mantissa = mantissa * 10 + static_cast<uint64_t>(*p - '0');
+				++digitCount;
+			}
+			else
+			{
+				++outDroppedCount;
+			}
+		}
+		return p;
+	}
+
+	// Digits are accumulated into a 64-bit integer and scaled once at the end. The
+	// typical OBJ coordinate has six decimals, which parseDigits consumes as a block
+	// of four and two single digits instead of six dependent multiply-adds
+	const char* parseFloat(const char* p, const char* end, float& outValue)
+	{
+		p = skipSpaces(p, end);
+
+		auto negative = false;
+		if (p != end && (*p == '-' || *p == '+'))
+		{
+			negative = *p == '-';
+			++p;
+		}
+
+		uint64_t mantissa = 0;
+		auto digitCount = 0;
+		auto droppedCount = 0;
+		p = parseDigits(p, end, mantissa, digitCount, droppedCount);
+		// Integer digits that didn't fit still scale the value
+		auto exponent = droppedCount;
+		if (p != end && *p == '.')
+		{
+			const auto integerDigitCount = digitCount;
+			p = parseDigits(p + 1, end, mantissa, digitCount, droppedCount);
+			exponent -= digitCount - integerDigitCount;
+		}
+		if (p != end && (*p == 'e' || *p == 'E'))
+		{
+			++p;
+			auto negativeExponent = false;
+			if (p != end && (*p == '-' || *p == '+'))
+			{
+				negativeExponent = *p == '-';
+				++p;
+			}
+			auto explicitExponent = 0;
+			for (; p != end && isDigit(*p); ++p)
+			{
+				if (explicitExponent < 10000)
+					explicitExponent = explicitExponent * 10 + (*p - '0');
+			}
+			exponent += negativeExponent ? -explicitExponent : explicitExponent;
+		}
+
+		auto value = static_cast<double>(mantissa);
+		if (exponent < 0)
+		{
+			for (; exponent < -22; exponent += 22)
+				value /= POWERS_OF_TEN[22];
+			value /= POWERS_OF_TEN[-exponent];
+		}
+		else
+		{
+			for (; exponent > 22; exponent -= 22)
+				value *= POWERS_OF_TEN[22];
+			value *= POWERS_OF_TEN[exponent];
+		}
+
+		outValue = static_cast<float>(negative ? -value : value);
+		return p;
+	}
+
+	const char* parseInt(const char* p, const char* end, int32_t& outValue)
+	{
+		auto negative = false;
+		if (p != end && *p == '-')
+		{
+			negative = true;
+			++p;
+		}
+		int32_t value = 0;
+		for (; p != end && isDigit(*p); ++p)
+			value = value * 10 + (*p - '0');
+		outValue = negative ? -value : value;
+		return p;
+	}
+
+	// Turns an OBJ index (1-based, or negative relative to the current count) into a
+	// zero based one. Returns true if the index was relative
+	bool resolveIndex(const int32_t objIndex, const size_t localCount, int32_t& outIndex)
+	{
+		if (objIndex < 0)
+		{
+			outIndex = static_cast<int32_t>(localCount) + objIndex;
+			return true;
+		}
+		outIndex = objIndex - 1;
+		return false;
+	}
+
+	const char* parseCorner(const char* p, const char* end, const SObjChunk& chunk, SObjCorner& outCorner)
+	{
+		int32_t objIndex = 0;
+		outCorner = { MISSING_INDEX, MISSING_INDEX, MISSING_INDEX, 0 };
+
+		p = parseInt(p, end, objIndex);
+		if (resolveIndex(objIndex, chunk.VecPosition.size() / 3, outCorner.Position))
+			outCorner.RelativeMask |= 1;
+
+		if (p != end && *p == '/')
+		{
+			++p;
+			if (p != end && *p != '/')
+			{
+				p = parseInt(p, end, objIndex);
+				if (resolveIndex(objIndex, chunk.VecTexCoord.size() / 2, outCorner.TexCoord))
+					outCorner.RelativeMask |= 2;
+			}
+			if (p != end && *p == '/')
+			{
+				p = parseInt(p + 1, end, objIndex);
+				if (resolveIndex(objIndex, chunk.VecNormal.size() / 3, outCorner.Normal))
+					outCorner.RelativeMask |= 4;
+			}
+		}
+		return p;
+	}
+
+	void parseChunk(const char* p, const char* end, SObjChunk& chunk)
+	{
+		// Reused for every face of the chunk, so it only allocates when a face has more corners than any before it
+		std::vector<SObjCorner> vecPolygon;
+
+		while (p != end)
+		{
+			p = skipSpaces(p, end);
+			if (p == end)
+				break;
+
+			if (p[0] == 'v' && p + 1 != end && isSpace(p[1]))
+			{
+				float x, y, z;
+				p = parseFloat(p + 2, end, x);
+				p = parseFloat(p, end, y);
+				p = parseFloat(p, end, z);
+				chunk.VecPosition.insert(chunk.VecPosition.end(), { x, y, z });
+			}
+			else if (p[0] == 'v' && p + 2 < end && p[1] == 't' && isSpace(p[2]))
+			{
+				float u, v;
+				p = parseFloat(p + 3, end, u);
+				p = parseFloat(p, end, v);
+				chunk.VecTexCoord.insert(chunk.VecTexCoord.end(), { u, v });
+			}
+			else if (p[0] == 'v' && p + 2 < end && p[1] == 'n' && isSpace(p[2]))
+			{
+				float x, y, z;
+				p = parseFloat(p + 3, end, x);
+				p = parseFloat(p, end, y);
+				p = parseFloat(p, end, z);
+				chunk.VecNormal.insert(chunk.VecNormal.end(), { x, y, z });
+			}
+			else if (p[0] == 'f' && p + 1 != end && isSpace(p[1]))
+			{
+				vecPolygon.clear();
+				p = skipSpaces(p + 1, end);
+				while (p != end && *p != '\n')
+				{
+					const auto pCorner = p;
+					p = parseCorner(p, end, chunk, vecPolygon.emplace_back());
+					// Anything that isn't a corner ends the face, the rest of the line is skipped
+					if (p == pCorner)
+					{
+						vecPolygon.pop_back();
+						break;
+					}
+					p = skipSpaces(p, end);
+				}
+				for (size_t corner = 2; corner < vecPolygon.size(); ++corner)
+				{
+					chunk.VecCorner.push_back(vecPolygon[0]);
+					chunk.VecCorner.push_back(vecPolygon[corner - 1]);
+					chunk.VecCorner.push_back(vecPolygon[corner]);
+				}
+			}
+			p = skipLine(p, end);
+		}
+	}
+}
+
+bool CObjParser::Parse(const std::string& filename, std::vector<SVertex>& outVecVertex, std::vector<uint32_t>& outVecIndex,
+					   bool& outHasNormals, uint32_t threadCount)
+{
+	const CMappedFile mappedFile(filename.c_str());
+	if (!mappedFile.IsOpen())
+		return false;
+
+	const auto pBegin = mappedFile.GetData();
+	const auto pEnd = pBegin + mappedFile.GetSize();
+
+	if (threadCount == 0)
+		threadCount = std::max(1u, std::thread::hardware_concurrency());
+	const auto chunkCount = std::clamp<size_t>(mappedFile.GetSize() / MIN_CHUNK_SIZE, 1, threadCount);
+
+	// Split at line boundaries so no record straddles two chunks
+	std::vector<const char*> vecChunkBegin(chunkCount + 1, pEnd);
+	vecChunkBegin[0] = pBegin;
+	for (size_t chunk = 1; chunk < chunkCount; ++chunk)
+	{
+		const auto pSplit = std::max(vecChunkBegin[chunk - 1], pBegin + mappedFile.GetSize() * chunk / chunkCount);
+		vecChunkBegin[chunk] = skipLine(pSplit, pEnd);
+	}
+
+	std::vector<SObjChunk> vecChunk(chunkCount);
+	std::vector<std::thread> vecThread;
+	vecThread.reserve(chunkCount - 1);
+	for (size_t chunk = 1; chunk < chunkCount; ++chunk)
+	{
+		vecThread.emplace_back(parseChunk, vecChunkBegin[chunk], vecChunkBegin[chunk + 1], std::ref(vecChunk[chunk]));
+	}
+	parseChunk(vecChunkBegin[0], vecChunkBegin[1], vecChunk[0]);
+	for (auto& thread : vecThread)
+	{
+		thread.join();
+	}
+
+	// Concatenate the attribute arrays, remembering where every chunk starts
+	std::vector<float> vecPosition, vecTexCoord, vecNormal;
+	std::vector<size_t> vecPositionBase(chunkCount), vecTexCoordBase(chunkCount), vecNormalBase(chunkCount);
+	size_t cornerCount = 0;
+	for (size_t chunk = 0; chunk != chunkCount; ++chunk)
+	{
+		vecPositionBase[chunk] = vecPosition.size() / 3;
+		vecTexCoordBase[chunk] = vecTexCoord.size() / 2;
+		vecNormalBase[chunk] = vecNormal.size() / 3;
+		vecPosition.insert(vecPosition.end(), vecChunk[chunk].VecPosition.begin(), vecChunk[chunk].VecPosition.end());
+		vecTexCoord.insert(vecTexCoord.end(), vecChunk[chunk].VecTexCoord.begin(), vecChunk[chunk].VecTexCoord.end());
+		vecNormal.insert(vecNormal.end(), vecChunk[chunk].VecNormal.begin(), vecChunk[chunk].VecNormal.end());
+		cornerCount += vecChunk[chunk].VecCorner.size();
+	}
+	const auto positionCount = vecPosition.size() / 3;
+	const auto texCoordCount = vecTexCoord.size() / 2;
+	const auto normalCount = vecNormal.size() / 3;
+
+	outVecIndex.reserve(outVecIndex.size() + cornerCount);
+	outVecVertex.reserve(outVecVertex.size() + positionCount);
+
+	outHasNormals = true;
+	CVertexWelder welder(cornerCount);
+	for (size_t chunk = 0; chunk != chunkCount; ++chunk)
+	{
+		for (const auto& corner : vecChunk[chunk].VecCorner)
+		{
+			const auto position = static_cast<int64_t>(corner.Position) +
+				((corner.RelativeMask & 1) ? static_cast<int64_t>(vecPositionBase[chunk]) : 0);
+			const auto texCoord = static_cast<int64_t>(corner.TexCoord) +
+				((corner.RelativeMask & 2) ? static_cast<int64_t>(vecTexCoordBase[chunk]) : 0);
+			const auto normal = static_cast<int64_t>(corner.Normal) +
+				((corner.RelativeMask & 4) ? static_cast<int64_t>(vecNormalBase[chunk]) : 0);
+
+			if (position < 0 || static_cast<size_t>(position) >= positionCount ||
+				(corner.TexCoord != MISSING_INDEX && (texCoord < 0 || static_cast<size_t>(texCoord) >= texCoordCount)) ||
+				(corner.Normal != MISSING_INDEX && (normal < 0 || static_cast<size_t>(normal) >= normalCount)))
+			{
+				std::cout << filename << ": face references a missing vertex" << std::endl;
+				return false;
+			}
+
+			SVertex vertex = {};
+			vertex.Position.x = vecPosition[3 * position + 0];
+			vertex.Position.y = vecPosition[3 * position + 1];
+			vertex.Position.z = vecPosition[3 * position + 2];
+
+			if (corner.TexCoord != MISSING_INDEX)
+			{
+				vertex.TextureCoords.x = vecTexCoord[2 * texCoord + 0];
+				vertex.TextureCoords.y = 1.0f - vecTexCoord[2 * texCoord + 1];
+			}
+
+			if (corner.Normal != MISSING_INDEX)
+			{
+				vertex.Normal.x = vecNormal[3 * normal + 0];
+				vertex.Normal.y = vecNormal[3 * normal + 1];
+				vertex.Normal.z = vecNormal[3 * normal + 2];
+			}
+			else
+			{
+				outHasNormals = false;
+			}
+
+			outVecIndex.push_back(welder.Weld(vertex, outVecVertex));
+		}
+	}
+
+	return true;
+}
@@ -0,0 +1,17 @@
+#pragma once
+#include "CommonStructs.h"
+
+#include <string>
+#include <vector>
+
+// Multithreaded OBJ reader for the v/vt/vn/f subset we use. The file is memory-mapped,
+// split into chunks at line boundaries and every chunk is parsed on its own thread.
+// Faces with more than three corners are triangulated as fans, like tinyobj does
+class CObjParser
+{
+public:
+	// Returns false if the file can't be opened or references attributes it doesn't contain.
+	// outHasNormals is cleared if any face corner comes without a normal
+	static bool Parse(const std::string& filename, std::vector<SVertex>& outVecVertex, std::vector<uint32_t>& outVecIndex,
+					  bool& outHasNormals, uint32_t threadCount = 0);
+};
@@ -0,0 +1,52 @@
+#include "ObjectCuller.h"
+
+#include <algorithm>
+
+std::array<glm::vec4, 6> CObjectCuller::GetFrustumPlanes(const glm::mat4& viewProjection)
+{
+	const auto row = [&viewProjection](const int index)
+	{
+		return glm::vec4(viewProjection[0][index], viewProjection[1][index],
+						 viewProjection[2][index], viewProjection[3][index]);
+	};
+	std::array<glm::vec4, 6> arrPlane = {
+		row(3) + row(0),
+		row(3) - row(0),
+		row(3) + row(1),
+		row(3) - row(1),
+		row(2),
+		row(3) - row(2)
+	};
+	for (auto& plane : arrPlane)
+	{
+		plane = plane * (1.0f / glm::length(glm::vec3(plane)));
+	}
+	return arrPlane;
+}
+
+bool CObjectCuller::IsVisible(const std::array<glm::vec4, 6>& arrPlane, const glm::mat4& model, const glm::vec4& boundingSphere)
+{
+	const auto center = glm::vec3(model * glm::vec4(glm::vec3(boundingSphere), 1.0f));
+	const auto scale = std::max({ glm::length(glm::vec3(model[0])),
+								  glm::length(glm::vec3(model[1])),
+								  glm::length(glm::vec3(model[2])) });
+	const auto radius = boundingSphere.w * scale;
+	for (const auto& plane : arrPlane)
+	{
+		if (glm::dot(glm::vec3(plane), center) + plane.w < -radius)
+			return false;
+	}
+	return true;
+}
+
+VkDrawIndexedIndirectCommand CObjectCuller::GetDrawCommand(const std::array<glm::vec4, 6>& arrPlane, const glm::mat4& model,
+															const SGpuCullObject& cullObject, const uint32_t commandIndex)
+{
+	VkDrawIndexedIndirectCommand command;
+	command.indexCount = cullObject.IndexCount;
+	command.instanceCount = IsVisible(arrPlane, model, cullObject.BoundingSphere) ? 1 : 0;
+	command.firstIndex = cullObject.FirstIndex;
+	command.vertexOffset = cullObject.VertexOffset;
+	command.firstInstance = commandIndex;
+	return command;
+}
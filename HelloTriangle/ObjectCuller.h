@@ -0,0 +1,33 @@
+#pragma once
+#include "CommonStructs.h"
+
+#include <array>
+
+// Input of one object to Shaders/cullObjects.comp, laid out like CullObject there (std430)
+struct SGpuCullObject
+{
+	// Mesh space center and radius
+	glm::vec4 BoundingSphere = glm::vec4(0.0f);
+	// Into the object transforms
+	uint32_t ObjectIndex = 0;
+	// Absolute in the geometry arena, like the draw command
+	uint32_t FirstIndex = 0;
+	uint32_t IndexCount = 0;
+	int32_t VertexOffset = 0;
+};
+
+// Whole object frustum culling against a bounding sphere. This is the CPU reference for Shaders/cullObjects.comp
+// and has to be kept in step with it, the draw commands it returns are the ones the shader writes
+class CObjectCuller
+{
+public:
+	// Gribb and Hartmann plane extraction, normalized, for a clip space depth range of [0, 1]. With the
+	// view projection matrix the planes are in world space
+	[[nodiscard]] static std::array<glm::vec4, 6> GetFrustumPlanes(const glm::mat4& viewProjection);
+	// The sphere is scaled by the largest axis scale of the model matrix
+	[[nodiscard]] static bool IsVisible(const std::array<glm::vec4, 6>& arrPlane, const glm::mat4& model, const glm::vec4& boundingSphere);
+	// One instance of the object when visible, none otherwise. The command's first instance is its own index,
+	// which the vertex shader maps back to the object
+	[[nodiscard]] static VkDrawIndexedIndirectCommand GetDrawCommand(const std::array<glm::vec4, 6>& arrPlane, const glm::mat4& model,
+																	 const SGpuCullObject& cullObject, uint32_t commandIndex);
+};
@@ -0,0 +1,106 @@
+#include "ParallelRecorder.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace
+{
+	// Fewer draws than that record faster than a worker wakes up
+	constexpr size_t MIN_DRAWS_PER_THREAD = 256;
+}
+
+void CParallelRecorder::Init(const VkDevice& device, const uint32_t queueFamily, CThreadPool& threadPool)
+{
+	this->device = device;
+	this->queueFamily = queueFamily;
+	pThreadPool = &threadPool;
+	maxThreadCount = threadPool.GetWorkerCount() + 1;
+}
+
+void CParallelRecorder::Cleanup()
+{
+	DestroyFrameResources();
+	pThreadPool = nullptr;
+}
+
+void CParallelRecorder::CreateFrameResources(const size_t imageCount)
+{
+	VkCommandPoolCreateInfo commandPoolCreateInfo = {};
+	commandPoolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	commandPoolCreateInfo.queueFamilyIndex = queueFamily;
+	// Everything in them is recorded again every frame
+	commandPoolCreateInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+	VkCommandBufferAllocateInfo allocateInfo = {};
+	allocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+	allocateInfo.commandBufferCount = 1;
+
+	vecFrame.resize(imageCount);
+	for (auto& frame : vecFrame)
+	{
+		frame.vecCommandPool.resize(maxThreadCount);
+		frame.vecCommandBuffer.resize(maxThreadCount);
+		for (uint32_t thread = 0; thread != maxThreadCount; ++thread)
+		{
+			if (vkCreateCommandPool(device, &commandPoolCreateInfo, nullptr, &frame.vecCommandPool[thread]) != VK_SUCCESS)
+			{
+				throw std::runtime_error("Failed to create the recording thread's command pool.");
+			}
+			allocateInfo.commandPool = frame.vecCommandPool[thread];
+			if (vkAllocateCommandBuffers(device, &allocateInfo, &frame.vecCommandBuffer[thread]) != VK_SUCCESS)
+			{
+				throw std::runtime_error("Failed to create the secondary command buffer.");
+			}
+		}
+	}
+}
+
+void CParallelRecorder::DestroyFrameResources()
+{
+	for (auto& frame : vecFrame)
+	{
+		for (const auto commandPool : frame.vecCommandPool)
+		{
+			if (commandPool != nullptr)
+				vkDestroyCommandPool(device, commandPool, nullptr);
+		}
+	}
+	vecFrame.clear();
+}
+
+const std::vector<VkCommandBuffer>& CParallelRecorder::Record(const uint32_t imageIndex, const VkCommandBufferInheritanceInfo& inheritanceInfo,
+															  const size_t drawCount,
+															  const std::function<void(VkCommandBuffer, size_t, size_t)>& recordRange)
+{
+	auto& frame = vecFrame[imageIndex];
+	const auto rangeCount = std::clamp<size_t>(drawCount / MIN_DRAWS_PER_THREAD, 1, maxThreadCount);
+	frame.vecRecorded.assign(frame.vecCommandBuffer.begin(), frame.vecCommandBuffer.begin() + rangeCount);
+
+	const auto recordSecondary = [this, &frame, &inheritanceInfo, &recordRange, drawCount, rangeCount](const size_t range)
+	{
+		if (vkResetCommandPool(device, frame.vecCommandPool[range], 0) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to reset the recording thread's command pool.");
+		}
+
+		VkCommandBufferBeginInfo commandBufferBeginInfo = {};
+		commandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		commandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+		commandBufferBeginInfo.pInheritanceInfo = &inheritanceInfo;
+		const auto commandBuffer = frame.vecCommandBuffer[range];
+		if (vkBeginCommandBuffer(commandBuffer, &commandBufferBeginInfo) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to begin recording the secondary command buffer.");
+		}
+		recordRange(commandBuffer, drawCount * range / rangeCount, drawCount * (range + 1) / rangeCount);
+		if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to record the secondary command buffer end.");
+		}
+	};
+
+	// Each range has its own command pool, whichever thread records it
+	pThreadPool->ParallelFor(rangeCount, recordSecondary);
+	return frame.vecRecorded;
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include "ThreadPool.h"
+
+#include <vulkan/vulkan_core.h>
+
+#include <functional>
+#include <vector>
+
+// Records the draws of a subpass into secondary command buffers across a shared thread pool. The draws are split into
+// at most one range per thread and every swap chain image has a command pool per range, which only the thread recording
+// the range uses, resetting it right before. The caller executes the secondaries from its primary command buffer.
+// Not thread safe
+class CParallelRecorder
+{
+public:
+	// The pools belong to the queue family the primary command buffers are submitted to. The thread pool
+	// must outlive the recorder
+	void Init(const VkDevice& device, uint32_t queueFamily, CThreadPool& threadPool);
+	void Cleanup();
+
+	void CreateFrameResources(size_t imageCount);
+	void DestroyFrameResources();
+
+	// Splits the draws [0, drawCount) into contiguous ranges and calls recordRange on the workers for each of them,
+	// with a secondary command buffer already begun in the inherited subpass. Nothing bound in the primary is
+	// inherited, recordRange binds what it draws with. Only call once the image's last frame has executed. Returns
+	// the secondaries in draw order, valid until the image is recorded again
+	const std::vector<VkCommandBuffer>& Record(uint32_t imageIndex, const VkCommandBufferInheritanceInfo& inheritanceInfo,
+											   size_t drawCount, const std::function<void(VkCommandBuffer, size_t, size_t)>& recordRange);
+
+private:
+	struct SFrame
+	{
+		// One of each per range, the command buffers are freed with their pools
+		std::vector<VkCommandPool> vecCommandPool;
+		std::vector<VkCommandBuffer> vecCommandBuffer;
+		// Those the last Record used
+		std::vector<VkCommandBuffer> vecRecorded;
+	};
+
+	VkDevice device = nullptr;
+	uint32_t queueFamily = 0;
+	// The workers and the calling thread
+	uint32_t maxThreadCount = 1;
+	// Not owned
+	CThreadPool* pThreadPool = nullptr;
+	std::vector<SFrame> vecFrame;
+};
@@ -0,0 +1,92 @@
+#include "SceneDiff.h"
+#include "GameObject.h"
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+	std::string makeKey(const SObjectInformation& objectInformation)
+	{
+		// Neither part can contain a null character, so the key is unambiguous
+		std::string key = objectInformation.ObjectName;
+		key += '\0';
+		key += objectInformation.FileName;
+		return key;
+	}
+
+	bool isSameMesh(const SObjectInformation& lhs, const SObjectInformation& rhs)
+	{
+		return lhs.VertexFormat == rhs.VertexFormat && lhs.BuildMeshlets == rhs.BuildMeshlets &&
+			lhs.CreaseAngle == rhs.CreaseAngle;
+	}
+
+	bool isSameTransform(const STransform& lhs, const STransform& rhs)
+	{
+		return lhs.Position == rhs.Position && lhs.Rotation == rhs.Rotation && lhs.Scale == rhs.Scale;
+	}
+}
+
+SSceneDiff CSceneDiff::Apply(GameObjectVecPtrs& goPtrs, GameObjectVecPtrs edited)
+{
+	// Live indices per key, handed out front to back
+	struct SCandidates
+	{
+		std::vector<size_t> VecIndex;
+		size_t Next = 0;
+	};
+	std::unordered_map<std::string, SCandidates> mapCandidates;
+	mapCandidates.reserve(goPtrs.size());
+	for (size_t index = 0; index != goPtrs.size(); ++index)
+		mapCandidates[makeKey(goPtrs[index]->mObjectInformation)].VecIndex.push_back(index);
+
+	SSceneDiff diff;
+	for (size_t index = 0; index != edited.size(); ++index)
+	{
+		auto& editedObject = edited[index];
+		const auto iter = mapCandidates.find(makeKey(editedObject->mObjectInformation));
+		if (iter == mapCandidates.end() || iter->second.Next == iter->second.VecIndex.size())
+		{
+			++diff.AddedCount;
+			diff.HasStructureChanged = true;
+			continue;
+		}
+
+		const auto liveIndex = iter->second.VecIndex[iter->second.Next];
+		auto& liveObject = goPtrs[liveIndex];
+		if (!isSameMesh(liveObject->mObjectInformation, editedObject->mObjectInformation))
+		{
+			// The live object is left unclaimed and removed below
+			++diff.AddedCount;
+			diff.HasStructureChanged = true;
+			continue;
+		}
+		++iter->second.Next;
+
+		if (isSameTransform(liveObject->mTransform, editedObject->mTransform))
+		{
+			++diff.UnchangedCount;
+		}
+		else
+		{
+			liveObject->mTransform = editedObject->mTransform;
+			++diff.MovedCount;
+		}
+		if (liveIndex != index)
+			diff.HasStructureChanged = true;
+		editedObject = std::move(liveObject);
+	}
+
+	for (const auto& liveObject : goPtrs)
+	{
+		if (liveObject)
+		{
+			++diff.RemovedCount;
+			diff.HasStructureChanged = true;
+		}
+	}
+
+	goPtrs = std::move(edited);
+	return diff;
+}
@@ -0,0 +1,26 @@
+#pragma once
+#include "TypeAliases.h"
+
+#include <cstdint>
+
+struct SSceneDiff
+{
+	uint32_t UnchangedCount = 0;
+	// Kept their mesh, only the transform was edited
+	uint32_t MovedCount = 0;
+	// New entries, or entries whose mesh settings were edited. They have no mesh yet
+	uint32_t AddedCount = 0;
+	uint32_t RemovedCount = 0;
+	// Objects were added, removed or reordered, so draws recorded before refer to the wrong ones
+	bool HasStructureChanged = false;
+};
+
+// Brings the live scene in line with a freshly parsed copy of it while keeping every game object that is
+// still there, along with its mesh. Entries are matched on name and filename, in order of appearance when
+// several share both, and an entry whose vertex format, meshlets or crease angle changed is replaced
+class CSceneDiff
+{
+public:
+	// Afterwards goPtrs has the order of edited. Added objects have a null mModelInformation
+	static SSceneDiff Apply(GameObjectVecPtrs& goPtrs, GameObjectVecPtrs edited);
+};
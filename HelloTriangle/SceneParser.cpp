@@ -0,0 +1,298 @@
+#include "SceneParser.h"
+#include "Common.h"
+#include "GameObject.h"
+#include "MappedFile.h"
+
+#include <rapidjson/error/en.h>
+#include <rapidjson/memorystream.h>
+#include <rapidjson/reader.h>
+
+#include "BinaryScene.h"
+#include "FileReader.h"
+
+#include <rapidjson/document.h>
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <string_view>
+
+namespace
+{
+	// Reserving file size / SCENE_ENTRY_SIZE_ESTIMATE game objects is a heuristic. Entries laid out like those of
+	// Scene.json, with a name and an indented transform, are longer and never grow the vector, but short ones
+	// such as {"Filename":"a.obj"} can
+	constexpr size_t SCENE_ENTRY_SIZE_ESTIMATE = 96;
+
+	enum class EScope : uint8_t
+	{
+		Document,
+		Root,
+		Scene,
+		Entry,
+		Transform,
+		Vector,
+		// Anything nested under a key we don't know, read and dropped
+		Ignored
+	};
+
+	enum class EKey : uint8_t
+	{
+		Unknown,
+		Scene,
+		Filename,
+		Name,
+		VertexFormat,
+		Meshlets,
+		CreaseAngle,
+		Transform,
+		Position,
+		Rotation,
+		Scale
+	};
+
+	EKey findKey(const std::string_view key)
+	{
+		if (key == "Scene") return EKey::Scene;
+		if (key == "Filename") return EKey::Filename;
+		if (key == "Name") return EKey::Name;
+		if (key == "VertexFormat") return EKey::VertexFormat;
+		if (key == "Meshlets") return EKey::Meshlets;
+		if (key == "CreaseAngle") return EKey::CreaseAngle;
+		if (key == "Transform") return EKey::Transform;
+		if (key == "Position") return EKey::Position;
+		if (key == "Rotation") return EKey::Rotation;
+		if (key == "Scale") return EKey::Scale;
+		return EKey::Unknown;
+	}
+
+	// Receives the events for {"Scene": [ { entry }, ... ]} and keeps only the entry being read
+	class CSceneHandler : public rapidjson::BaseReaderHandler<rapidjson::UTF8<>, CSceneHandler>
+	{
+	public:
+		explicit CSceneHandler(GameObjectVecPtrs& goPtrs) : goPtrs(goPtrs)
+		{
+			vecScope.reserve(8);
+			vecScope.push_back(EScope::Document);
+		}
+
+		bool StartObject()
+		{
+			const auto scope = vecScope.back();
+			if (scope == EScope::Document)
+			{
+				vecScope.push_back(EScope::Root);
+			}
+			else if (scope == EScope::Scene)
+			{
+				vecScope.push_back(EScope::Entry);
+				objectInformation = SObjectInformation();
+				transform = STransform(glm::vec3(0.0f), glm::vec3(0.0f), glm::vec3(1.0f));
+			}
+			else if (scope == EScope::Entry && key == EKey::Transform)
+			{
+				vecScope.push_back(EScope::Transform);
+			}
+			else
+			{
+				vecScope.push_back(EScope::Ignored);
+			}
+			return true;
+		}
+
+		bool EndObject(rapidjson::SizeType)
+		{
+			const auto scope = vecScope.back();
+			vecScope.pop_back();
+			if (scope != EScope::Entry)
+				return true;
+
+			if (objectInformation.FileName.empty())
+			{
+				error = "scene entry " + std::to_string(goPtrs.size()) + " has no Filename";
+				return false;
+			}
+			goPtrs.push_back(GameObjectUPtr(new CStaticGameObject(std::move(objectInformation), transform)));
+			return true;
+		}
+
+		bool StartArray()
+		{
+			const auto scope = vecScope.back();
+			if (scope == EScope::Root && key == EKey::Scene)
+			{
+				vecScope.push_back(EScope::Scene);
+			}
+			else if (scope == EScope::Transform && (key == EKey::Position || key == EKey::Rotation || key == EKey::Scale))
+			{
+				vecScope.push_back(EScope::Vector);
+				pVector = key == EKey::Position ? &transform.Position : key == EKey::Rotation ? &transform.Rotation : &transform.Scale;
+				vectorComponent = 0;
+			}
+			else
+			{
+				vecScope.push_back(EScope::Ignored);
+			}
+			return true;
+		}
+
+		bool EndArray(rapidjson::SizeType)
+		{
+			vecScope.pop_back();
+			return true;
+		}
+
+		bool Key(const char* str, const rapidjson::SizeType length, bool)
+		{
+			key = findKey(std::string_view(str, length));
+			return true;
+		}
+
+		bool String(const char* str, const rapidjson::SizeType length, bool)
+		{
+			if (vecScope.back() != EScope::Entry)
+				return true;
+
+			if (key == EKey::Filename)
+				objectInformation.FileName.assign(str, length);
+			else if (key == EKey::Name)
+				objectInformation.ObjectName.assign(str, length);
+			else if (key == EKey::VertexFormat)
+				objectInformation.VertexFormat = std::string_view(str, length) == "Packed" ? EVertexFormat::Packed : EVertexFormat::Float;
+			return true;
+		}
+
+		bool Bool(const bool value)
+		{
+			if (vecScope.back() == EScope::Entry && key == EKey::Meshlets)
+				objectInformation.BuildMeshlets = value;
+			return true;
+		}
+
+		bool Null() { return true; }
+		bool Int(const int value) { return number(value); }
+		bool Uint(const unsigned value) { return number(value); }
+		bool Int64(const int64_t value) { return number(static_cast<double>(value)); }
+		bool Uint64(const uint64_t value) { return number(static_cast<double>(value)); }
+		bool Double(const double value) { return number(value); }
+
+		[[nodiscard]] const std::string& GetError() const { return error; }
+
+	private:
+		bool number(const double value)
+		{
+			const auto scope = vecScope.back();
+			if (scope == EScope::Vector && vectorComponent < 3)
+				(*pVector)[vectorComponent++] = static_cast<float>(value);
+			else if (scope == EScope::Entry && key == EKey::CreaseAngle)
+				objectInformation.CreaseAngle = static_cast<float>(value);
+			return true;
+		}
+
+		GameObjectVecPtrs& goPtrs;
+		std::vector<EScope> vecScope;
+		EKey key = EKey::Unknown;
+		SObjectInformation objectInformation;
+		STransform transform;
+		glm::vec3* pVector = nullptr;
+		int vectorComponent = 0;
+		std::string error;
+	};
+}
+
+void CSceneParser::Parse(const char* filename, GameObjectVecPtrs& goPtrs)
+{
+	const CMappedFile mappedFile(filename);
+	if (!mappedFile.IsOpen())
+		throw std::runtime_error(std::string("Failed to open the scene ") + filename);
+
+	goPtrs.reserve(goPtrs.size() + mappedFile.GetSize() / SCENE_ENTRY_SIZE_ESTIMATE + 1);
+
+	CSceneHandler handler(goPtrs);
+	rapidjson::MemoryStream stream(mappedFile.GetData(), mappedFile.GetSize());
+	rapidjson::Reader reader;
+	const auto result = reader.Parse(stream, handler);
+	if (result.IsError())
+	{
+		std::string message = result.Code() == rapidjson::kParseErrorTermination ?
+			handler.GetError() : rapidjson::GetParseError_En(result.Code());
+		throw std::runtime_error(std::string(filename) + ": " + message + " at offset " + std::to_string(result.Offset()));
+	}
+}
+
+void CSceneParser::Benchmark(const uint32_t objectCount)
+{
+	std::string scene = "{\n\t\"Scene\": [";
+	for (uint32_t object = 0; object != objectCount; ++object)
+	{
+		const auto x = std::to_string(static_cast<float>(object % 100) * 2.0f);
+		const auto y = std::to_string(static_cast<float>(object / 100) * 2.0f);
+		scene += object == 0 ? "{\n" : ", {\n";
+		scene += "\t\t\"Name\": \"Object" + std::to_string(object) + "\",\n";
+		scene += "\t\t\"Filename\": \"Models/Chalet/chalet.obj\",\n";
+		scene += "\t\t\"Transform\": {\n";
+		scene += "\t\t\t\"Position\": [" + x + ", " + y + ", 0.0],\n";
+		scene += "\t\t\t\"Rotation\": [15.0, 25.0, 0.0],\n";
+		scene += "\t\t\t\"Scale\": [0.25, 0.25, 0.25]\n";
+		scene += "\t\t}\n\t}";
+	}
+	scene += "]\n}\n";
+
+	const auto path = (std::filesystem::temp_directory_path() / "SceneBenchmark.json").string();
+	{
+		std::ofstream writeStream(path, std::ios::binary | std::ios::trunc);
+		writeStream.write(scene.data(), static_cast<std::streamsize>(scene.size()));
+	}
+
+	// The way GetSceneHierarchy used to do it: read, copy into a string, build the DOM, walk it
+	auto startTime = std::chrono::high_resolution_clock::now();
+	{
+		GameObjectVecPtrs goPtrs;
+		CFileReader fileReader(path.c_str());
+		std::vector<char> out;
+		fileReader.ReadFile(out);
+		const auto sceneHierarchy = std::string(out.begin(), out.end());
+		rapidjson::Document sceneDoc;
+		sceneDoc.Parse(sceneHierarchy.data());
+
+		const auto& sceneObj = sceneDoc["Scene"];
+		goPtrs.reserve(sceneObj.Size());
+		for (rapidjson::SizeType index = 0; index != sceneObj.Size(); ++index)
+		{
+			const auto& model = sceneObj[index];
+			const auto& position = model["Transform"]["Position"];
+			const auto& rotation = model["Transform"]["Rotation"];
+			const auto& scale = model["Transform"]["Scale"];
+			const STransform transform(glm::vec3(position[0].GetFloat(), position[1].GetFloat(), position[2].GetFloat()),
+									   glm::vec3(rotation[0].GetFloat(), rotation[1].GetFloat(), rotation[2].GetFloat()),
+									   glm::vec3(scale[0].GetFloat(), scale[1].GetFloat(), scale[2].GetFloat()));
+			const SObjectInformation objectInformation(model["Filename"].GetString(), model["Name"].GetString());
+			goPtrs.push_back(GameObjectUPtr(new CStaticGameObject(objectInformation, transform)));
+		}
+	}
+	const auto domTime = std::chrono::duration<float, std::chrono::milliseconds::period>(
+		std::chrono::high_resolution_clock::now() - startTime).count();
+
+	GameObjectVecPtrs vecSaxObject;
+	startTime = std::chrono::high_resolution_clock::now();
+	Parse(path.c_str(), vecSaxObject);
+	const auto saxTime = std::chrono::duration<float, std::chrono::milliseconds::period>(
+		std::chrono::high_resolution_clock::now() - startTime).count();
+
+	const auto binaryPath = (std::filesystem::temp_directory_path() / "SceneBenchmark.scene").string();
+	CBinaryScene::Store(binaryPath.c_str(), vecSaxObject);
+	startTime = std::chrono::high_resolution_clock::now();
+	{
+		GameObjectVecPtrs goPtrs;
+		CBinaryScene::Load(binaryPath.c_str(), goPtrs);
+	}
+	const auto binaryTime = std::chrono::duration<float, std::chrono::milliseconds::period>(
+		std::chrono::high_resolution_clock::now() - startTime).count();
+
+	std::cout << "Scene with " << objectCount << " objects (" << scene.size() / 1024 << " KiB JSON, "
+		<< std::filesystem::file_size(binaryPath) / 1024 << " KiB binary): DOM took " << domTime << " ms, SAX took "
+		<< saxTime << " ms, binary took " << binaryTime << " ms" << std::endl;
+	std::filesystem::remove(path);
+	std::filesystem::remove(binaryPath);
+}
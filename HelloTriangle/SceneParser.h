@@ -0,0 +1,18 @@
+#pragma once
+#include "TypeAliases.h"
+
+#include <cstdint>
+
+// Streams Scene.json through a rapidjson SAX reader straight out of a memory-mapped file.
+// No DOM is built and the file is never copied, every game object is created as soon as
+// the closing brace of its entry is read
+class CSceneParser
+{
+public:
+	// Throws std::runtime_error if the file can't be opened, isn't valid JSON or an entry has no Filename
+	static void Parse(const char* filename, GameObjectVecPtrs& goPtrs);
+
+	// Writes a generated scene with objectCount entries to a temporary file and times Parse
+	// against building a rapidjson DOM from a copy of the file, and against CBinaryScene::Load
+	static void Benchmark(uint32_t objectCount);
+};
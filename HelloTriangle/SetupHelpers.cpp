@@ -98,6 +98,13 @@ bool CSetupHelpers::IsDeviceSuitable(const VkPhysicalDevice& physicalDevice,
 		deviceFeatures.samplerAnisotropy;
 }
 
+bool CSetupHelpers::CheckGpuCullingSupport(const VkPhysicalDevice& physicalDevice)
+{
+	VkPhysicalDeviceFeatures deviceFeatures;
+	vkGetPhysicalDeviceFeatures(physicalDevice, &deviceFeatures);
+	return deviceFeatures.multiDrawIndirect && deviceFeatures.drawIndirectFirstInstance;
+}
+
 SQueueFamilyIndices CSetupHelpers::FindQueueFamilies(const VkPhysicalDevice& device,
                                                      const VkSurfaceKHR& surface)
 {
@@ -145,6 +152,12 @@ SQueueFamilyIndices CSetupHelpers::FindQueueFamilies(const VkPhysicalDevice& dev
 
 		index++;
 	}
+
+	// Graphics queues can transfer too, uploads then share the graphics family
+	if (!indices.TransferFamily.has_value())
+	{
+		indices.TransferFamily = indices.GraphicsFamily;
+	}
 	return indices;
 }
 
@@ -233,22 +246,6 @@ VkExtent2D CSetupHelpers::ChooseSwapExtent(GLFWwindow* pWindow, const VkSurfaceC
 	return actualExtent;
 }
 
-uint32_t CSetupHelpers::FindMemoryType(const VkPhysicalDevice& physicalDevice, const uint32_t typeFilter, const VkMemoryPropertyFlags properties)
-{
-	VkPhysicalDeviceMemoryProperties memoryProperties;
-	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
-
-	for(uint32_t i = 0; i != memoryProperties.memoryTypeCount; i++)
-	{
-		if((typeFilter & (1 << i)) && (memoryProperties.memoryTypes[i].propertyFlags & properties) == properties)
-		{
-			return i;
-		}
-	}
-
-	throw std::runtime_error("Failed to find a suitable memory type.");
-}
-
 VkFormat CSetupHelpers::FindSupportedFormat(const VkPhysicalDevice& physicalDevice, const std::vector<VkFormat>& vecFormat, const VkImageTiling& tiling,
 	const VkFormatFeatureFlags& features)
 {
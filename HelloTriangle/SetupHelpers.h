@@ -35,6 +35,8 @@ public:
 	static bool CheckValidationSupport();
 	static bool IsDeviceSuitable(const VkPhysicalDevice& physicalDevice,
 	                             const VkSurfaceKHR& surface);
+	// Indirect draws with drawCount > 1 and a non-zero firstInstance need these optional features
+	static bool CheckGpuCullingSupport(const VkPhysicalDevice& physicalDevice);
 	static SQueueFamilyIndices FindQueueFamilies(const VkPhysicalDevice& device,
 	                                             const VkSurfaceKHR& surface);
 	static SSwapChainSupportDetails QuerySwapChainSupport(const VkPhysicalDevice& physicalDevice,
@@ -43,7 +45,6 @@ public:
 	static VkPresentModeKHR ChooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes);
 	static VkExtent2D ChooseSwapExtent(GLFWwindow* pWindow, const VkSurfaceCapabilitiesKHR& capabilities);
 
-	static uint32_t FindMemoryType(const VkPhysicalDevice& physicalDevice, uint32_t typeFilter, VkMemoryPropertyFlags properties);
 	static VkFormat FindSupportedFormat(const VkPhysicalDevice& physicalDevice, const std::vector<VkFormat>& vecFormat, const VkImageTiling& tiling, const VkFormatFeatureFlags& features);
 	static VkFormat FindDepthFormat(const VkPhysicalDevice& physicalDevice);
 	static bool HasStencilComponent(const VkFormat& format);
@@ -1,2 +1,2 @@
 @echo off
-for /r %%i in (*.vert, *.frag) do %VULKAN_SDK%/Bin/glslc %%i -o %%~ni.spv
\ No newline at end of file
+for /r %%i in (*.vert, *.frag, *.comp) do %VULKAN_SDK%/Bin/glslc %%i -o %%~ni.spv
\ No newline at end of file
@@ -1,11 +1,28 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
 
-layout(binding=0) uniform UniformBufferObject {
-	mat4 model;
+// Set for the pipeline that draws SPackedVertex meshes
+layout(constant_id=0) const bool PACKED_VERTEX = false;
+
+layout(binding=0) uniform CameraUniform {
 	mat4 view;
 	mat4 projection;
-} ubo;
+} camera;
+
+layout(std430, binding=2) readonly buffer ObjectTransforms {
+	mat4 model[];
+} objects;
+
+// Every instanced draw starts at its group's first instance, so gl_InstanceIndex indexes this directly
+layout(std430, binding=3) readonly buffer InstanceObjects {
+	uint objectIndex[];
+} instances;
+
+// Dequantization of packed positions, only pushed for packed meshes
+layout(push_constant) uniform MeshPushConstants {
+	vec4 positionOffset;
+	vec4 positionScale;
+} mesh;
 
 layout(location=0) in vec3 position;
 layout(location=1) in vec3 normal;
@@ -14,8 +31,25 @@ layout(location=2) in vec2 texCoords;
 layout(location=0) out vec3 fragNormals;
 layout(location=1) out vec2 fragTexCoords;
 
+vec3 decodeOctahedral(vec2 encoded) {
+	vec3 n = vec3(encoded, 1.0f - abs(encoded.x) - abs(encoded.y));
+	float fold = max(-n.z, 0.0f);
+	n.x += n.x >= 0.0f ? -fold : fold;
+	n.y += n.y >= 0.0f ? -fold : fold;
+	return normalize(n);
+}
+
 void main() {
-	gl_Position = ubo.projection * ubo.view * ubo.model * vec4(position, 1.0f);
-	fragNormals = normal;
+	vec3 localPosition = position;
+	vec3 localNormal = normal;
+	if (PACKED_VERTEX) {
+		// The UNORM and SNORM formats have already mapped the integers to [0, 1] and [-1, 1]
+		localPosition = mesh.positionOffset.xyz + position * mesh.positionScale.xyz;
+		localNormal = decodeOctahedral(normal.xy);
+	}
+
+	mat4 model = objects.model[instances.objectIndex[gl_InstanceIndex]];
+	gl_Position = camera.projection * camera.view * model * vec4(localPosition, 1.0f);
+	fragNormals = localNormal;
 	fragTexCoords = texCoords;
 }
\ No newline at end of file
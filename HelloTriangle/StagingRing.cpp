@@ -0,0 +1,215 @@
+#include "StagingRing.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+
+namespace
+{
+	// Covers the texel size of every format copied to images and keeps memcpy destinations aligned
+	constexpr VkDeviceSize REGION_ALIGNMENT = 16;
+}
+
+void CStagingRing::Init(const VkDevice& device, CDeviceMemoryAllocator& allocator, const VkDeviceSize size)
+{
+	this->device = device;
+	pAllocator = &allocator;
+	capacity = size;
+	allocator.CreateBuffer(size,
+						   VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+						   VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+						   ringBuffer);
+}
+
+void CStagingRing::Cleanup(CDeviceMemoryAllocator& allocator)
+{
+	for (auto& inFlight : deqInFlight)
+	{
+		if (inFlight.OverflowBuffer.Buffer != nullptr)
+			allocator.DestroyBuffer(inFlight.OverflowBuffer);
+	}
+	deqInFlight.clear();
+	head = tail = bytesInFlight = 0;
+	allocator.DestroyBuffer(ringBuffer);
+}
+
+bool CStagingRing::TryAllocate(const VkDeviceSize size, SStagingRegion& outRegion)
+{
+	if (size > capacity)
+	{
+		allocateOverflow(size, outRegion);
+		return true;
+	}
+
+	reclaim();
+	return place(size, outRegion);
+}
+
+SStagingRegion CStagingRing::Allocate(const VkDeviceSize size)
+{
+	SStagingRegion region;
+	if (size > capacity)
+	{
+		allocateOverflow(size, region);
+		return region;
+	}
+
+	reclaim();
+	if (place(size, region))
+		return region;
+
+	++statistics.StallCount;
+	const auto startTime = std::chrono::high_resolution_clock::now();
+	do
+	{
+		// Everything in flight is waited for before giving up, so the front exists while there's no room
+		auto& front = deqInFlight.front();
+		if (front.Fence == nullptr)
+		{
+			throw std::runtime_error("The staging ring is full of regions that have not been submitted.");
+		}
+		vkWaitForFences(device, 1, &front.Fence, VK_TRUE, UINT64_MAX);
+		retireFront();
+		reclaim();
+	} while (!place(size, region));
+	statistics.StallMilliseconds += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+	return region;
+}
+
+void CStagingRing::TrackFence(const SStagingRegion& region, const VkFence fence)
+{
+	const auto iter = std::find_if(deqInFlight.begin(), deqInFlight.end(), [&region](const SInFlight& inFlight)
+	{
+		return inFlight.Id == region.Id;
+	});
+	if (iter != deqInFlight.end())
+		iter->Fence = fence;
+}
+
+void CStagingRing::Release(const SStagingRegion& region)
+{
+	const auto iter = std::find_if(deqInFlight.begin(), deqInFlight.end(), [&region](const SInFlight& inFlight)
+	{
+		return inFlight.Id == region.Id;
+	});
+	if (iter == deqInFlight.end())
+		return;
+
+	// The fence may be destroyed once its owner is done, so it's not looked at again
+	iter->IsReleased = true;
+	iter->Fence = nullptr;
+	reclaim();
+}
+
+void CStagingRing::PrintStatistics() const
+{
+	std::cout << "Staging ring of " << capacity / (1024 * 1024) << " MiB: " << statistics.AllocationCount << " uploads, "
+		<< statistics.BytesStaged / (1024 * 1024) << " MiB staged, peak " << statistics.PeakBytesInFlight / (1024 * 1024)
+		<< " MiB in flight, " << statistics.StallCount << " stalls (" << statistics.StallMilliseconds << " ms waiting), "
+		<< statistics.OverflowCount << " larger than the ring" << std::endl;
+}
+
+void CStagingRing::reclaim()
+{
+	while (!deqInFlight.empty())
+	{
+		const auto& front = deqInFlight.front();
+		if (!front.IsReleased && (front.Fence == nullptr || vkGetFenceStatus(device, front.Fence) != VK_SUCCESS))
+			break;
+		retireFront();
+	}
+}
+
+void CStagingRing::retireFront()
+{
+	auto& front = deqInFlight.front();
+	if (front.OverflowBuffer.Buffer != nullptr)
+	{
+		pAllocator->DestroyBuffer(front.OverflowBuffer);
+	}
+	else
+	{
+		bytesInFlight -= front.End - front.Offset;
+	}
+	deqInFlight.pop_front();
+
+	// The space before the next region in the ring, including the padding skipped when wrapping, is free again
+	const auto iter = std::find_if(deqInFlight.begin(), deqInFlight.end(), [](const SInFlight& inFlight)
+	{
+		return inFlight.OverflowBuffer.Buffer == nullptr;
+	});
+	if (iter != deqInFlight.end())
+	{
+		tail = iter->Offset;
+	}
+	else
+	{
+		head = tail = 0;
+	}
+}
+
+bool CStagingRing::place(const VkDeviceSize size, SStagingRegion& outRegion)
+{
+	const auto isEmpty = bytesInFlight == 0;
+	// Zero sized regions still get a byte so that every region has its own place in the ring
+	const auto span = std::max<VkDeviceSize>(size, 1);
+	auto offset = (head + REGION_ALIGNMENT - 1) & ~(REGION_ALIGNMENT - 1);
+
+	if (isEmpty || head > tail)
+	{
+		// In use is [tail, head), free is the end and the start
+		if (offset + span > capacity)
+		{
+			if (span > tail)
+				return false;
+			offset = 0;
+		}
+	}
+	else if (offset + span > tail)
+	{
+		// In use is [tail, capacity) and [0, head), free is what's between
+		return false;
+	}
+
+	head = offset + span;
+	bytesInFlight += span;
+	statistics.PeakBytesInFlight = std::max(statistics.PeakBytesInFlight, bytesInFlight);
+	++statistics.AllocationCount;
+	statistics.BytesStaged += size;
+
+	SInFlight inFlight;
+	inFlight.Id = nextId++;
+	inFlight.Offset = offset;
+	inFlight.End = head;
+	deqInFlight.push_back(inFlight);
+
+	outRegion.Buffer = ringBuffer.Buffer;
+	outRegion.Offset = offset;
+	outRegion.Size = size;
+	outRegion.pData = static_cast<uint8_t*>(ringBuffer.Allocation.pMappedData) + offset;
+	outRegion.Id = inFlight.Id;
+	return true;
+}
+
+void CStagingRing::allocateOverflow(const VkDeviceSize size, SStagingRegion& outRegion)
+{
+	SInFlight inFlight;
+	inFlight.Id = nextId++;
+	pAllocator->CreateBuffer(size,
+							 VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+							 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+							 inFlight.OverflowBuffer,
+							 EAllocationStrategy::Linear);
+	deqInFlight.push_back(inFlight);
+
+	++statistics.AllocationCount;
+	++statistics.OverflowCount;
+	statistics.BytesStaged += size;
+
+	outRegion.Buffer = inFlight.OverflowBuffer.Buffer;
+	outRegion.Offset = 0;
+	outRegion.Size = size;
+	outRegion.pData = static_cast<uint8_t*>(inFlight.OverflowBuffer.Allocation.pMappedData);
+	outRegion.Id = inFlight.Id;
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include "CommonStructs.h"
+#include "DeviceMemoryAllocator.h"
+
+#include <vulkan/vulkan_core.h>
+
+#include <deque>
+
+// Part of the ring handed out for one upload
+struct SStagingRegion
+{
+	VkBuffer Buffer = nullptr;
+	VkDeviceSize Offset = 0;
+	VkDeviceSize Size = 0;
+	// Persistently mapped, points at Offset
+	uint8_t* pData = nullptr;
+	uint64_t Id = 0;
+};
+
+struct SStagingStatistics
+{
+	uint64_t AllocationCount = 0;
+	uint64_t BytesStaged = 0;
+	// Allocate calls that had to wait for the oldest uploads. TryAllocate refusals aren't counted, their
+	// callers retry and know whether a refusal is a new one
+	uint64_t StallCount = 0;
+	double StallMilliseconds = 0.0;
+	// Allocations larger than the ring that got a buffer of their own
+	uint64_t OverflowCount = 0;
+	VkDeviceSize PeakBytesInFlight = 0;
+};
+
+// One persistently mapped host visible buffer that every upload copies its data through. Regions are
+// handed out in order and recycled once the fence of the submission reading them has signaled, or once
+// their owner releases them, whichever comes first. Uploads on the transfer and graphics queues may
+// complete out of order, but regions are only recycled from the oldest one on, so the used part is always
+// one contiguous span that may wrap around. Not thread safe
+class CStagingRing
+{
+public:
+	void Init(const VkDevice& device, CDeviceMemoryAllocator& allocator, VkDeviceSize size);
+	// The device must be done with every region
+	void Cleanup(CDeviceMemoryAllocator& allocator);
+
+	// Returns false instead of waiting when there's no room yet, for uploads that can be retried next frame
+	[[nodiscard]] bool TryAllocate(VkDeviceSize size, SStagingRegion& outRegion);
+	// Waits for the oldest uploads to execute until there's room. Throws std::runtime_error when the ring is
+	// full of regions that have not been submitted
+	[[nodiscard]] SStagingRegion Allocate(VkDeviceSize size);
+	// The region is recycled once the fence signals. The fence must stay alive until the region is released
+	void TrackFence(const SStagingRegion& region, VkFence fence);
+	// The region may be reused straight away. Regions the ring has already recycled are ignored
+	void Release(const SStagingRegion& region);
+
+	[[nodiscard]] const SStagingStatistics& GetStatistics() const { return statistics; }
+	void PrintStatistics() const;
+
+private:
+	struct SInFlight
+	{
+		uint64_t Id = 0;
+		VkDeviceSize Offset = 0;
+		VkDeviceSize End = 0;
+		VkFence Fence = nullptr;
+		bool IsReleased = false;
+		// Only for regions larger than the ring
+		SBuffer OverflowBuffer;
+	};
+
+	// Retires the regions at the front whose upload has executed
+	void reclaim();
+	void retireFront();
+	[[nodiscard]] bool place(VkDeviceSize size, SStagingRegion& outRegion);
+	void allocateOverflow(VkDeviceSize size, SStagingRegion& outRegion);
+
+	VkDevice device = nullptr;
+	CDeviceMemoryAllocator* pAllocator = nullptr;
+	SBuffer ringBuffer;
+	VkDeviceSize capacity = 0;
+	// Next free byte and first byte still in use, equal when nothing is in flight
+	VkDeviceSize head = 0;
+	VkDeviceSize tail = 0;
+	VkDeviceSize bytesInFlight = 0;
+	uint64_t nextId = 1;
+	// Oldest first
+	std::deque<SInFlight> deqInFlight;
+	SStagingStatistics statistics;
+};
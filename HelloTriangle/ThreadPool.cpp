@@ -0,0 +1,128 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <exception>
+#include <memory>
+
+namespace
+{
+	// Shared with the workers, which may only get to it after ParallelFor has returned and find nothing left to do
+	struct SParallelFor
+	{
+		std::function<void(size_t)> Job;
+		size_t RangeCount = 0;
+		std::atomic<size_t> NextRange{ 0 };
+		size_t DoneCount = 0;
+		std::exception_ptr pException;
+		std::mutex DoneMutex;
+		std::condition_variable DoneCondition;
+	};
+
+	void runRanges(SParallelFor& parallelFor)
+	{
+		for (auto range = parallelFor.NextRange++; range < parallelFor.RangeCount; range = parallelFor.NextRange++)
+		{
+			std::exception_ptr pException;
+			try
+			{
+				parallelFor.Job(range);
+			}
+			catch (...)
+			{
+				pException = std::current_exception();
+			}
+
+			std::lock_guard<std::mutex> lock(parallelFor.DoneMutex);
+			if (pException && !parallelFor.pException)
+				parallelFor.pException = pException;
+			if (++parallelFor.DoneCount == parallelFor.RangeCount)
+				parallelFor.DoneCondition.notify_all();
+		}
+	}
+}
+
+CThreadPool::CThreadPool(uint32_t workerCount)
+{
+	if (workerCount == 0)
+		workerCount = std::max(1u, std::thread::hardware_concurrency());
+
+	vecWorker.reserve(workerCount);
+	for (uint32_t i = 0; i != workerCount; ++i)
+	{
+		vecWorker.emplace_back(&CThreadPool::workerLoop, this);
+	}
+}
+
+CThreadPool::~CThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(jobMutex);
+		isStopping = true;
+	}
+	jobCondition.notify_all();
+	for (auto& worker : vecWorker)
+	{
+		worker.join();
+	}
+}
+
+std::future<void> CThreadPool::Submit(std::function<void()> job)
+{
+	std::packaged_task<void()> task(std::move(job));
+	auto future = task.get_future();
+	{
+		std::lock_guard<std::mutex> lock(jobMutex);
+		queueJob.push_back(std::move(task));
+	}
+	jobCondition.notify_one();
+	return future;
+}
+
+void CThreadPool::ParallelFor(const size_t rangeCount, const std::function<void(size_t)>& job)
+{
+	if (rangeCount == 0)
+		return;
+
+	const auto pParallelFor = std::make_shared<SParallelFor>();
+	pParallelFor->Job = job;
+	pParallelFor->RangeCount = rangeCount;
+	const auto helperCount = std::min<size_t>(rangeCount - 1, vecWorker.size());
+	if (helperCount != 0)
+	{
+		{
+			std::lock_guard<std::mutex> lock(jobMutex);
+			for (size_t helper = 0; helper != helperCount; ++helper)
+			{
+				queueJob.emplace_back([pParallelFor]()
+				{
+					runRanges(*pParallelFor);
+				});
+			}
+		}
+		jobCondition.notify_all();
+	}
+
+	runRanges(*pParallelFor);
+	std::unique_lock<std::mutex> lock(pParallelFor->DoneMutex);
+	pParallelFor->DoneCondition.wait(lock, [&pParallelFor] { return pParallelFor->DoneCount == pParallelFor->RangeCount; });
+	if (pParallelFor->pException)
+		std::rethrow_exception(pParallelFor->pException);
+}
+
+void CThreadPool::workerLoop()
+{
+	while (true)
+	{
+		std::packaged_task<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(jobMutex);
+			jobCondition.wait(lock, [this] { return isStopping || !queueJob.empty(); });
+			// Drain the queue before stopping so no future is left without a result
+			if (queueJob.empty())
+				return;
+			task = std::move(queueJob.front());
+			queueJob.pop_front();
+		}
+		task();
+	}
+}
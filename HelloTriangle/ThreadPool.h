@@ -0,0 +1,41 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads pulling jobs from a shared queue
+class CThreadPool
+{
+public:
+	// Zero picks one worker per hardware thread
+	explicit CThreadPool(uint32_t workerCount = 0);
+	~CThreadPool();
+	CThreadPool(const CThreadPool&) = delete;
+	CThreadPool& operator=(const CThreadPool&) = delete;
+	CThreadPool(CThreadPool&&) = delete;
+	CThreadPool& operator=(CThreadPool&&) = delete;
+
+	// Exceptions thrown by the job are rethrown from the returned future
+	[[nodiscard]] std::future<void> Submit(std::function<void()> job);
+	// Calls job(range) once for every range in [0, rangeCount), on the calling thread and on up to rangeCount - 1
+	// workers, and returns once every range has run. The calling thread takes whatever range no worker has started,
+	// so workers busy with long jobs only slow it down. Rethrows the first exception a range threw
+	void ParallelFor(size_t rangeCount, const std::function<void(size_t)>& job);
+
+	[[nodiscard]] uint32_t GetWorkerCount() const { return static_cast<uint32_t>(vecWorker.size()); }
+
+private:
+	void workerLoop();
+
+	std::vector<std::thread> vecWorker;
+	std::deque<std::packaged_task<void()>> queueJob;
+	std::mutex jobMutex;
+	std::condition_variable jobCondition;
+	bool isStopping = false;
+};
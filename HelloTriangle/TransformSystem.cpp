@@ -0,0 +1,268 @@
+#include "TransformSystem.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <emmintrin.h>
+#include <random>
+
+namespace
+{
+	constexpr size_t LANE_COUNT = 4;
+	// Smaller sets aren't worth waking the workers for
+	constexpr size_t MIN_OBJECTS_PER_THREAD = 1 << 13;
+
+	// Rotation in degrees per second times the time, wrapped to [-180, 180] degrees before it's rounded to float.
+	// A float product of the two would be off by a few hundredths of a degree after an hour of spinning
+	__m128 toWrappedRadians(const __m128 rotation, const __m128d time)
+	{
+		const auto wrap = [time](const __m128d rotation)
+		{
+			const auto degrees = _mm_mul_pd(rotation, time);
+			const auto turns = _mm_cvtepi32_pd(_mm_cvtpd_epi32(_mm_mul_pd(degrees, _mm_set1_pd(1.0 / 360.0))));
+			return _mm_cvtpd_ps(_mm_sub_pd(degrees, _mm_mul_pd(turns, _mm_set1_pd(360.0))));
+		};
+		const auto low = wrap(_mm_cvtps_pd(rotation));
+		const auto high = wrap(_mm_cvtps_pd(_mm_movehl_ps(rotation, rotation)));
+		return _mm_mul_ps(_mm_movelh_ps(low, high), _mm_set1_ps(0.0174532925f));
+	}
+
+	// Range reduced to [-pi/4, pi/4] around the nearest multiple of pi/2, then Taylor polynomials. Within 2e-7 of
+	// the exact values for the angles in [-pi, pi] composeRange passes, further out the reduction loses precision
+	void sinCos(const __m128 x, __m128& outSin, __m128& outCos)
+	{
+		const auto quadrant = _mm_cvtps_epi32(_mm_mul_ps(x, _mm_set1_ps(0.636619772f)));
+		const auto quadrantF = _mm_cvtepi32_ps(quadrant);
+		// pi/2 split in two so the reduction keeps its precision
+		auto r = _mm_sub_ps(x, _mm_mul_ps(quadrantF, _mm_set1_ps(1.5703125f)));
+		r = _mm_sub_ps(r, _mm_mul_ps(quadrantF, _mm_set1_ps(4.83826794897e-4f)));
+		const auto r2 = _mm_mul_ps(r, r);
+
+		auto sinPolynomial = _mm_set1_ps(2.75573192e-6f);
+		sinPolynomial = _mm_add_ps(_mm_mul_ps(sinPolynomial, r2), _mm_set1_ps(-1.98412698e-4f));
+		sinPolynomial = _mm_add_ps(_mm_mul_ps(sinPolynomial, r2), _mm_set1_ps(8.33333333e-3f));
+		sinPolynomial = _mm_add_ps(_mm_mul_ps(sinPolynomial, r2), _mm_set1_ps(-1.66666667e-1f));
+		const auto sinR = _mm_add_ps(r, _mm_mul_ps(_mm_mul_ps(sinPolynomial, r2), r));
+
+		auto cosPolynomial = _mm_set1_ps(2.48015873e-5f);
+		cosPolynomial = _mm_add_ps(_mm_mul_ps(cosPolynomial, r2), _mm_set1_ps(-1.38888889e-3f));
+		cosPolynomial = _mm_add_ps(_mm_mul_ps(cosPolynomial, r2), _mm_set1_ps(4.16666667e-2f));
+		cosPolynomial = _mm_add_ps(_mm_mul_ps(cosPolynomial, r2), _mm_set1_ps(-0.5f));
+		const auto cosR = _mm_add_ps(_mm_set1_ps(1.0f), _mm_mul_ps(cosPolynomial, r2));
+
+		// Quadrants 1 and 3 swap sine and cosine, the sine is negated in 2 and 3 and the cosine in 1 and 2
+		const auto one = _mm_set1_epi32(1);
+		const auto isSwapped = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(quadrant, one), one));
+		const auto sinSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(quadrant, _mm_set1_epi32(2)), 30));
+		const auto cosSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(_mm_add_epi32(quadrant, one), _mm_set1_epi32(2)), 30));
+		outSin = _mm_xor_ps(_mm_or_ps(_mm_and_ps(isSwapped, cosR), _mm_andnot_ps(isSwapped, sinR)), sinSign);
+		outCos = _mm_xor_ps(_mm_or_ps(_mm_and_ps(isSwapped, sinR), _mm_andnot_ps(isSwapped, cosR)), cosSign);
+	}
+
+	__m128 gather(const std::vector<float>& vecValue, const uint32_t* pIndex)
+	{
+		return _mm_setr_ps(vecValue[pIndex[0]], vecValue[pIndex[1]], vecValue[pIndex[2]], vecValue[pIndex[3]]);
+	}
+
+	// Writes column k of the four matrices whose rows are given lane by lane
+	void storeColumn(SObjectTransform* pObjectTransform, const uint32_t* pIndex, const size_t laneCount, const int column,
+					 __m128 x, __m128 y, __m128 z, __m128 w)
+	{
+		_MM_TRANSPOSE4_PS(x, y, z, w);
+		const __m128 arrColumn[LANE_COUNT] = { x, y, z, w };
+		for (size_t lane = 0; lane != laneCount; ++lane)
+		{
+			_mm_storeu_ps(&pObjectTransform[pIndex[lane]].Model[column][0], arrColumn[lane]);
+		}
+	}
+}
+
+void CTransformSystem::Resize(const size_t count)
+{
+	const auto oldCount = GetCount();
+	vecPositionX.resize(count);
+	vecPositionY.resize(count);
+	vecPositionZ.resize(count);
+	vecRotationX.resize(count);
+	vecRotationY.resize(count);
+	vecRotationZ.resize(count);
+	vecScaleX.resize(count, 1.0f);
+	vecScaleY.resize(count, 1.0f);
+	vecScaleZ.resize(count, 1.0f);
+	vecIsDirty.resize(count);
+	std::fill(vecIsDirty.begin() + std::min(oldCount, count), vecIsDirty.end(), 1);
+	vecObjectTransform.resize(count);
+	vecVersion.resize(count);
+}
+
+void CTransformSystem::SetTransform(const size_t index, const STransform& transform)
+{
+	const auto isSame = vecPositionX[index] == transform.Position.x && vecPositionY[index] == transform.Position.y &&
+		vecPositionZ[index] == transform.Position.z && vecRotationX[index] == transform.Rotation.x &&
+		vecRotationY[index] == transform.Rotation.y && vecRotationZ[index] == transform.Rotation.z &&
+		vecScaleX[index] == transform.Scale.x && vecScaleY[index] == transform.Scale.y && vecScaleZ[index] == transform.Scale.z;
+	if (isSame)
+		return;
+
+	vecPositionX[index] = transform.Position.x;
+	vecPositionY[index] = transform.Position.y;
+	vecPositionZ[index] = transform.Position.z;
+	vecRotationX[index] = transform.Rotation.x;
+	vecRotationY[index] = transform.Rotation.y;
+	vecRotationZ[index] = transform.Rotation.z;
+	vecScaleX[index] = transform.Scale.x;
+	vecScaleY[index] = transform.Scale.y;
+	vecScaleZ[index] = transform.Scale.z;
+	vecIsDirty[index] = 1;
+}
+
+void CTransformSystem::Update(const double time)
+{
+	vecComposeIndex.clear();
+	for (size_t index = 0; index != GetCount(); ++index)
+	{
+		const auto isSpinning = vecRotationX[index] != 0.0f || vecRotationY[index] != 0.0f || vecRotationZ[index] != 0.0f;
+		if (isSpinning || vecIsDirty[index] != 0)
+			vecComposeIndex.push_back(static_cast<uint32_t>(index));
+	}
+	std::fill(vecIsDirty.begin(), vecIsDirty.end(), 0);
+
+	// Ranges start on whole batches so only the last one has a partial batch
+	const auto count = vecComposeIndex.size();
+	const auto rangeCount = std::clamp<size_t>(count / MIN_OBJECTS_PER_THREAD, 1, maxThreadCount);
+	if (rangeCount == 1)
+	{
+		composeRange(time, 0, count);
+		return;
+	}
+
+	const auto rangeStart = [count, rangeCount](const size_t range)
+	{
+		return range == rangeCount ? count : count * range / rangeCount / LANE_COUNT * LANE_COUNT;
+	};
+	pThreadPool->ParallelFor(rangeCount, [this, time, &rangeStart](const size_t range)
+	{
+		composeRange(time, rangeStart(range), rangeStart(range + 1));
+	});
+}
+
+void CTransformSystem::composeRange(const double time, const size_t begin, const size_t end)
+{
+	const auto timeLanes = _mm_set1_pd(time);
+	const auto zero = _mm_setzero_ps();
+	for (auto batch = begin; batch < end; batch += LANE_COUNT)
+	{
+		// A partial batch repeats its last object in the unused lanes
+		const auto laneCount = std::min(LANE_COUNT, end - batch);
+		uint32_t arrIndex[LANE_COUNT];
+		for (size_t lane = 0; lane != LANE_COUNT; ++lane)
+		{
+			arrIndex[lane] = vecComposeIndex[batch + std::min(lane, laneCount - 1)];
+		}
+
+		__m128 sinX, cosX, sinY, cosY, sinZ, cosZ;
+		sinCos(toWrappedRadians(gather(vecRotationX, arrIndex), timeLanes), sinX, cosX);
+		sinCos(toWrappedRadians(gather(vecRotationY, arrIndex), timeLanes), sinY, cosY);
+		sinCos(toWrappedRadians(gather(vecRotationZ, arrIndex), timeLanes), sinZ, cosZ);
+
+		// Translation * RotationX * RotationY * RotationZ * Scale, multiplied out
+		const auto sinXSinY = _mm_mul_ps(sinX, sinY);
+		const auto cosXSinY = _mm_mul_ps(cosX, sinY);
+		const auto scaleX = gather(vecScaleX, arrIndex);
+		const auto scaleY = gather(vecScaleY, arrIndex);
+		const auto scaleZ = gather(vecScaleZ, arrIndex);
+
+		const auto m00 = _mm_mul_ps(_mm_mul_ps(cosY, cosZ), scaleX);
+		const auto m10 = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(sinXSinY, cosZ), _mm_mul_ps(cosX, sinZ)), scaleX);
+		const auto m20 = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(sinX, sinZ), _mm_mul_ps(cosXSinY, cosZ)), scaleX);
+		const auto m01 = _mm_mul_ps(_mm_sub_ps(zero, _mm_mul_ps(cosY, sinZ)), scaleY);
+		const auto m11 = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(cosX, cosZ), _mm_mul_ps(sinXSinY, sinZ)), scaleY);
+		const auto m21 = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(cosXSinY, sinZ), _mm_mul_ps(sinX, cosZ)), scaleY);
+		const auto m02 = _mm_mul_ps(sinY, scaleZ);
+		const auto m12 = _mm_mul_ps(_mm_sub_ps(zero, _mm_mul_ps(sinX, cosY)), scaleZ);
+		const auto m22 = _mm_mul_ps(_mm_mul_ps(cosX, cosY), scaleZ);
+
+		auto* pObjectTransform = vecObjectTransform.data();
+		storeColumn(pObjectTransform, arrIndex, laneCount, 0, m00, m10, m20, zero);
+		storeColumn(pObjectTransform, arrIndex, laneCount, 1, m01, m11, m21, zero);
+		storeColumn(pObjectTransform, arrIndex, laneCount, 2, m02, m12, m22, zero);
+		storeColumn(pObjectTransform, arrIndex, laneCount, 3, gather(vecPositionX, arrIndex), gather(vecPositionY, arrIndex),
+					gather(vecPositionZ, arrIndex), _mm_set1_ps(1.0f));
+		for (size_t lane = 0; lane != laneCount; ++lane)
+		{
+			++vecVersion[arrIndex[lane]];
+		}
+	}
+}
+
+void CTransformSystem::Benchmark(CThreadPool& threadPool, const uint32_t objectCount)
+{
+	std::mt19937 generator(11);
+	std::uniform_real_distribution<float> positionDistribution(-100.0f, 100.0f);
+	std::uniform_real_distribution<float> rotationDistribution(-90.0f, 90.0f);
+	std::uniform_real_distribution<float> scaleDistribution(0.5f, 2.0f);
+	std::vector<STransform> vecTransform(objectCount);
+	for (auto& transform : vecTransform)
+	{
+		transform.Position = glm::vec3(positionDistribution(generator), positionDistribution(generator), positionDistribution(generator));
+		transform.Rotation = glm::vec3(rotationDistribution(generator), rotationDistribution(generator), rotationDistribution(generator));
+		transform.Scale = glm::vec3(scaleDistribution(generator));
+	}
+	constexpr auto RUN_COUNT = 20;
+	constexpr auto TIME = 12.5f;
+
+	// What the game objects used to do every frame
+	std::vector<glm::mat4> vecModel(objectCount);
+	auto startTime = std::chrono::high_resolution_clock::now();
+	for (auto run = 0; run != RUN_COUNT; ++run)
+	{
+		for (uint32_t object = 0; object != objectCount; ++object)
+		{
+			const auto& transform = vecTransform[object];
+			const auto scale = glm::scale(glm::mat4(1.0f), transform.Scale);
+			const auto rotationX = glm::rotate(glm::mat4(1.0f), TIME * glm::radians(transform.Rotation.x), glm::vec3(1.0f, 0.0f, 0.0f));
+			const auto rotationY = glm::rotate(glm::mat4(1.0f), TIME * glm::radians(transform.Rotation.y), glm::vec3(0.0f, 1.0f, 0.0f));
+			const auto rotationZ = glm::rotate(glm::mat4(1.0f), TIME * glm::radians(transform.Rotation.z), glm::vec3(0.0f, 0.0f, 1.0f));
+			const auto translate = glm::translate(glm::mat4(1.0f), transform.Position);
+			vecModel[object] = translate * rotationX * rotationY * rotationZ * scale;
+		}
+	}
+	const auto glmTime = std::chrono::duration<float, std::chrono::milliseconds::period>(
+		std::chrono::high_resolution_clock::now() - startTime).count() / RUN_COUNT;
+	std::cout << "Composing " << objectCount << " transforms, glm::rotate chains: " << glmTime << " ms" << std::endl;
+
+	CTransformSystem transformSystem(threadPool);
+	transformSystem.Resize(objectCount);
+	for (uint32_t object = 0; object != objectCount; ++object)
+	{
+		transformSystem.SetTransform(object, vecTransform[object]);
+	}
+	for (const auto threadCount : { 1u, transformSystem.maxThreadCount })
+	{
+		transformSystem.maxThreadCount = threadCount;
+		// The first run wakes the workers
+		transformSystem.Update(TIME);
+		startTime = std::chrono::high_resolution_clock::now();
+		for (auto run = 0; run != RUN_COUNT; ++run)
+		{
+			transformSystem.Update(TIME);
+		}
+		const auto composeTime = std::chrono::duration<float, std::chrono::milliseconds::period>(
+			std::chrono::high_resolution_clock::now() - startTime).count() / RUN_COUNT;
+		std::cout << "Composing " << objectCount << " transforms, SSE on " << threadCount << " threads: " << composeTime << " ms" << std::endl;
+	}
+
+	auto maxError = 0.0f;
+	for (uint32_t object = 0; object != objectCount; ++object)
+	{
+		const auto& model = transformSystem.GetModelMatrix(object);
+		for (auto column = 0; column != 4; ++column)
+		{
+			for (auto row = 0; row != 4; ++row)
+			{
+				maxError = std::max(maxError, std::abs(model[column][row] - vecModel[object][column][row]));
+			}
+		}
+	}
+	std::cout << "Largest difference from the glm::rotate chains: " << maxError << std::endl;
+}
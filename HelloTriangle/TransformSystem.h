@@ -0,0 +1,56 @@
+#pragma once
+#include "Common.h"
+#include "ThreadPool.h"
+
+#include <vector>
+
+// The transforms of every game object, in the same order, kept as one float array per component. Model
+// matrices are only composed again for objects whose transform was edited or that spin, four at a time
+// with SSE, and split across a shared thread pool when there are many. The rotation is in
+// degrees per second around each axis, like the scene file. Not thread safe
+class CTransformSystem
+{
+public:
+	// The thread pool must outlive the transform system
+	explicit CTransformSystem(CThreadPool& threadPool) : pThreadPool(&threadPool), maxThreadCount(threadPool.GetWorkerCount() + 1) {}
+
+	// New slots compose at the next Update
+	void Resize(size_t count);
+	[[nodiscard]] size_t GetCount() const { return vecPositionX.size(); }
+	// The model matrix is only composed again when the transform differs from the current one
+	void SetTransform(size_t index, const STransform& transform);
+
+	// Composes the model matrices of the edited and spinning objects for the time in seconds
+	void Update(double time);
+	// The layout of a slot of the object transform storage buffer
+	[[nodiscard]] const SObjectTransform& GetObjectTransform(size_t index) const { return vecObjectTransform[index]; }
+	[[nodiscard]] const glm::mat4& GetModelMatrix(size_t index) const { return vecObjectTransform[index].Model; }
+	// Bumped every time the model matrix is composed, zero until the first time
+	[[nodiscard]] uint32_t GetVersion(size_t index) const { return vecVersion[index]; }
+
+	// Times glm::rotate chains against the single threaded and the multithreaded compose of objectCount spinning objects
+	static void Benchmark(CThreadPool& threadPool, uint32_t objectCount);
+
+private:
+	void composeRange(double time, size_t begin, size_t end);
+
+	std::vector<float> vecPositionX;
+	std::vector<float> vecPositionY;
+	std::vector<float> vecPositionZ;
+	std::vector<float> vecRotationX;
+	std::vector<float> vecRotationY;
+	std::vector<float> vecRotationZ;
+	std::vector<float> vecScaleX;
+	std::vector<float> vecScaleY;
+	std::vector<float> vecScaleZ;
+	// Edited since the last Update
+	std::vector<uint8_t> vecIsDirty;
+	std::vector<SObjectTransform> vecObjectTransform;
+	std::vector<uint32_t> vecVersion;
+	// The slots composed by the current Update
+	std::vector<uint32_t> vecComposeIndex;
+	// Not owned
+	CThreadPool* pThreadPool;
+	// The workers and the calling thread
+	uint32_t maxThreadCount;
+};
@@ -4,6 +4,9 @@
 #include <memory>
 
 class IGameObject;
+struct SModelInformation;
 
 using GameObjectUPtr = std::unique_ptr<IGameObject>;
-using GameObjectVecPtrs = std::vector<GameObjectUPtr>;
\ No newline at end of file
+using GameObjectVecPtrs = std::vector<GameObjectUPtr>;
+
+using ModelInformationSPtr = std::shared_ptr<SModelInformation>;
\ No newline at end of file
@@ -0,0 +1,254 @@
+#include "UploadBatch.h"
+#include "CommandBufferManager.h"
+
+#include <stdexcept>
+
+void CUploadBatch::Begin(const VkDevice& device, const VkQueue& queue, const VkCommandPool& commandPool)
+{
+	this->device = device;
+	this->queue = queue;
+	this->commandPool = commandPool;
+}
+
+SStagingRegion CUploadBatch::AllocateStaging(CStagingRing& stagingRing, const VkDeviceSize size)
+{
+	SStagingRegion region;
+	if (!TryAllocateStaging(stagingRing, size, region))
+	{
+		// Nothing else can free this batch's own regions
+		if (!vecStagingRegion.empty())
+			SubmitAndWait();
+		region = stagingRing.Allocate(size);
+		pStagingRing = &stagingRing;
+		vecStagingRegion.push_back(region);
+	}
+	return region;
+}
+
+bool CUploadBatch::TryAllocateStaging(CStagingRing& stagingRing, const VkDeviceSize size, SStagingRegion& outRegion)
+{
+	if (!stagingRing.TryAllocate(size, outRegion))
+		return false;
+	pStagingRing = &stagingRing;
+	vecStagingRegion.push_back(outRegion);
+	return true;
+}
+
+void CUploadBatch::CopyBuffer(const VkBuffer srcBuffer, const VkDeviceSize srcOffset, const VkBuffer dstBuffer, const VkDeviceSize dstOffset,
+							  const VkDeviceSize size)
+{
+	VkBufferCopy bufferCopy;
+	bufferCopy.size = size;
+	bufferCopy.srcOffset = srcOffset;
+	bufferCopy.dstOffset = dstOffset;
+	vkCmdCopyBuffer(getCommandBuffer(), srcBuffer, dstBuffer, 1, &bufferCopy);
+}
+
+void CUploadBatch::CopyBufferToImage(const VkBuffer buffer, const VkDeviceSize bufferOffset, const VkImage image, const uint32_t width,
+									 const uint32_t height)
+{
+	VkBufferImageCopy bufferImageCopy = {};
+	bufferImageCopy.bufferOffset = bufferOffset;
+	bufferImageCopy.bufferRowLength = 0;
+	bufferImageCopy.bufferImageHeight = 0;
+	bufferImageCopy.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	bufferImageCopy.imageSubresource.mipLevel = 0;
+	bufferImageCopy.imageSubresource.baseArrayLayer = 0;
+	bufferImageCopy.imageSubresource.layerCount = 1;
+	bufferImageCopy.imageOffset = { 0, 0, 0 };
+	bufferImageCopy.imageExtent.width = width;
+	bufferImageCopy.imageExtent.height = height;
+	bufferImageCopy.imageExtent.depth = 1;
+
+	vkCmdCopyBufferToImage(getCommandBuffer(), buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &bufferImageCopy);
+}
+
+void CUploadBatch::TransitionImageLayout(const VkImage image, const VkImageLayout oldLayout, const VkImageLayout newLayout)
+{
+	VkImageMemoryBarrier memoryBarrier = {};
+	memoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	memoryBarrier.oldLayout = oldLayout;
+	memoryBarrier.newLayout = newLayout;
+	memoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	memoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	memoryBarrier.image = image;
+	memoryBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	memoryBarrier.subresourceRange.baseMipLevel = 0;
+	memoryBarrier.subresourceRange.levelCount = 1;
+	memoryBarrier.subresourceRange.baseArrayLayer = 0;
+	memoryBarrier.subresourceRange.layerCount = 1;
+
+	VkPipelineStageFlags sourceStage;
+	VkPipelineStageFlags destinationStage;
+
+	if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED &&
+		newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL)
+	{
+		memoryBarrier.srcAccessMask = 0;
+		memoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+		sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+		destinationStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+	}
+	else if (oldLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL &&
+			 newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
+	{
+		memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+		sourceStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+		destinationStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+	}
+	else if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED &&
+			 newLayout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL)
+	{
+		memoryBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+		memoryBarrier.srcAccessMask = 0;
+		memoryBarrier.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+			VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+		sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+		destinationStage = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+	}
+	else
+	{
+		throw std::invalid_argument("Unsupported layout transition.");
+	}
+
+	vkCmdPipelineBarrier(getCommandBuffer(),
+						 sourceStage, destinationStage,
+						 0, 0,
+						 nullptr, 0,
+						 nullptr, 1,
+						 &memoryBarrier);
+}
+
+void CUploadBatch::BarrierBuffer(const VkBuffer buffer, const VkDeviceSize offset, const VkDeviceSize size, const VkAccessFlags dstAccessMask,
+								 const VkPipelineStageFlags dstStageMask)
+{
+	bufferBarrier(buffer, offset, size, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED,
+				  VK_ACCESS_TRANSFER_WRITE_BIT, dstAccessMask, VK_PIPELINE_STAGE_TRANSFER_BIT, dstStageMask);
+}
+
+void CUploadBatch::ReleaseBuffer(const VkBuffer buffer, const VkDeviceSize offset, const VkDeviceSize size, const uint32_t srcFamily,
+								 const uint32_t dstFamily)
+{
+	// The access on the destination family is made visible by the acquire
+	bufferBarrier(buffer, offset, size, srcFamily, dstFamily,
+				  VK_ACCESS_TRANSFER_WRITE_BIT, 0, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+}
+
+void CUploadBatch::AcquireBuffer(const VkBuffer buffer, const VkDeviceSize offset, const VkDeviceSize size, const uint32_t srcFamily,
+								 const uint32_t dstFamily, const VkAccessFlags dstAccessMask, const VkPipelineStageFlags dstStageMask)
+{
+	// Chained to the semaphore wait at the same stage, the writes were made available by the release
+	bufferBarrier(buffer, offset, size, srcFamily, dstFamily,
+				  0, dstAccessMask, dstStageMask, dstStageMask);
+}
+
+void CUploadBatch::AddWaitSemaphore(const VkSemaphore semaphore, const VkPipelineStageFlags waitStage)
+{
+	vecWaitSemaphore.push_back(semaphore);
+	vecWaitStage.push_back(waitStage);
+}
+
+VkFence CUploadBatch::Submit(VkSemaphore* pOutSignalSemaphore)
+{
+	if (commandBuffer == nullptr)
+		return nullptr;
+
+	VkSemaphore signalSemaphore = nullptr;
+	if (pOutSignalSemaphore != nullptr)
+	{
+		VkSemaphoreCreateInfo semaphoreCreateInfo = {};
+		semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+		if (vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &signalSemaphore) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create the semaphore.");
+		}
+		*pOutSignalSemaphore = signalSemaphore;
+	}
+
+	fence = CCommandBufferManager::SubmitCommandBuffer(device, queue, commandBuffer, static_cast<uint32_t>(vecWaitSemaphore.size()),
+													   vecWaitSemaphore.data(), vecWaitStage.data(), signalSemaphore);
+	for (const auto& region : vecStagingRegion)
+	{
+		pStagingRing->TrackFence(region, fence);
+	}
+	return fence;
+}
+
+bool CUploadBatch::IsComplete() const
+{
+	return fence == nullptr || vkGetFenceStatus(device, fence) == VK_SUCCESS;
+}
+
+void CUploadBatch::Wait() const
+{
+	if (fence != nullptr)
+		vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX);
+}
+
+void CUploadBatch::Finish()
+{
+	// Before the fence goes, the ring may still be looking at it
+	for (const auto& region : vecStagingRegion)
+	{
+		pStagingRing->Release(region);
+	}
+	vecStagingRegion.clear();
+
+	for (const auto semaphore : vecWaitSemaphore)
+	{
+		vkDestroySemaphore(device, semaphore, nullptr);
+	}
+	vecWaitSemaphore.clear();
+	vecWaitStage.clear();
+
+	if (fence != nullptr)
+		vkDestroyFence(device, fence, nullptr);
+	if (commandBuffer != nullptr)
+		vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
+	fence = nullptr;
+	commandBuffer = nullptr;
+	commandCount = 0;
+}
+
+void CUploadBatch::SubmitAndWait()
+{
+	Submit();
+	Wait();
+	Finish();
+}
+
+VkCommandBuffer CUploadBatch::getCommandBuffer()
+{
+	if (commandBuffer == nullptr)
+	{
+		commandBuffer = CCommandBufferManager::BeginCommandBuffer(device, commandPool);
+	}
+	++commandCount;
+	return commandBuffer;
+}
+
+void CUploadBatch::bufferBarrier(const VkBuffer buffer, const VkDeviceSize offset, const VkDeviceSize size, const uint32_t srcFamily,
+								 const uint32_t dstFamily, const VkAccessFlags srcAccessMask, const VkAccessFlags dstAccessMask,
+								 const VkPipelineStageFlags srcStageMask, const VkPipelineStageFlags dstStageMask)
+{
+	VkBufferMemoryBarrier memoryBarrier = {};
+	memoryBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	memoryBarrier.srcAccessMask = srcAccessMask;
+	memoryBarrier.dstAccessMask = dstAccessMask;
+	memoryBarrier.srcQueueFamilyIndex = srcFamily;
+	memoryBarrier.dstQueueFamilyIndex = dstFamily;
+	memoryBarrier.buffer = buffer;
+	memoryBarrier.offset = offset;
+	memoryBarrier.size = size;
+
+	vkCmdPipelineBarrier(getCommandBuffer(),
+						 srcStageMask, dstStageMask,
+						 0, 0,
+						 nullptr, 1,
+						 &memoryBarrier, 0,
+						 nullptr);
+}
@@ -0,0 +1,85 @@
+#pragma once
+#include "StagingRing.h"
+
+#include <vulkan/vulkan_core.h>
+
+#include <vector>
+
+// The queues uploads go through. Without a dedicated transfer family the transfer queue is the graphics queue
+struct SUploadQueues
+{
+	VkQueue GraphicsQueue = nullptr;
+	VkCommandPool GraphicsCommandPool = nullptr;
+	uint32_t GraphicsFamily = 0;
+	VkQueue TransferQueue = nullptr;
+	VkCommandPool TransferCommandPool = nullptr;
+	uint32_t TransferFamily = 0;
+
+	// Buffers written on the transfer queue then change queue family ownership before the graphics queue reads them
+	[[nodiscard]] bool HasDedicatedTransfer() const { return TransferFamily != GraphicsFamily; }
+};
+
+// Records any number of buffer copies, buffer to image copies and barriers into one command
+// buffer and submits them with a single vkQueueSubmit. The fence tells when all of them have executed,
+// so the caller only waits when it actually needs the results. Staging regions allocated through the
+// batch go back to the ring once it has executed. The command buffer is begun by the first command
+class CUploadBatch
+{
+public:
+	void Begin(const VkDevice& device, const VkQueue& queue, const VkCommandPool& commandPool);
+
+	// Regions allocated earlier must have had their copies recorded already. When the ring is full
+	// of this batch's own regions, what has been recorded so far is submitted and waited for
+	[[nodiscard]] SStagingRegion AllocateStaging(CStagingRing& stagingRing, VkDeviceSize size);
+	// Never waits, returns false when the ring has no room yet
+	[[nodiscard]] bool TryAllocateStaging(CStagingRing& stagingRing, VkDeviceSize size, SStagingRegion& outRegion);
+
+	void CopyBuffer(VkBuffer srcBuffer, VkDeviceSize srcOffset, VkBuffer dstBuffer, VkDeviceSize dstOffset, VkDeviceSize size);
+	// The image must be in VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL
+	void CopyBufferToImage(VkBuffer buffer, VkDeviceSize bufferOffset, VkImage image, uint32_t width, uint32_t height);
+	// Throws std::invalid_argument for layout pairs nothing needs yet
+	void TransitionImageLayout(VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout);
+	// Makes the transfer writes to the range visible to later reads within the same queue family
+	void BarrierBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size, VkAccessFlags dstAccessMask,
+					   VkPipelineStageFlags dstStageMask);
+	// First half of a queue family ownership transfer of the range, recorded after the transfer writes to it
+	void ReleaseBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size, uint32_t srcFamily, uint32_t dstFamily);
+	// Second half, recorded on the destination family with the same range and families as the release. The
+	// batch must wait for a semaphore that the release's submission signals, at dstStageMask
+	void AcquireBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size, uint32_t srcFamily, uint32_t dstFamily,
+					   VkAccessFlags dstAccessMask, VkPipelineStageFlags dstStageMask);
+	// The submission waits for the semaphore at the stage, the batch destroys it in Finish
+	void AddWaitSemaphore(VkSemaphore semaphore, VkPipelineStageFlags waitStage);
+
+	// Ends and submits everything recorded. Returns the fence that signals once it has executed, null
+	// when nothing was recorded. When pOutSignalSemaphore is given, the submission also signals a new
+	// semaphore that the caller owns, usually by handing it to another batch
+	VkFence Submit(VkSemaphore* pOutSignalSemaphore = nullptr);
+	[[nodiscard]] bool IsComplete() const;
+	void Wait() const;
+	// Hands the staging regions back and frees the command buffer, the fence and the semaphores waited for.
+	// Only call once complete
+	void Finish();
+	// Submit, Wait and Finish
+	void SubmitAndWait();
+
+	[[nodiscard]] bool IsEmpty() const { return commandCount == 0; }
+
+private:
+	VkCommandBuffer getCommandBuffer();
+	void bufferBarrier(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size, uint32_t srcFamily, uint32_t dstFamily,
+					   VkAccessFlags srcAccessMask, VkAccessFlags dstAccessMask, VkPipelineStageFlags srcStageMask,
+					   VkPipelineStageFlags dstStageMask);
+
+	VkDevice device = nullptr;
+	VkQueue queue = nullptr;
+	VkCommandPool commandPool = nullptr;
+	VkCommandBuffer commandBuffer = nullptr;
+	VkFence fence = nullptr;
+	uint32_t commandCount = 0;
+	// Every region comes from the same ring
+	CStagingRing* pStagingRing = nullptr;
+	std::vector<SStagingRegion> vecStagingRegion;
+	std::vector<VkSemaphore> vecWaitSemaphore;
+	std::vector<VkPipelineStageFlags> vecWaitStage;
+};
@@ -0,0 +1,104 @@
+#include "VertexQuantizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <glm/gtc/packing.hpp>
+
+namespace
+{
+	constexpr float UNORM16_MAX = 65535.0f;
+	constexpr float SNORM16_MAX = 32767.0f;
+
+	float signNotZero(const float value)
+	{
+		return value >= 0.0f ? 1.0f : -1.0f;
+	}
+}
+
+void CVertexQuantizer::Pack(SModelInformation& modelInfo)
+{
+	const auto pVertex = modelInfo.GetVertexData();
+	const auto vertexCount = modelInfo.VertexCount;
+
+	auto boundsMin = glm::vec3(0.0f);
+	auto boundsMax = glm::vec3(0.0f);
+	if (vertexCount != 0)
+	{
+		boundsMin = boundsMax = pVertex[0].Position;
+	}
+	for (uint32_t i = 1; i < vertexCount; ++i)
+	{
+		boundsMin = glm::min(boundsMin, pVertex[i].Position);
+		boundsMax = glm::max(boundsMax, pVertex[i].Position);
+	}
+	const auto boundsExtent = boundsMax - boundsMin;
+	// Flat axes quantize to zero instead of dividing by zero
+	const auto inverseExtent = glm::vec3(boundsExtent.x > 0.0f ? 1.0f / boundsExtent.x : 0.0f,
+										 boundsExtent.y > 0.0f ? 1.0f / boundsExtent.y : 0.0f,
+										 boundsExtent.z > 0.0f ? 1.0f / boundsExtent.z : 0.0f);
+
+	modelInfo.VecPackedVertex.resize(vertexCount);
+	for (uint32_t i = 0; i != vertexCount; ++i)
+	{
+		const auto& vertex = pVertex[i];
+		auto& packedVertex = modelInfo.VecPackedVertex[i];
+
+		const auto normalized = glm::clamp((vertex.Position - boundsMin) * inverseExtent, 0.0f, 1.0f);
+		packedVertex.Position[0] = static_cast<uint16_t>(std::lround(normalized.x * UNORM16_MAX));
+		packedVertex.Position[1] = static_cast<uint16_t>(std::lround(normalized.y * UNORM16_MAX));
+		packedVertex.Position[2] = static_cast<uint16_t>(std::lround(normalized.z * UNORM16_MAX));
+		packedVertex.Position[3] = 0;
+
+		packedVertex.Normal = encodeNormal(vertex.Normal);
+
+		packedVertex.TextureCoords[0] = glm::packHalf1x16(vertex.TextureCoords.x);
+		packedVertex.TextureCoords[1] = glm::packHalf1x16(vertex.TextureCoords.y);
+	}
+
+	modelInfo.PackedDequantization.PositionOffset = glm::vec4(boundsMin, 0.0f);
+	modelInfo.PackedDequantization.PositionScale = glm::vec4(boundsExtent, 0.0f);
+	modelInfo.VertexFormat = EVertexFormat::Packed;
+}
+
+SVertex CVertexQuantizer::Unpack(const SPackedVertex& packedVertex, const SMeshPushConstants& dequantization)
+{
+	const auto normalized = glm::vec3(packedVertex.Position[0], packedVertex.Position[1], packedVertex.Position[2]) / UNORM16_MAX;
+
+	SVertex vertex;
+	vertex.Position = glm::vec3(dequantization.PositionOffset) + normalized * glm::vec3(dequantization.PositionScale);
+	vertex.Normal = decodeNormal(packedVertex.Normal);
+	vertex.TextureCoords.x = glm::unpackHalf1x16(packedVertex.TextureCoords[0]);
+	vertex.TextureCoords.y = glm::unpackHalf1x16(packedVertex.TextureCoords[1]);
+	return vertex;
+}
+
+// Projects the normal onto the octahedron |x| + |y| + |z| = 1 and folds the lower half over the upper one
+std::array<int16_t, 2> CVertexQuantizer::encodeNormal(const glm::vec3& normal)
+{
+	const auto length = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+	// Missing normals encode as +Z rather than NaN
+	if (length == 0.0f)
+		return { 0, 0 };
+
+	auto encoded = glm::vec2(normal.x, normal.y) / length;
+	if (normal.z < 0.0f)
+	{
+		encoded = glm::vec2((1.0f - std::abs(encoded.y)) * signNotZero(encoded.x),
+							(1.0f - std::abs(encoded.x)) * signNotZero(encoded.y));
+	}
+
+	return { static_cast<int16_t>(std::lround(glm::clamp(encoded.x, -1.0f, 1.0f) * SNORM16_MAX)),
+			 static_cast<int16_t>(std::lround(glm::clamp(encoded.y, -1.0f, 1.0f) * SNORM16_MAX)) };
+}
+
+glm::vec3 CVertexQuantizer::decodeNormal(const std::array<int16_t, 2>& encoded)
+{
+	const auto x = std::max(encoded[0] / SNORM16_MAX, -1.0f);
+	const auto y = std::max(encoded[1] / SNORM16_MAX, -1.0f);
+
+	auto normal = glm::vec3(x, y, 1.0f - std::abs(x) - std::abs(y));
+	const auto fold = std::max(-normal.z, 0.0f);
+	normal.x += normal.x >= 0.0f ? -fold : fold;
+	normal.y += normal.y >= 0.0f ? -fold : fold;
+	return glm::normalize(normal);
+}
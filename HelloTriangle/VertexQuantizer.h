@@ -0,0 +1,17 @@
+#pragma once
+#include "CommonStructs.h"
+
+// Converts SVertex data to SPackedVertex: positions become 16 bit fractions of the mesh
+// bounds, normals are octahedral encoded into two snorm16 and texture coordinates become halves
+class CVertexQuantizer
+{
+public:
+	// Fills VecPackedVertex and PackedDequantization from the float vertices and switches the mesh to EVertexFormat::Packed
+	static void Pack(SModelInformation& modelInfo);
+	// Inverse of Pack for a single vertex, what vShader.vert computes
+	[[nodiscard]] static SVertex Unpack(const SPackedVertex& packedVertex, const SMeshPushConstants& dequantization);
+
+private:
+	[[nodiscard]] static std::array<int16_t, 2> encodeNormal(const glm::vec3& normal);
+	[[nodiscard]] static glm::vec3 decodeNormal(const std::array<int16_t, 2>& encoded);
+};
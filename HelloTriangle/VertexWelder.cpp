@@ -0,0 +1,45 @@
+#include "VertexWelder.h"
+#include "Common.h"
+
+CVertexWelder::CVertexWelder(const size_t maxVertexCount)
+{
+	// Keep the load factor at or below 0.5 so probe sequences stay short
+	size_t slotCount = 16;
+	while (slotCount < maxVertexCount * 2)
+	{
+		slotCount <<= 1;
+	}
+	vecSlot.resize(slotCount);
+	slotMask = slotCount - 1;
+}
+
+uint32_t CVertexWelder::Weld(const SVertex& vertex, std::vector<SVertex>& outVecVertex)
+{
+	const auto hash = hashVertex(vertex);
+	auto slotIndex = hash & slotMask;
+
+	while (vecSlot[slotIndex].Index != EMPTY_SLOT)
+	{
+		const auto& slot = vecSlot[slotIndex];
+		if (slot.Hash == hash && outVecVertex[slot.Index] == vertex)
+		{
+			return slot.Index;
+		}
+		slotIndex = (slotIndex + 1) & slotMask;
+	}
+
+	const auto index = static_cast<uint32_t>(outVecVertex.size());
+	outVecVertex.push_back(vertex);
+	vecSlot[slotIndex].Hash = hash;
+	vecSlot[slotIndex].Index = index;
+	return index;
+}
+
+uint32_t CVertexWelder::hashVertex(const SVertex& vertex)
+{
+	auto hash = std::hash<glm::vec3>()(vertex.Position);
+	hash ^= std::hash<glm::vec3>()(vertex.Normal) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+	hash ^= std::hash<glm::vec2>()(vertex.TextureCoords) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+	// Fold the upper bits in, the table only looks at the lower ones
+	return static_cast<uint32_t>(hash ^ (static_cast<uint64_t>(hash) >> 32));
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include "CommonStructs.h"
+
+#include <vector>
+
+// Deduplicates vertices using an open-addressing hash table (linear probing)
+class CVertexWelder
+{
+public:
+	explicit CVertexWelder(size_t maxVertexCount);
+
+	// Returns the index of the vertex in outVecVertex, appends it if it hasn't been seen before
+	uint32_t Weld(const SVertex& vertex, std::vector<SVertex>& outVecVertex);
+
+private:
+	static uint32_t hashVertex(const SVertex& vertex);
+
+	struct SSlot
+	{
+		uint32_t Hash = 0;
+		uint32_t Index = EMPTY_SLOT;
+	};
+	static constexpr uint32_t EMPTY_SLOT = UINT32_MAX;
+
+	std::vector<SSlot> vecSlot;
+	size_t slotMask = 0;
+};
@@ -0,0 +1,476 @@
+// Exercises the device memory block metadata and the allocator's block management on the CPU,
+// no Vulkan device or loader is needed. Returns EXIT_FAILURE and prints the failed checks if any of them fails
+#include "../HelloTriangle/DeviceMemoryAllocator.h"
+#include "../HelloTriangle/MemoryBlockMetadata.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <random>
+#include <stdexcept>
+
+#define CHECK(condition) \
+	do \
+	{ \
+		if (!(condition)) \
+		{ \
+			std::cout << __FILE__ << "(" << __LINE__ << "): " << #condition << " failed" << std::endl; \
+			++failureCount; \
+		} \
+	} while (false)
+
+namespace
+{
+	uint32_t failureCount = 0;
+
+	constexpr VkDeviceSize MIB = VkDeviceSize(1) << 20;
+	constexpr uint32_t DEVICE_LOCAL_TYPE = 0;
+	constexpr uint32_t HOST_VISIBLE_TYPE = 1;
+
+	// A device with an 8 GiB device local heap and a 256 MiB host visible one. Hands out fake
+	// handles and backs mappings with host memory
+	class CFakeDeviceMemory final : public IDeviceMemory
+	{
+	public:
+		explicit CFakeDeviceMemory(const uint32_t maxMemoryAllocationCount = 4096) : maxMemoryAllocationCount(maxMemoryAllocationCount)
+		{
+			memoryProperties.memoryTypeCount = 2;
+			memoryProperties.memoryTypes[DEVICE_LOCAL_TYPE] = { VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0 };
+			memoryProperties.memoryTypes[HOST_VISIBLE_TYPE] = { VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 1 };
+			memoryProperties.memoryHeapCount = 2;
+			memoryProperties.memoryHeaps[0].size = 8192 * MIB;
+			memoryProperties.memoryHeaps[1].size = 256 * MIB;
+		}
+
+		[[nodiscard]] const VkPhysicalDeviceMemoryProperties& GetMemoryProperties() const override { return memoryProperties; }
+		[[nodiscard]] VkDeviceSize GetBufferImageGranularity() const override { return 1024; }
+		[[nodiscard]] uint32_t GetMaxMemoryAllocationCount() const override { return maxMemoryAllocationCount; }
+
+		VkDeviceMemory AllocateMemory(const VkDeviceSize size, const uint32_t memoryTypeIndex) override
+		{
+			auto pMemory = std::make_unique<SFakeMemory>();
+			pMemory->Size = size;
+			pMemory->MemoryTypeIndex = memoryTypeIndex;
+			const auto memory = reinterpret_cast<VkDeviceMemory>(pMemory.get());
+			mapMemory.emplace(memory, std::move(pMemory));
+			return memory;
+		}
+
+		void FreeMemory(const VkDeviceMemory memory) override
+		{
+			CHECK(mapMemory.erase(memory) == 1);
+		}
+
+		void* MapMemory(const VkDeviceMemory memory) override
+		{
+			auto& pMemory = mapMemory.at(memory);
+			CHECK(pMemory->MemoryTypeIndex == HOST_VISIBLE_TYPE);
+			pMemory->vecHostData.resize(static_cast<size_t>(pMemory->Size));
+			return pMemory->vecHostData.data();
+		}
+
+		[[nodiscard]] size_t GetLiveCount() const { return mapMemory.size(); }
+		[[nodiscard]] VkDeviceSize GetSize(const VkDeviceMemory memory) const { return mapMemory.at(memory)->Size; }
+		[[nodiscard]] uint32_t GetMemoryTypeIndex(const VkDeviceMemory memory) const { return mapMemory.at(memory)->MemoryTypeIndex; }
+		[[nodiscard]] const uint8_t* GetHostData(const VkDeviceMemory memory) const { return mapMemory.at(memory)->vecHostData.data(); }
+
+	private:
+		struct SFakeMemory
+		{
+			VkDeviceSize Size = 0;
+			uint32_t MemoryTypeIndex = 0;
+			std::vector<uint8_t> vecHostData;
+		};
+
+		VkPhysicalDeviceMemoryProperties memoryProperties = {};
+		uint32_t maxMemoryAllocationCount;
+		std::map<VkDeviceMemory, std::unique_ptr<SFakeMemory>> mapMemory;
+	};
+
+	VkMemoryRequirements makeRequirements(const VkDeviceSize size, const VkDeviceSize alignment = 256, const uint32_t memoryTypeBits = 0b11)
+	{
+		return { size, alignment, memoryTypeBits };
+	}
+
+	void testTlsfCoalescing()
+	{
+		CTlsfBlockMetadata metadata(1 << 20, 1);
+		SBlockAllocation a, b, c;
+		CHECK(metadata.Allocate(1000, 1, EAllocationType::Linear, a));
+		CHECK(metadata.Allocate(1000, 1, EAllocationType::Linear, b));
+		CHECK(metadata.Allocate(1000, 1, EAllocationType::Linear, c));
+		CHECK(a.Offset == 0 && b.Offset == 1000 && c.Offset == 2000);
+		CHECK(metadata.GetUsedSize() == 3000 && metadata.GetAllocationCount() == 3);
+		// Only the tail of the block is free
+		CHECK(metadata.GetFreeRangeCount() == 1);
+
+		metadata.Free(b);
+		CHECK(metadata.GetFreeRangeCount() == 2);
+		// Merged with the range after it
+		metadata.Free(a);
+		CHECK(metadata.GetFreeRangeCount() == 2);
+		// Merged with the ranges on both sides
+		metadata.Free(c);
+		CHECK(metadata.GetFreeRangeCount() == 1);
+		CHECK(metadata.IsEmpty() && metadata.GetUsedSize() == 0);
+
+		SBlockAllocation whole;
+		CHECK(metadata.Allocate(1 << 20, 1, EAllocationType::Linear, whole));
+		CHECK(whole.Offset == 0 && metadata.GetFreeRangeCount() == 0);
+		metadata.Free(whole);
+		CHECK(metadata.IsEmpty() && metadata.GetFreeRangeCount() == 1);
+	}
+
+	void testTlsfAlignment()
+	{
+		CTlsfBlockMetadata metadata(1 << 20, 1);
+		SBlockAllocation small, aligned, page;
+		CHECK(metadata.Allocate(3, 1, EAllocationType::Linear, small));
+		CHECK(metadata.Allocate(100, 256, EAllocationType::Linear, aligned));
+		CHECK(aligned.Offset == 256);
+		CHECK(metadata.Allocate(10, 65536, EAllocationType::Linear, page));
+		CHECK(page.Offset == 65536);
+
+		// The padding in front of an aligned allocation stays usable
+		SBlockAllocation padding;
+		CHECK(metadata.Allocate(200, 4, EAllocationType::Linear, padding));
+		CHECK(padding.Offset == 4);
+	}
+
+	void testLinearAlignment()
+	{
+		CLinearBlockMetadata metadata(1 << 20, 1);
+		SBlockAllocation small, aligned;
+		CHECK(metadata.Allocate(3, 1, EAllocationType::Linear, small));
+		CHECK(metadata.Allocate(100, 256, EAllocationType::Linear, aligned));
+		CHECK(small.Offset == 0 && aligned.Offset == 256);
+	}
+
+	void testGranularity(IBlockMetadata& metadata)
+	{
+		SBlockAllocation buffer, image, secondImage, secondBuffer;
+		CHECK(metadata.Allocate(100, 1, EAllocationType::Linear, buffer));
+		// An optimal image may not share the buffer's page
+		CHECK(metadata.Allocate(100, 1, EAllocationType::Optimal, image));
+		CHECK(image.Offset == 1024);
+		// Resources of the same type can
+		CHECK(metadata.Allocate(100, 1, EAllocationType::Optimal, secondImage));
+		CHECK(secondImage.Offset == 1124);
+		CHECK(metadata.Allocate(100, 1, EAllocationType::Linear, secondBuffer));
+		CHECK(secondBuffer.Offset == 2048);
+	}
+
+	void testTlsfOutOfSpace()
+	{
+		CTlsfBlockMetadata metadata(4096, 1);
+		SBlockAllocation arrAllocation[4];
+		for (auto& allocation : arrAllocation)
+		{
+			CHECK(metadata.Allocate(1024, 1, EAllocationType::Linear, allocation));
+		}
+		SBlockAllocation extra;
+		CHECK(!metadata.Allocate(1, 1, EAllocationType::Linear, extra));
+
+		// 2048 bytes are free but not in one piece
+		metadata.Free(arrAllocation[1]);
+		metadata.Free(arrAllocation[3]);
+		CHECK(!metadata.Allocate(2048, 1, EAllocationType::Linear, extra));
+		CHECK(metadata.Allocate(1024, 1, EAllocationType::Linear, extra));
+		// Fits in size but not once aligned
+		metadata.Free(extra);
+		CHECK(!metadata.Allocate(1024, 2048, EAllocationType::Linear, extra));
+		CHECK(!metadata.Allocate(4097, 1, EAllocationType::Linear, extra));
+
+		// Growing adds room after the last range
+		metadata.Grow(8192);
+		CHECK(metadata.Allocate(4096, 4096, EAllocationType::Linear, extra));
+		CHECK(extra.Offset == 4096);
+	}
+
+	void testLinearOutOfSpace()
+	{
+		CLinearBlockMetadata metadata(4096, 1);
+		SBlockAllocation first, second;
+		CHECK(metadata.Allocate(3000, 1, EAllocationType::Linear, first));
+		CHECK(!metadata.Allocate(2000, 1, EAllocationType::Linear, second));
+		CHECK(!metadata.Allocate(1000, 2048, EAllocationType::Linear, second));
+		CHECK(metadata.Allocate(1000, 1, EAllocationType::Linear, second));
+		// Nothing is reclaimed until the block is empty
+		metadata.Free(second);
+		CHECK(!metadata.Allocate(2000, 1, EAllocationType::Linear, second));
+		metadata.Free(first);
+		CHECK(metadata.IsEmpty());
+		CHECK(metadata.Allocate(4096, 1, EAllocationType::Linear, first));
+		CHECK(first.Offset == 0);
+	}
+
+	// Random allocations and frees, checked against the live set after every step
+	void testTlsfRandom()
+	{
+		constexpr uint64_t BLOCK_SIZE = 1 << 24;
+		constexpr uint64_t GRANULARITY = 4096;
+		CTlsfBlockMetadata metadata(BLOCK_SIZE, GRANULARITY);
+		std::mt19937 generator(5);
+		// Keyed by offset
+		std::map<uint64_t, std::pair<SBlockAllocation, EAllocationType>> mapLive;
+		uint64_t usedSize = 0;
+
+		for (auto step = 0; step != 20000; ++step)
+		{
+			if (!mapLive.empty() && generator() % 3 == 0)
+			{
+				auto iter = mapLive.begin();
+				std::advance(iter, generator() % mapLive.size());
+				usedSize -= iter->second.first.Size;
+				metadata.Free(iter->second.first);
+				mapLive.erase(iter);
+				continue;
+			}
+
+			const auto size = uint64_t(1) + generator() % 65536;
+			const auto alignment = uint64_t(1) << (generator() % 13);
+			const auto type = generator() % 2 == 0 ? EAllocationType::Linear : EAllocationType::Optimal;
+			SBlockAllocation allocation;
+			if (!metadata.Allocate(size, alignment, type, allocation))
+				continue;
+
+			CHECK(allocation.Offset % alignment == 0);
+			CHECK(allocation.Offset + allocation.Size <= BLOCK_SIZE);
+			const auto next = mapLive.lower_bound(allocation.Offset);
+			if (next != mapLive.end())
+			{
+				CHECK(allocation.Offset + allocation.Size <= next->first);
+				if (type != next->second.second)
+					CHECK((allocation.Offset + allocation.Size - 1) / GRANULARITY != next->first / GRANULARITY);
+			}
+			if (next != mapLive.begin())
+			{
+				const auto& [prev, prevType] = std::prev(next)->second;
+				CHECK(prev.Offset + prev.Size <= allocation.Offset);
+				if (type != prevType)
+					CHECK((prev.Offset + prev.Size - 1) / GRANULARITY != allocation.Offset / GRANULARITY);
+			}
+			usedSize += size;
+			mapLive.emplace(allocation.Offset, std::make_pair(allocation, type));
+			CHECK(metadata.GetUsedSize() == usedSize);
+		}
+
+		for (const auto& [offset, live] : mapLive)
+		{
+			metadata.Free(live.first);
+		}
+		CHECK(metadata.IsEmpty() && metadata.GetFreeRangeCount() == 1);
+	}
+
+	void testAllocatorPools()
+	{
+		CFakeDeviceMemory deviceMemory;
+		CDeviceMemoryAllocator allocator;
+		allocator.Init(deviceMemory);
+
+		auto general = allocator.Allocate(makeRequirements(1000), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, EAllocationType::Linear,
+										  EAllocationStrategy::General);
+		auto secondGeneral = allocator.Allocate(makeRequirements(1000), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, EAllocationType::Linear,
+												EAllocationStrategy::General);
+		auto linear = allocator.Allocate(makeRequirements(1000), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, EAllocationType::Linear,
+										 EAllocationStrategy::Linear);
+		auto hostVisible = allocator.Allocate(makeRequirements(1000), VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, EAllocationType::Linear,
+											  EAllocationStrategy::General);
+		// A block per memory type and strategy, shared by the allocations of the same pool
+		CHECK(general.Memory == secondGeneral.Memory && general.pBlock == secondGeneral.pBlock);
+		CHECK(secondGeneral.Offset == 1024);
+		CHECK(linear.Memory != general.Memory && hostVisible.Memory != general.Memory && hostVisible.Memory != linear.Memory);
+		CHECK(deviceMemory.GetLiveCount() == 3 && allocator.GetDeviceMemoryCount() == 3);
+		CHECK(deviceMemory.GetMemoryTypeIndex(general.Memory) == DEVICE_LOCAL_TYPE);
+		CHECK(deviceMemory.GetMemoryTypeIndex(linear.Memory) == DEVICE_LOCAL_TYPE);
+		CHECK(deviceMemory.GetMemoryTypeIndex(hostVisible.Memory) == HOST_VISIBLE_TYPE);
+		// 64 MiB blocks on the big heap, an eighth of the heap on the small one
+		CHECK(deviceMemory.GetSize(general.Memory) == 64 * MIB);
+		CHECK(deviceMemory.GetSize(hostVisible.Memory) == 32 * MIB);
+
+		// The memory type bits rule out the type that has the properties
+		bool isThrown = false;
+		try
+		{
+			[[maybe_unused]] const auto unmatched = allocator.Allocate(makeRequirements(1000, 256, 1 << DEVICE_LOCAL_TYPE), VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+												EAllocationType::Linear, EAllocationStrategy::General);
+		}
+		catch (const std::runtime_error&)
+		{
+			isThrown = true;
+		}
+		CHECK(isThrown);
+
+		allocator.Free(general);
+		allocator.Free(secondGeneral);
+		allocator.Free(linear);
+		allocator.Free(hostVisible);
+		CHECK(general.Memory == nullptr && general.pBlock == nullptr);
+		allocator.Cleanup();
+		CHECK(deviceMemory.GetLiveCount() == 0 && allocator.GetDeviceMemoryCount() == 0);
+	}
+
+	void testAllocatorDedicated()
+	{
+		CFakeDeviceMemory deviceMemory;
+		CDeviceMemoryAllocator allocator;
+		allocator.Init(deviceMemory);
+
+		auto half = allocator.Allocate(makeRequirements(32 * MIB), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, EAllocationType::Linear,
+									   EAllocationStrategy::General);
+		CHECK(half.pBlock != nullptr && deviceMemory.GetSize(half.Memory) == 64 * MIB);
+
+		// Over half a block gets a VkDeviceMemory of its own
+		auto dedicated = allocator.Allocate(makeRequirements(32 * MIB + 1), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, EAllocationType::Linear,
+											EAllocationStrategy::General);
+		CHECK(dedicated.pBlock == nullptr && dedicated.Offset == 0);
+		CHECK(deviceMemory.GetSize(dedicated.Memory) == 32 * MIB + 1);
+		CHECK(deviceMemory.GetLiveCount() == 2);
+
+		allocator.Free(dedicated);
+		CHECK(dedicated.Memory == nullptr);
+		CHECK(deviceMemory.GetLiveCount() == 1 && allocator.GetDeviceMemoryCount() == 1);
+		allocator.Free(half);
+		allocator.Cleanup();
+		CHECK(deviceMemory.GetLiveCount() == 0);
+	}
+
+	void testAllocatorEmptyBlock()
+	{
+		CFakeDeviceMemory deviceMemory;
+		CDeviceMemoryAllocator allocator;
+		allocator.Init(deviceMemory);
+
+		// Two fill the first block, the third needs another
+		SMemoryAllocation arrAllocation[3];
+		for (auto& allocation : arrAllocation)
+		{
+			allocation = allocator.Allocate(makeRequirements(32 * MIB), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, EAllocationType::Linear,
+											EAllocationStrategy::General);
+		}
+		CHECK(arrAllocation[0].Memory == arrAllocation[1].Memory && arrAllocation[2].Memory != arrAllocation[0].Memory);
+		CHECK(deviceMemory.GetLiveCount() == 2);
+
+		// The only empty block is kept
+		allocator.Free(arrAllocation[2]);
+		CHECK(deviceMemory.GetLiveCount() == 2);
+		allocator.Free(arrAllocation[0]);
+		CHECK(deviceMemory.GetLiveCount() == 2);
+		// A second empty block is freed
+		allocator.Free(arrAllocation[1]);
+		CHECK(deviceMemory.GetLiveCount() == 1 && allocator.GetDeviceMemoryCount() == 1);
+
+		// And the kept one is reused
+		arrAllocation[0] = allocator.Allocate(makeRequirements(1000), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, EAllocationType::Linear,
+											  EAllocationStrategy::General);
+		CHECK(deviceMemory.GetLiveCount() == 1 && arrAllocation[0].Offset == 0);
+		allocator.Free(arrAllocation[0]);
+		allocator.Cleanup();
+		CHECK(deviceMemory.GetLiveCount() == 0);
+	}
+
+	void testAllocatorMaxAllocationCount()
+	{
+		CFakeDeviceMemory deviceMemory(2);
+		CDeviceMemoryAllocator allocator;
+		allocator.Init(deviceMemory);
+
+		auto first = allocator.Allocate(makeRequirements(1000), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, EAllocationType::Linear,
+										EAllocationStrategy::General);
+		auto second = allocator.Allocate(makeRequirements(100 * MIB), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, EAllocationType::Linear,
+										 EAllocationStrategy::General);
+		CHECK(allocator.GetDeviceMemoryCount() == 2);
+
+		// Still fits in the block
+		auto third = allocator.Allocate(makeRequirements(1000), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, EAllocationType::Linear,
+										EAllocationStrategy::General);
+		CHECK(third.Memory == first.Memory);
+
+		bool isThrown = false;
+		try
+		{
+			[[maybe_unused]] const auto rejected = allocator.Allocate(makeRequirements(1000), VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, EAllocationType::Linear,
+											 EAllocationStrategy::General);
+		}
+		catch (const std::runtime_error&)
+		{
+			isThrown = true;
+		}
+		CHECK(isThrown);
+		CHECK(deviceMemory.GetLiveCount() == 2 && allocator.GetDeviceMemoryCount() == 2);
+
+		// Freeing one makes room again
+		allocator.Free(second);
+		auto fourth = allocator.Allocate(makeRequirements(1000), VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, EAllocationType::Linear,
+										 EAllocationStrategy::General);
+		CHECK(fourth.Memory != nullptr && allocator.GetDeviceMemoryCount() == 2);
+
+		allocator.Free(first);
+		allocator.Free(third);
+		allocator.Free(fourth);
+		allocator.Cleanup();
+		CHECK(deviceMemory.GetLiveCount() == 0);
+	}
+
+	void testAllocatorMapping()
+	{
+		CFakeDeviceMemory deviceMemory;
+		CDeviceMemoryAllocator allocator;
+		allocator.Init(deviceMemory);
+
+		auto first = allocator.Allocate(makeRequirements(1000), VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, EAllocationType::Linear,
+										EAllocationStrategy::Linear);
+		auto second = allocator.Allocate(makeRequirements(1000), VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, EAllocationType::Linear,
+										 EAllocationStrategy::Linear);
+		auto dedicated = allocator.Allocate(makeRequirements(20 * MIB), VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, EAllocationType::Linear,
+											EAllocationStrategy::Linear);
+		auto deviceLocal = allocator.Allocate(makeRequirements(1000), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, EAllocationType::Linear,
+											  EAllocationStrategy::Linear);
+		// Offset into the mapping of the whole block
+		CHECK(second.Memory == first.Memory && second.Offset == 1024);
+		CHECK(first.pMappedData == deviceMemory.GetHostData(first.Memory));
+		CHECK(second.pMappedData == deviceMemory.GetHostData(second.Memory) + second.Offset);
+		CHECK(dedicated.pBlock == nullptr && dedicated.pMappedData == deviceMemory.GetHostData(dedicated.Memory));
+		CHECK(deviceLocal.pMappedData == nullptr);
+
+		allocator.Free(first);
+		allocator.Free(second);
+		allocator.Free(dedicated);
+		allocator.Free(deviceLocal);
+		allocator.Cleanup();
+		CHECK(deviceMemory.GetLiveCount() == 0);
+	}
+}
+
+int main()
+{
+	testTlsfCoalescing();
+	testTlsfAlignment();
+	testLinearAlignment();
+	{
+		CTlsfBlockMetadata metadata(1 << 20, 1024);
+		testGranularity(metadata);
+	}
+	{
+		CLinearBlockMetadata metadata(1 << 20, 1024);
+		testGranularity(metadata);
+	}
+	testTlsfOutOfSpace();
+	testLinearOutOfSpace();
+	testTlsfRandom();
+	testAllocatorPools();
+	testAllocatorDedicated();
+	testAllocatorEmptyBlock();
+	testAllocatorMaxAllocationCount();
+	testAllocatorMapping();
+
+	if (failureCount != 0)
+	{
+		std::cout << failureCount << " checks failed" << std::endl;
+		return EXIT_FAILURE;
+	}
+	std::cout << "All checks passed" << std::endl;
+	return EXIT_SUCCESS;
+}